@@ -0,0 +1,365 @@
+/*
+ * linux/arch/arm/crypto/gcm_neon_glue.c - AES-GCM (RFC4106) using the ARM
+ * scalar AES code and NEON GHASH
+ *
+ * Based on the RFC4106 glue in arch/x86/crypto/aesni-intel_glue.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <asm/neon.h>
+#include <asm/simd.h>
+#include <asm/unaligned.h>
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <crypto/cryptd.h>
+#include <crypto/internal/aead.h>
+#include <crypto/scatterwalk.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+
+#include "aes_glue.h"
+#include "ghash_glue.h"
+
+/*
+ * Keystream is generated and consumed in chunks of this many bytes, and
+ * each chunk is hashed right after its AES-CTR pass, while it is still in
+ * the L1 cache.
+ */
+#define GCM_NEON_CHUNK		(4 * AES_BLOCK_SIZE)
+
+struct gcm_neon_ctx {
+	struct AES_KEY		enc;
+	struct ghash_key	ghash;
+	u8			nonce[4];
+};
+
+struct gcm_neon_async_ctx {
+	struct cryptd_aead	*cryptd_tfm;
+};
+
+/* Hash @len bytes, zero padding the final partial block if any. */
+static void gcm_neon_ghash(u64 dg[], const u8 *src, unsigned int len,
+			   const struct ghash_key *key)
+{
+	unsigned int blocks = len / GHASH_BLOCK_SIZE;
+
+	if (blocks)
+		ghash_neon_update(dg, src, blocks, key->k);
+
+	len %= GHASH_BLOCK_SIZE;
+	if (len) {
+		u8 buf[GHASH_BLOCK_SIZE] = {};
+
+		memcpy(buf, src + blocks * GHASH_BLOCK_SIZE, len);
+		ghash_neon_update(dg, buf, 1, key->k);
+	}
+}
+
+static void gcm_neon_crypt(struct gcm_neon_ctx *ctx, u8 *dst, const u8 *src,
+			   unsigned int len, u8 ctr[], u64 dg[], bool enc)
+{
+	u8 ks[GCM_NEON_CHUNK];
+
+	while (len) {
+		unsigned int n = min_t(unsigned int, len, GCM_NEON_CHUNK);
+		unsigned int i;
+
+		for (i = 0; i < n; i += AES_BLOCK_SIZE) {
+			AES_encrypt(ctr, ks + i, &ctx->enc);
+			crypto_inc(ctr + 12, 4);
+		}
+
+		if (!enc)
+			gcm_neon_ghash(dg, src, n, &ctx->ghash);
+		for (i = 0; i < n; i++)
+			dst[i] = src[i] ^ ks[i];
+		if (enc)
+			gcm_neon_ghash(dg, dst, n, &ctx->ghash);
+
+		src += n;
+		dst += n;
+		len -= n;
+	}
+}
+
+/*
+ * Return a linear mapping of @sg if it covers @len bytes in a single lowmem
+ * entry, so that the common case of a contiguous packet needs no copying.
+ */
+static u8 *gcm_neon_map(struct scatterlist *sg, unsigned int len)
+{
+	if (sg_is_last(sg) && sg->length >= len && !PageHighMem(sg_page(sg)))
+		return sg_virt(sg);
+	return NULL;
+}
+
+static int gcm_neon_do_crypt(struct aead_request *req, bool enc)
+{
+	struct crypto_aead *aead = crypto_aead_reqtfm(req);
+	struct gcm_neon_ctx *ctx = crypto_aead_ctx(aead);
+	unsigned int authsize = crypto_aead_authsize(aead);
+	unsigned int len, srclen, dstlen;
+	u8 iv[AES_BLOCK_SIZE], ctr[AES_BLOCK_SIZE], tag[AES_BLOCK_SIZE];
+	u8 *src, *dst, *assoc, *buf = NULL;
+	u64 dg[GHASH_DIGEST_SIZE / sizeof(u64)] = {};
+	__be64 lengths[2];
+	int err = 0;
+
+	/*
+	 * Assuming we are supporting rfc4106 64-bit extended sequence numbers,
+	 * the AAD length must be equal to 8 or 12 bytes.
+	 */
+	if (unlikely(req->assoclen != 8 && req->assoclen != 12))
+		return -EINVAL;
+	if (unlikely(!enc && req->cryptlen < authsize))
+		return -EINVAL;
+
+	len = enc ? req->cryptlen : req->cryptlen - authsize;
+	srclen = req->cryptlen;
+	dstlen = enc ? len + authsize : len;
+
+	if (req->src == req->dst) {
+		src = dst = gcm_neon_map(req->src, max(srclen, dstlen));
+	} else {
+		src = gcm_neon_map(req->src, srclen);
+		dst = gcm_neon_map(req->dst, dstlen);
+	}
+	assoc = gcm_neon_map(req->assoc, req->assoclen);
+
+	if (!src || !dst || !assoc) {
+		buf = kmalloc(max(srclen, dstlen) + req->assoclen, GFP_ATOMIC);
+		if (unlikely(!buf))
+			return -ENOMEM;
+		src = dst = buf;
+		assoc = buf + max(srclen, dstlen);
+		scatterwalk_map_and_copy(src, req->src, 0, srclen, 0);
+		scatterwalk_map_and_copy(assoc, req->assoc, 0, req->assoclen, 0);
+	}
+
+	/* J0 = nonce || IV || 1, the payload counter starts at J0 + 1 */
+	memcpy(iv, ctx->nonce, sizeof(ctx->nonce));
+	memcpy(iv + 4, req->iv, 8);
+	put_unaligned_be32(1, iv + 12);
+	memcpy(ctr, iv, AES_BLOCK_SIZE);
+	crypto_inc(ctr + 12, 4);
+
+	lengths[0] = cpu_to_be64((u64)req->assoclen * 8);
+	lengths[1] = cpu_to_be64((u64)len * 8);
+
+	kernel_neon_begin();
+	gcm_neon_ghash(dg, assoc, req->assoclen, &ctx->ghash);
+	gcm_neon_crypt(ctx, dst, src, len, ctr, dg, enc);
+	ghash_neon_update(dg, (u8 *)lengths, 1, ctx->ghash.k);
+	kernel_neon_end();
+
+	put_unaligned_be64(dg[1], tag);
+	put_unaligned_be64(dg[0], tag + 8);
+	AES_encrypt(iv, iv, &ctx->enc);
+	crypto_xor(tag, iv, AES_BLOCK_SIZE);
+
+	if (enc)
+		memcpy(dst + len, tag, authsize);
+	else if (crypto_memneq(src + len, tag, authsize))
+		err = -EBADMSG;
+
+	if (buf) {
+		scatterwalk_map_and_copy(buf, req->dst, 0, dstlen, 1);
+		kfree(buf);
+	}
+	return err;
+}
+
+static int gcm_neon_encrypt(struct aead_request *req)
+{
+	return gcm_neon_do_crypt(req, true);
+}
+
+static int gcm_neon_decrypt(struct aead_request *req)
+{
+	return gcm_neon_do_crypt(req, false);
+}
+
+static int gcm_neon_setkey(struct crypto_aead *aead, const u8 *inkey,
+			   unsigned int keylen)
+{
+	struct gcm_neon_ctx *ctx = crypto_aead_ctx(aead);
+	u8 h[AES_BLOCK_SIZE] = {};
+
+	/* Account for 4 byte nonce at the end. */
+	if (keylen < 4)
+		goto badkey;
+	keylen -= 4;
+
+	if (private_AES_set_encrypt_key(inkey, keylen * 8, &ctx->enc))
+		goto badkey;
+	memcpy(ctx->nonce, inkey + keylen, sizeof(ctx->nonce));
+
+	/* The hash subkey is the encryption of the all zeroes block. */
+	AES_encrypt(h, h, &ctx->enc);
+	ctx->ghash.k[1] = get_unaligned_be64(h);
+	ctx->ghash.k[0] = get_unaligned_be64(h + 8);
+	return 0;
+
+badkey:
+	crypto_aead_set_flags(aead, CRYPTO_TFM_RES_BAD_KEY_LEN);
+	return -EINVAL;
+}
+
+/*
+ * This is the Integrity Check Value (aka the authentication tag length and
+ * can be 8, 12 or 16 bytes long.
+ */
+static int gcm_neon_setauthsize(struct crypto_aead *aead,
+				unsigned int authsize)
+{
+	switch (authsize) {
+	case 8:
+	case 12:
+	case 16:
+		return 0;
+	}
+	return -EINVAL;
+}
+
+static int gcm_neon_async_init(struct crypto_tfm *tfm)
+{
+	struct gcm_neon_async_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct cryptd_aead *cryptd_tfm;
+
+	cryptd_tfm = cryptd_alloc_aead("__driver-gcm-aes-neon", 0, 0);
+	if (IS_ERR(cryptd_tfm))
+		return PTR_ERR(cryptd_tfm);
+
+	ctx->cryptd_tfm = cryptd_tfm;
+	tfm->crt_aead.reqsize = sizeof(struct aead_request) +
+				crypto_aead_reqsize(&cryptd_tfm->base);
+	return 0;
+}
+
+static void gcm_neon_async_exit(struct crypto_tfm *tfm)
+{
+	struct gcm_neon_async_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	cryptd_free_aead(ctx->cryptd_tfm);
+}
+
+static int gcm_neon_async_setkey(struct crypto_aead *aead, const u8 *key,
+				 unsigned int keylen)
+{
+	struct gcm_neon_async_ctx *ctx = crypto_aead_ctx(aead);
+	struct crypto_aead *child = cryptd_aead_child(ctx->cryptd_tfm);
+	int err;
+
+	crypto_aead_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+	crypto_aead_set_flags(child, crypto_aead_get_flags(aead) &
+				     CRYPTO_TFM_REQ_MASK);
+	err = crypto_aead_setkey(child, key, keylen);
+	crypto_aead_set_flags(aead, crypto_aead_get_flags(child) &
+				    CRYPTO_TFM_RES_MASK);
+	return err;
+}
+
+static int gcm_neon_async_setauthsize(struct crypto_aead *aead,
+				      unsigned int authsize)
+{
+	struct gcm_neon_async_ctx *ctx = crypto_aead_ctx(aead);
+	int err;
+
+	err = crypto_aead_setauthsize(cryptd_aead_child(ctx->cryptd_tfm),
+				      authsize);
+	if (err)
+		return err;
+	return crypto_aead_setauthsize(&ctx->cryptd_tfm->base, authsize);
+}
+
+/*
+ * NEON cannot be used from softirq context, which is where most IPsec
+ * traffic is processed, so such requests are deferred to cryptd.
+ */
+static struct aead_request *gcm_neon_async_subreq(struct aead_request *req)
+{
+	struct crypto_aead *aead = crypto_aead_reqtfm(req);
+	struct gcm_neon_async_ctx *ctx = crypto_aead_ctx(aead);
+	struct aead_request *subreq = aead_request_ctx(req);
+
+	memcpy(subreq, req, sizeof(*req));
+	if (may_use_simd())
+		aead_request_set_tfm(subreq,
+				     cryptd_aead_child(ctx->cryptd_tfm));
+	else
+		aead_request_set_tfm(subreq, &ctx->cryptd_tfm->base);
+	return subreq;
+}
+
+static int gcm_neon_async_encrypt(struct aead_request *req)
+{
+	return crypto_aead_encrypt(gcm_neon_async_subreq(req));
+}
+
+static int gcm_neon_async_decrypt(struct aead_request *req)
+{
+	return crypto_aead_decrypt(gcm_neon_async_subreq(req));
+}
+
+static struct crypto_alg gcm_neon_algs[] = { {
+	.cra_name		= "__gcm-aes-neon",
+	.cra_driver_name	= "__driver-gcm-aes-neon",
+	.cra_priority		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_AEAD,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct gcm_neon_ctx),
+	.cra_alignmask		= 7,
+	.cra_type		= &crypto_aead_type,
+	.cra_module		= THIS_MODULE,
+	.cra_aead = {
+		.setkey		= gcm_neon_setkey,
+		.setauthsize	= gcm_neon_setauthsize,
+		.encrypt	= gcm_neon_encrypt,
+		.decrypt	= gcm_neon_decrypt,
+		.ivsize		= 8,
+		.maxauthsize	= 16,
+	},
+}, {
+	.cra_name		= "rfc4106(gcm(aes))",
+	.cra_driver_name	= "rfc4106-gcm-aes-neon",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_AEAD | CRYPTO_ALG_ASYNC,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct gcm_neon_async_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_nivaead_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= gcm_neon_async_init,
+	.cra_exit		= gcm_neon_async_exit,
+	.cra_aead = {
+		.setkey		= gcm_neon_async_setkey,
+		.setauthsize	= gcm_neon_async_setauthsize,
+		.encrypt	= gcm_neon_async_encrypt,
+		.decrypt	= gcm_neon_async_decrypt,
+		.geniv		= "seqiv",
+		.ivsize		= 8,
+		.maxauthsize	= 16,
+	},
+} };
+
+static int __init gcm_neon_mod_init(void)
+{
+	if (!cpu_has_neon())
+		return -ENODEV;
+	return crypto_register_algs(gcm_neon_algs, ARRAY_SIZE(gcm_neon_algs));
+}
+
+static void __exit gcm_neon_mod_exit(void)
+{
+	crypto_unregister_algs(gcm_neon_algs, ARRAY_SIZE(gcm_neon_algs));
+}
+
+module_init(gcm_neon_mod_init);
+module_exit(gcm_neon_mod_exit);
+
+MODULE_DESCRIPTION("AES-GCM (RFC4106) using ARM scalar AES and NEON GHASH");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("rfc4106(gcm(aes))");
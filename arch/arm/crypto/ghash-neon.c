@@ -0,0 +1,161 @@
+/*
+ * linux/arch/arm/crypto/ghash-neon.c - GHASH block update using ARM NEON
+ * intrinsics
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+/*
+ * ARMv7 NEON has no 64x64 bit carry-less multiply, so each 64x64 product is
+ * assembled from eight vmull.p8 (8x8 -> 16 bit) multiplies of byte-rotated
+ * operands, as described in "Fast Software Polynomial Multiplication on ARM
+ * Processors Using the NEON Engine" (Camara, Gouvea, Lopez, Dahab). Three of
+ * those make up a Karatsuba 128x128 multiply, followed by a shift-based
+ * reduction modulo x^128 + x^7 + x^2 + x + 1.
+ *
+ * Field elements are kept in the bit-reflected GHASH representation, as
+ * two 64-bit words holding the big endian halves of the block (word 1 is
+ * bytes 0-7). Multiplying two reflected operands yields the reflected
+ * 255 bit product, which is shifted left by one before the reduction.
+ *
+ * This file is compiled with -mfpu=neon and must only be called from within
+ * a kernel_neon_begin()/kernel_neon_end() pair. As arm_neon.h is not type
+ * compatible with the kernel headers, only C99 types are used here.
+ */
+
+#include <arm_neon.h>
+
+static inline uint64x2_t pmull_p8(uint64x1_t ad, uint64x1_t bd)
+{
+	const uint64x2_t k48_32 = { 0x0000ffffffffffffULL, 0x00000000ffffffffULL };
+	const uint64x2_t k16_0 = { 0x000000000000ffffULL, 0 };
+	uint8x8_t a = vreinterpret_u8_u64(ad);
+	uint8x8_t b = vreinterpret_u8_u64(bd);
+	uint64x2_t t0, t1, t2, t3, d;
+	uint64x1_t lo, hi;
+
+	/* L = A1*B + A*B1, M = A2*B + A*B2, N = A3*B + A*B3, K = A*B4 */
+	t0 = vreinterpretq_u64_p16(veorq_u16(
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(vext_u8(a, a, 1)),
+					       vreinterpret_p8_u8(b))),
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(a),
+					       vreinterpret_p8_u8(vext_u8(b, b, 1))))));
+	t1 = vreinterpretq_u64_p16(veorq_u16(
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(vext_u8(a, a, 2)),
+					       vreinterpret_p8_u8(b))),
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(a),
+					       vreinterpret_p8_u8(vext_u8(b, b, 2))))));
+	t2 = vreinterpretq_u64_p16(veorq_u16(
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(vext_u8(a, a, 3)),
+					       vreinterpret_p8_u8(b))),
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(a),
+					       vreinterpret_p8_u8(vext_u8(b, b, 3))))));
+	t3 = vreinterpretq_u64_p16(vmull_p8(vreinterpret_p8_u8(a),
+				   vreinterpret_p8_u8(vext_u8(b, b, 4))));
+	d = vreinterpretq_u64_p16(vmull_p8(vreinterpret_p8_u8(a),
+					   vreinterpret_p8_u8(b)));
+
+	/*
+	 * Fold the wrapped around upper lanes of each partial product back
+	 * down and mask off the bytes that belong to the next rotation.
+	 */
+	lo = veor_u64(vget_low_u64(t0), vget_high_u64(t0));
+	hi = vand_u64(vget_high_u64(t0), vget_low_u64(k48_32));
+	t0 = vcombine_u64(veor_u64(lo, hi), hi);
+
+	lo = veor_u64(vget_low_u64(t1), vget_high_u64(t1));
+	hi = vand_u64(vget_high_u64(t1), vget_high_u64(k48_32));
+	t1 = vcombine_u64(veor_u64(lo, hi), hi);
+
+	lo = veor_u64(vget_low_u64(t2), vget_high_u64(t2));
+	hi = vand_u64(vget_high_u64(t2), vget_low_u64(k16_0));
+	t2 = vcombine_u64(veor_u64(lo, hi), hi);
+
+	lo = veor_u64(vget_low_u64(t3), vget_high_u64(t3));
+	t3 = vcombine_u64(lo, vget_high_u64(k16_0));
+
+	/* shift L, M, N and K into place: << 8, 16, 24 and 32 bits */
+	t0 = vreinterpretq_u64_u8(vextq_u8(vreinterpretq_u8_u64(t0),
+					   vreinterpretq_u8_u64(t0), 15));
+	t1 = vreinterpretq_u64_u8(vextq_u8(vreinterpretq_u8_u64(t1),
+					   vreinterpretq_u8_u64(t1), 14));
+	t2 = vreinterpretq_u64_u8(vextq_u8(vreinterpretq_u8_u64(t2),
+					   vreinterpretq_u8_u64(t2), 13));
+	t3 = vreinterpretq_u64_u8(vextq_u8(vreinterpretq_u8_u64(t3),
+					   vreinterpretq_u8_u64(t3), 12));
+
+	return veorq_u64(veorq_u64(d, t0), veorq_u64(t1, veorq_u64(t2, t3)));
+}
+
+/* 128 bit logical shift right of the (word 1:word 0) pair */
+#define SHR128(x, n, zero)						\
+	veorq_u64(vshrq_n_u64(x, n),					\
+		  vextq_u64(vshlq_n_u64(x, 64 - (n)), zero, 1))
+
+static inline uint64x2_t ghash_mul(uint64x2_t x, uint64x2_t h, uint64x1_t hk)
+{
+	const uint64x2_t zero = vdupq_n_u64(0);
+	uint64x2_t l, m, hh, a, b, d;
+	uint64x1_t xk, r0, r1, r2, r3, a1;
+
+	/* Karatsuba: L = x0*h0, H = x1*h1, M = (x0^x1)*(h0^h1) ^ L ^ H */
+	xk = veor_u64(vget_low_u64(x), vget_high_u64(x));
+	l = pmull_p8(vget_low_u64(x), vget_low_u64(h));
+	hh = pmull_p8(vget_high_u64(x), vget_high_u64(h));
+	m = veorq_u64(pmull_p8(xk, hk), veorq_u64(l, hh));
+
+	r0 = vget_low_u64(l);
+	r1 = veor_u64(vget_high_u64(l), vget_low_u64(m));
+	r2 = veor_u64(vget_low_u64(hh), vget_high_u64(m));
+	r3 = vget_high_u64(hh);
+
+	/* the reflected product is 255 bits wide: shift it left by one */
+	r3 = vorr_u64(vshl_n_u64(r3, 1), vshr_n_u64(r2, 63));
+	r2 = vorr_u64(vshl_n_u64(r2, 1), vshr_n_u64(r1, 63));
+	r1 = vorr_u64(vshl_n_u64(r1, 1), vshr_n_u64(r0, 63));
+	r0 = vshl_n_u64(r0, 1);
+
+	/*
+	 * (r3:r2) holds the low and (r1:r0) the high half of the product.
+	 * Fold the bits of the high half that overflow when multiplied by
+	 * x^7 + x^2 + x + 1 back in first, then reduce.
+	 */
+	a1 = veor_u64(r1, vshl_n_u64(r0, 63));
+	a1 = veor_u64(a1, vshl_n_u64(r0, 62));
+	a1 = veor_u64(a1, vshl_n_u64(r0, 57));
+	d = vcombine_u64(r0, a1);
+	b = vcombine_u64(r2, r3);
+
+	a = veorq_u64(d, SHR128(d, 1, zero));
+	a = veorq_u64(a, SHR128(d, 2, zero));
+	a = veorq_u64(a, SHR128(d, 7, zero));
+
+	return veorq_u64(a, b);
+}
+
+static inline uint64x2_t load_block(const uint8_t *p)
+{
+	uint64x2_t v = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(p)));
+
+	return vcombine_u64(vget_high_u64(v), vget_low_u64(v));
+}
+
+/*
+ * dg[] and k[] hold the digest and the hash key in the representation
+ * described above: k[1] is the big endian value of key bytes 0-7.
+ */
+void ghash_neon_update(uint64_t dg[2], const uint8_t *src, unsigned int blocks,
+		       const uint64_t k[2])
+{
+	uint64x2_t x = vld1q_u64(dg);
+	uint64x2_t h = vld1q_u64(k);
+	uint64x1_t hk = veor_u64(vget_low_u64(h), vget_high_u64(h));
+
+	while (blocks--) {
+		x = ghash_mul(veorq_u64(x, load_block(src)), h, hk);
+		src += 16;
+	}
+	vst1q_u64(dg, x);
+}
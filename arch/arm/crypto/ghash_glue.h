@@ -0,0 +1,26 @@
+/*
+ * Shared definitions for the NEON GHASH and RFC4106 AES-GCM glue code.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#ifndef _ARM_CRYPTO_GHASH_GLUE_H
+#define _ARM_CRYPTO_GHASH_GLUE_H
+
+#define GHASH_BLOCK_SIZE	16
+#define GHASH_DIGEST_SIZE	16
+
+/*
+ * The hash key and the running digest are kept as two 64-bit words holding
+ * the big endian halves of the 16 byte block, with word 1 holding bytes 0-7.
+ */
+struct ghash_key {
+	u64	k[2];
+};
+
+void ghash_neon_update(u64 dg[], const u8 *src, unsigned int blocks,
+		       const u64 k[]);
+
+#endif /* _ARM_CRYPTO_GHASH_GLUE_H */
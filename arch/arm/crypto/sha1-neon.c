@@ -0,0 +1,144 @@
+/*
+ * linux/arch/arm/crypto/sha1-neon.c - SHA-1 block transform using ARM NEON
+ * intrinsics
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * The message expansion W[16..79] plus the round constants is computed four
+ * words at a time in NEON registers and stored to a stack buffer that the
+ * scalar rounds consume. From W[32] on, the equivalent recurrence
+ *
+ *	W[t] = rol(W[t-6] ^ W[t-16] ^ W[t-28] ^ W[t-32], 2)
+ *
+ * is used, which has no dependency inside a vector of four words.
+ *
+ * This file is compiled with -mfpu=neon and must only be called from within
+ * a kernel_neon_begin()/kernel_neon_end() pair. As arm_neon.h is not type
+ * compatible with the kernel headers, only C99 types are used here.
+ */
+
+#include <arm_neon.h>
+
+#define K1	0x5a827999
+#define K2	0x6ed9eba1
+#define K3	0x8f1bbcdc
+#define K4	0xca62c1d6
+
+static inline uint32_t rol32(uint32_t x, unsigned int n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32x4_t rolq(uint32x4_t x, const int n)
+{
+	return vorrq_u32(vshlq_n_u32(x, n), vshrq_n_u32(x, 32 - n));
+}
+
+static inline uint32x4_t load_be32x4(const uint8_t *p)
+{
+	return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p)));
+}
+
+/* W[t..t+3] from W[t-16..t-1] held in x0..x3, for 16 <= t < 32 */
+static inline uint32x4_t sha1_schedule_lo(uint32x4_t x0, uint32x4_t x1,
+					  uint32x4_t x2, uint32x4_t x3)
+{
+	const uint32x4_t zero = vdupq_n_u32(0);
+	uint32x4_t t, r;
+
+	/* W[t-3..t] with the yet unknown W[t] lane left at zero */
+	t = veorq_u32(vextq_u32(x3, zero, 1), x2);
+	t = veorq_u32(t, vextq_u32(x0, x1, 2));
+	t = veorq_u32(t, x0);
+	r = rolq(t, 1);
+
+	/* fold rol(W[t], 1) into the last lane */
+	return veorq_u32(r, rolq(vextq_u32(zero, r, 1), 1));
+}
+
+/* W[t..t+3] from W[t-32..t-1] held in x0..x7, for t >= 32 */
+static inline uint32x4_t sha1_schedule_hi(uint32x4_t x0, uint32x4_t x1,
+					  uint32x4_t x4, uint32x4_t x6,
+					  uint32x4_t x7)
+{
+	uint32x4_t t;
+
+	t = veorq_u32(vextq_u32(x6, x7, 2), x4);
+	t = veorq_u32(t, x1);
+	t = veorq_u32(t, x0);
+	return rolq(t, 2);
+}
+
+#define F1(b, c, d)	((d) ^ ((b) & ((c) ^ (d))))
+#define F2(b, c, d)	((b) ^ (c) ^ (d))
+#define F3(b, c, d)	(((b) & (c)) | ((d) & ((b) | (c))))
+
+#define ROUND(F, a, b, c, d, e, i) do {					\
+		e += rol32(a, 5) + F(b, c, d) + wk[i];			\
+		b = rol32(b, 30);					\
+	} while (0)
+
+#define ROUND5(F, i) do {						\
+		ROUND(F, a, b, c, d, e, (i) + 0);			\
+		ROUND(F, e, a, b, c, d, (i) + 1);			\
+		ROUND(F, d, e, a, b, c, (i) + 2);			\
+		ROUND(F, c, d, e, a, b, (i) + 3);			\
+		ROUND(F, b, c, d, e, a, (i) + 4);			\
+	} while (0)
+
+void sha1_transform_neon(uint32_t *state, const uint8_t *data,
+			 unsigned int blocks)
+{
+	uint32_t wk[80] __attribute__((aligned(16)));
+	uint32x4_t w[20];
+	uint32x4_t k;
+	uint32_t a, b, c, d, e;
+	int i;
+
+	while (blocks--) {
+		w[0] = load_be32x4(data);
+		w[1] = load_be32x4(data + 16);
+		w[2] = load_be32x4(data + 32);
+		w[3] = load_be32x4(data + 48);
+		data += 64;
+
+		for (i = 4; i < 8; i++)
+			w[i] = sha1_schedule_lo(w[i - 4], w[i - 3], w[i - 2],
+						w[i - 1]);
+		for (i = 8; i < 20; i++)
+			w[i] = sha1_schedule_hi(w[i - 8], w[i - 7], w[i - 4],
+						w[i - 2], w[i - 1]);
+
+		for (i = 0; i < 20; i++) {
+			k = vdupq_n_u32(i < 5 ? K1 : i < 10 ? K2 :
+					i < 15 ? K3 : K4);
+			vst1q_u32(&wk[4 * i], vaddq_u32(w[i], k));
+		}
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+
+		for (i = 0; i < 20; i += 5)
+			ROUND5(F1, i);
+		for (; i < 40; i += 5)
+			ROUND5(F2, i);
+		for (; i < 60; i += 5)
+			ROUND5(F3, i);
+		for (; i < 80; i += 5)
+			ROUND5(F2, i);
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+	}
+}
@@ -0,0 +1,169 @@
+/*
+ * linux/arch/arm/crypto/sha256-neon.c - SHA-224/SHA-256 block transform
+ * using ARM NEON intrinsics
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * The message schedule is computed four words at a time in NEON registers,
+ * with the round constants already added, and handed to the (scalar) round
+ * function through a small stack buffer. This removes the load/rotate/add
+ * chain of the schedule from the integer pipeline, which is where the A9
+ * spends most of its time in sha256_generic.
+ *
+ * This file is compiled with -mfpu=neon and must only be called from within
+ * a kernel_neon_begin()/kernel_neon_end() pair. As arm_neon.h is not type
+ * compatible with the kernel headers, only C99 types are used here.
+ */
+
+#include <arm_neon.h>
+
+static const uint32_t sha256_k[64] __attribute__((aligned(16))) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t ror32(uint32_t x, unsigned int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+#define Ch(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define Maj(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define e0(x)		(ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22))
+#define e1(x)		(ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25))
+
+/* sigma0 = ror 7 ^ ror 18 ^ shr 3, four lanes at a time */
+static inline uint32x4_t s0q(uint32x4_t x)
+{
+	uint32x4_t t;
+
+	t = veorq_u32(vshrq_n_u32(x, 7), vshlq_n_u32(x, 25));
+	t = veorq_u32(t, vshrq_n_u32(x, 18));
+	t = veorq_u32(t, vshlq_n_u32(x, 14));
+	return veorq_u32(t, vshrq_n_u32(x, 3));
+}
+
+/* sigma1 = ror 17 ^ ror 19 ^ shr 10, two lanes at a time */
+static inline uint32x2_t s1d(uint32x2_t x)
+{
+	uint32x2_t t;
+
+	t = veor_u32(vshr_n_u32(x, 17), vshl_n_u32(x, 15));
+	t = veor_u32(t, vshr_n_u32(x, 19));
+	t = veor_u32(t, vshl_n_u32(x, 13));
+	return veor_u32(t, vshr_n_u32(x, 10));
+}
+
+/*
+ * Given W[t-16..t-1] in x0..x3, return W[t..t+3]. The upper two lanes depend
+ * on the lower two through sigma1, so those are produced in two halves.
+ */
+static inline uint32x4_t sha256_schedule(uint32x4_t x0, uint32x4_t x1,
+					 uint32x4_t x2, uint32x4_t x3)
+{
+	uint32x4_t t;
+	uint32x2_t lo, hi;
+
+	t = vaddq_u32(x0, s0q(vextq_u32(x0, x1, 1)));
+	t = vaddq_u32(t, vextq_u32(x2, x3, 1));
+
+	lo = vadd_u32(vget_low_u32(t), s1d(vget_high_u32(x3)));
+	hi = vadd_u32(vget_high_u32(t), s1d(lo));
+
+	return vcombine_u32(lo, hi);
+}
+
+static inline uint32x4_t load_be32x4(const uint8_t *p)
+{
+	return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p)));
+}
+
+#define ROUND(a, b, c, d, e, f, g, h, i) do {				\
+		uint32_t t1 = h + e1(e) + Ch(e, f, g) + wk[i];		\
+		uint32_t t2 = e0(a) + Maj(a, b, c);			\
+		d += t1;						\
+		h = t1 + t2;						\
+	} while (0)
+
+#define ROUND8(i) do {							\
+		ROUND(a, b, c, d, e, f, g, h, (i) + 0);			\
+		ROUND(h, a, b, c, d, e, f, g, (i) + 1);			\
+		ROUND(g, h, a, b, c, d, e, f, (i) + 2);			\
+		ROUND(f, g, h, a, b, c, d, e, (i) + 3);			\
+		ROUND(e, f, g, h, a, b, c, d, (i) + 4);			\
+		ROUND(d, e, f, g, h, a, b, c, (i) + 5);			\
+		ROUND(c, d, e, f, g, h, a, b, (i) + 6);			\
+		ROUND(b, c, d, e, f, g, h, a, (i) + 7);			\
+	} while (0)
+
+void sha256_transform_neon(uint32_t *state, const uint8_t *data,
+			   unsigned int blocks)
+{
+	uint32_t wk[64] __attribute__((aligned(16)));
+	uint32_t a, b, c, d, e, f, g, h;
+	uint32x4_t x0, x1, x2, x3, x4;
+	int i;
+
+	while (blocks--) {
+		x0 = load_be32x4(data);
+		x1 = load_be32x4(data + 16);
+		x2 = load_be32x4(data + 32);
+		x3 = load_be32x4(data + 48);
+		data += 64;
+
+		for (i = 0; i < 64; i += 4) {
+			vst1q_u32(&wk[i], vaddq_u32(x0, vld1q_u32(&sha256_k[i])));
+			if (i < 48) {
+				x4 = sha256_schedule(x0, x1, x2, x3);
+				x0 = x1;
+				x1 = x2;
+				x2 = x3;
+				x3 = x4;
+			} else {
+				x0 = x1;
+				x1 = x2;
+				x2 = x3;
+			}
+		}
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+
+		for (i = 0; i < 64; i += 8)
+			ROUND8(i);
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
@@ -25,8 +25,12 @@ void __check_vmalloc_seq(struct mm_struct *mm);
 
 #ifdef CONFIG_CPU_HAS_ASID
 
+struct seq_file;
+
 void check_and_switch_context(struct mm_struct *mm, struct task_struct *tsk);
 #define init_new_context(tsk,mm)	({ atomic64_set(&mm->context.id, 0); 0; })
+void destroy_context(struct mm_struct *mm);
+void asid_stats_show(struct seq_file *m);
 
 #ifdef CONFIG_ARM_ERRATA_798181
 void a15_erratum_get_cpumask(int this_cpu, struct mm_struct *mm,
@@ -86,10 +90,11 @@ static inline void finish_arch_post_lock_switch(void)
 #endif	/* CONFIG_MMU */
 
 #define init_new_context(tsk,mm)	0
+#define destroy_context(mm)		do { } while(0)
+#define asid_stats_show(m)		do { } while(0)
 
 #endif	/* CONFIG_CPU_HAS_ASID */
 
-#define destroy_context(mm)		do { } while(0)
 #define activate_mm(prev,next)		switch_mm(prev, next, NULL)
 
 /*
@@ -7,7 +7,9 @@
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
  */
+#include <linux/debugfs.h>
 #include <linux/preempt.h>
+#include <linux/seq_file.h>
 #include <linux/smp.h>
 
 #include <asm/smp_plat.h>
@@ -25,6 +27,37 @@ struct tlb_args {
 	unsigned long ta_end;
 };
 
+/*
+ * Beyond this many pages a range is flushed by ASID (or entirely for the
+ * kernel) rather than page by page. Refilling a few TLB entries costs less
+ * than a long run of broadcast per-MVA operations.
+ */
+#define TLB_RANGE_MAX_PAGES	64
+
+struct tlb_stats {
+	unsigned long local;		/* mm only ran on this CPU */
+	unsigned long broadcast;	/* inner shareable operation */
+	unsigned long ipi;		/* cross call to the mm's CPUs */
+	unsigned long range_as_mm;	/* large range flushed by ASID */
+};
+
+static DEFINE_PER_CPU(struct tlb_stats, tlb_stats);
+
+#define tlb_stat_inc(field)	this_cpu_inc(tlb_stats.field)
+
+/*
+ * mm_cpumask() holds every CPU that has run the mm since it got its current
+ * ASID, see check_and_switch_context(). If that is at most this CPU, no
+ * other TLB can hold entries for the ASID and a local operation does.
+ * Called with preemption disabled.
+ */
+static inline bool tlb_mm_is_local(struct mm_struct *mm)
+{
+	/* order the page table update before reading the cpumask */
+	smp_mb();
+	return cpumask_any_but(mm_cpumask(mm), smp_processor_id()) >= nr_cpu_ids;
+}
+
 static inline void ipi_flush_tlb_all(void *ignored)
 {
 	local_flush_tlb_all();
@@ -142,10 +175,20 @@ void flush_tlb_all(void)
 
 void flush_tlb_mm(struct mm_struct *mm)
 {
-	if (tlb_ops_need_broadcast())
+	if (tlb_ops_need_broadcast()) {
+		tlb_stat_inc(ipi);
 		on_each_cpu_mask(mm_cpumask(mm), ipi_flush_tlb_mm, mm, 1);
-	else
-		__flush_tlb_mm(mm);
+	} else {
+		preempt_disable();
+		if (tlb_mm_is_local(mm)) {
+			tlb_stat_inc(local);
+			local_flush_tlb_mm(mm);
+		} else {
+			tlb_stat_inc(broadcast);
+			__flush_tlb_mm(mm);
+		}
+		preempt_enable();
+	}
 	broadcast_tlb_mm_a15_erratum(mm);
 }
 
@@ -155,10 +198,20 @@ void flush_tlb_page(struct vm_area_struct *vma, unsigned long uaddr)
 		struct tlb_args ta;
 		ta.ta_vma = vma;
 		ta.ta_start = uaddr;
+		tlb_stat_inc(ipi);
 		on_each_cpu_mask(mm_cpumask(vma->vm_mm), ipi_flush_tlb_page,
 					&ta, 1);
-	} else
-		__flush_tlb_page(vma, uaddr);
+	} else {
+		preempt_disable();
+		if (tlb_mm_is_local(vma->vm_mm)) {
+			tlb_stat_inc(local);
+			local_flush_tlb_page(vma, uaddr);
+		} else {
+			tlb_stat_inc(broadcast);
+			__flush_tlb_page(vma, uaddr);
+		}
+		preempt_enable();
+	}
 	broadcast_tlb_mm_a15_erratum(vma->vm_mm);
 }
 
@@ -176,20 +229,34 @@ void flush_tlb_kernel_page(unsigned long kaddr)
 void flush_tlb_range(struct vm_area_struct *vma,
                      unsigned long start, unsigned long end)
 {
+	if ((end - start) >> PAGE_SHIFT > TLB_RANGE_MAX_PAGES) {
+		tlb_stat_inc(range_as_mm);
+		flush_tlb_mm(vma->vm_mm);
+		return;
+	}
+
 	if (tlb_ops_need_broadcast()) {
 		struct tlb_args ta;
 		ta.ta_vma = vma;
 		ta.ta_start = start;
 		ta.ta_end = end;
+		tlb_stat_inc(ipi);
 		on_each_cpu_mask(mm_cpumask(vma->vm_mm), ipi_flush_tlb_range,
 					&ta, 1);
-	} else
+	} else {
+		tlb_stat_inc(broadcast);
 		local_flush_tlb_range(vma, start, end);
+	}
 	broadcast_tlb_mm_a15_erratum(vma->vm_mm);
 }
 
 void flush_tlb_kernel_range(unsigned long start, unsigned long end)
 {
+	if ((end - start) >> PAGE_SHIFT > TLB_RANGE_MAX_PAGES) {
+		flush_tlb_all();
+		return;
+	}
+
 	if (tlb_ops_need_broadcast()) {
 		struct tlb_args ta;
 		ta.ta_start = start;
@@ -207,3 +274,40 @@ void flush_bp_all(void)
 	else
 		__flush_bp_all();
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int tlb_stats_show(struct seq_file *m, void *v)
+{
+	struct tlb_stats *st;
+	int cpu;
+
+	seq_printf(m, "%-6s %12s %12s %12s %12s\n",
+		   "", "local", "broadcast", "ipi", "range_as_mm");
+	for_each_online_cpu(cpu) {
+		st = &per_cpu(tlb_stats, cpu);
+		seq_printf(m, "CPU%-3d %12lu %12lu %12lu %12lu\n", cpu,
+			   st->local, st->broadcast, st->ipi, st->range_as_mm);
+	}
+	asid_stats_show(m);
+	return 0;
+}
+
+static int tlb_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tlb_stats_show, NULL);
+}
+
+static const struct file_operations tlb_stats_fops = {
+	.open		= tlb_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tlb_stats_init(void)
+{
+	debugfs_create_file("tlb_flush", S_IRUSR, NULL, NULL, &tlb_stats_fops);
+	return 0;
+}
+late_initcall(tlb_stats_init);
+#endif
@@ -28,6 +28,8 @@
 #include <linux/memblock.h>
 #include <linux/irqchip.h>
 #include <linux/irqchip/arm-gic.h>
+#include <linux/amba/bus.h>
+#include <linux/dma-mapping.h>
 
 #include <asm/mach/arch.h>
 #include <asm/mach/map.h>
@@ -61,6 +63,35 @@ static void __init zynq_memory_init(void)
 		memblock_reserve(__pa(PAGE_OFFSET), __pa(swapper_pg_dir));
 }
 
+/*
+ * PL masters wired to the Accelerator Coherency Port snoop the A9 L1 caches
+ * and allocate into L2, so they need no cache maintenance around streaming
+ * DMA. Masters on the HP ports do, and keep the default non-coherent ops.
+ * The PL design must drive AxCACHE/AxUSER on the ACP for the accesses to be
+ * treated as coherent; the "dma-coherent" property asserts that it does.
+ */
+static int zynq_platform_notifier(struct notifier_block *nb,
+				  unsigned long event, void *__dev)
+{
+	struct device *dev = __dev;
+
+	if (event != BUS_NOTIFY_ADD_DEVICE)
+		return NOTIFY_DONE;
+
+	if (of_property_read_bool(dev->of_node, "dma-coherent"))
+		set_dma_ops(dev, &arm_coherent_dma_ops);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block zynq_amba_nb = {
+	.notifier_call = zynq_platform_notifier,
+};
+
+static struct notifier_block zynq_platform_nb = {
+	.notifier_call = zynq_platform_notifier,
+};
+
 static struct platform_device zynq_cpuidle_device = {
 	.name = "cpuidle-zynq",
 };
@@ -102,6 +133,9 @@ static void __init zynq_init_machine(void)
 {
 	struct platform_device_info devinfo = { .name = "cpufreq-cpu0", };
 
+	bus_register_notifier(&platform_bus_type, &zynq_platform_nb);
+	bus_register_notifier(&amba_bustype, &zynq_amba_nb);
+
 	of_platform_populate(NULL, of_default_bus_match_table, NULL, NULL);
 
 	platform_device_register(&zynq_cpuidle_device);
@@ -100,6 +100,14 @@ static int zynq_ocm_probe(struct platform_device *pdev)
 	if (!zynq_ocm->pool)
 		return -ENOMEM;
 
+	/*
+	 * OCM mostly hands out small DMA descriptors and buffers; serve
+	 * those from per-CPU bins instead of scanning the pool bitmap.
+	 */
+	ret = gen_pool_enable_cache(zynq_ocm->pool);
+	if (ret)
+		return ret;
+
 	curr = 0; /* For storing current struct resource for OCM */
 	for (i = 0; i < ZYNQ_OCM_BLOCKS; i++) {
 		u32 base, start, end;
@@ -197,6 +205,7 @@ static int zynq_ocm_probe(struct platform_device *pdev)
 	writel(ZYNQ_OCM_PARITY_ENABLE, zynq_ocm->base + ZYNQ_OCM_PARITY_CTRL);
 
 	platform_set_drvdata(pdev, zynq_ocm);
+	gen_pool_debugfs_create(zynq_ocm->pool, dev_name(&pdev->dev));
 
 	return 0;
 }
@@ -215,6 +224,7 @@ static int zynq_ocm_remove(struct platform_device *pdev)
 {
 	struct zynq_ocm_dev *zynq_ocm = platform_get_drvdata(pdev);
 
+	gen_pool_drain_cache(zynq_ocm->pool);
 	if (gen_pool_avail(zynq_ocm->pool) < gen_pool_size(zynq_ocm->pool))
 		dev_dbg(&pdev->dev, "removed while SRAM allocated\n");
 
@@ -15,6 +15,7 @@
 #include <linux/mm.h>
 #include <linux/smp.h>
 #include <linux/percpu.h>
+#include <linux/seq_file.h>
 
 #include <asm/mmu_context.h>
 #include <asm/smp_plat.h>
@@ -50,6 +51,10 @@ static DEFINE_PER_CPU(atomic64_t, active_asids);
 static DEFINE_PER_CPU(u64, reserved_asids);
 static cpumask_t tlb_flush_pending;
 
+/* protected by cpu_asid_lock */
+static unsigned long asid_rollovers;
+static unsigned long asid_recycled;
+
 #ifdef CONFIG_ARM_ERRATA_798181
 void a15_erratum_get_cpumask(int this_cpu, struct mm_struct *mm,
 			     cpumask_t *mask)
@@ -202,10 +207,14 @@ static u64 new_context(struct mm_struct *mm, unsigned int cpu)
 		 * the module area and the userspace stack.
 		 */
 		asid = find_next_zero_bit(asid_map, NUM_USER_ASIDS, cur_idx);
+		/* ASIDs released by destroy_context() are below cur_idx */
+		if (asid == NUM_USER_ASIDS)
+			asid = find_next_zero_bit(asid_map, NUM_USER_ASIDS, 1);
 		if (asid == NUM_USER_ASIDS) {
 			generation = atomic64_add_return(ASID_FIRST_VERSION,
 							 &asid_generation);
 			flush_context(cpu);
+			asid_rollovers++;
 			asid = find_next_zero_bit(asid_map, NUM_USER_ASIDS, 1);
 		}
 		__set_bit(asid, asid_map);
@@ -235,8 +244,18 @@ void check_and_switch_context(struct mm_struct *mm, struct task_struct *tsk)
 
 	asid = atomic64_read(&mm->context.id);
 	if (!((asid ^ atomic64_read(&asid_generation)) >> ASID_BITS)
-	    && atomic64_xchg(&per_cpu(active_asids, cpu), asid))
+	    && atomic64_xchg(&per_cpu(active_asids, cpu), asid)) {
+		/*
+		 * The TLB flush code relies on mm_cpumask() holding every
+		 * CPU that ran the mm with this ASID, see tlb_mm_is_local().
+		 * Publish this CPU before its table walker may use the ASID.
+		 */
+		if (!cpumask_test_cpu(cpu, mm_cpumask(mm))) {
+			cpumask_set_cpu(cpu, mm_cpumask(mm));
+			dsb(ish);
+		}
 		goto switch_mm_fastpath;
+	}
 
 	raw_spin_lock_irqsave(&cpu_asid_lock, flags);
 	/* Check that our ASID belongs to the current generation. */
@@ -253,8 +272,44 @@ void check_and_switch_context(struct mm_struct *mm, struct task_struct *tsk)
 
 	atomic64_set(&per_cpu(active_asids, cpu), asid);
 	cpumask_set_cpu(cpu, mm_cpumask(mm));
+	dsb(ish);
 	raw_spin_unlock_irqrestore(&cpu_asid_lock, flags);
 
 switch_mm_fastpath:
 	cpu_switch_mm(mm->pgd, mm);
 }
+
+/*
+ * Give the ASID of a dead mm back to the current generation, so that
+ * workloads forking many short-lived processes don't roll over (and flush
+ * every TLB) each time 255 mms have been created. No CPU runs the mm any
+ * more, but its entries may still sit in any TLB, so the ASID is flushed
+ * everywhere first. That is only done where the TLB operations broadcast
+ * in hardware, as mmdrop() may be called with interrupts disabled.
+ */
+void destroy_context(struct mm_struct *mm)
+{
+	unsigned long flags;
+	u64 asid;
+
+	asid = atomic64_read(&mm->context.id);
+	if (!asid || tlb_ops_need_broadcast())
+		return;
+
+	__flush_tlb_mm(mm);
+
+	raw_spin_lock_irqsave(&cpu_asid_lock, flags);
+	if (!((asid ^ atomic64_read(&asid_generation)) >> ASID_BITS) &&
+	    !is_reserved_asid(asid)) {
+		__clear_bit(asid & ~ASID_MASK, asid_map);
+		asid_recycled++;
+	}
+	raw_spin_unlock_irqrestore(&cpu_asid_lock, flags);
+}
+
+void asid_stats_show(struct seq_file *m)
+{
+	seq_printf(m, "asid generation %llu, rollovers %lu, recycled %lu\n",
+		   (u64)atomic64_read(&asid_generation) >> ASID_BITS,
+		   asid_rollovers, asid_recycled);
+}
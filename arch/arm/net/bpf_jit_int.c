@@ -0,0 +1,1078 @@
+/*
+ * Just-In-Time compiler for the internal BPF instruction set on 32bit ARM
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; version 2 of the License.
+ */
+
+#include <linux/bitops.h>
+#include <linux/compiler.h>
+#include <linux/errno.h>
+#include <linux/filter.h>
+#include <linux/moduleloader.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <asm/cacheflush.h>
+#include <asm/div64.h>
+#include <asm/opcodes.h>
+#include <asm/unaligned.h>
+
+#include "bpf_jit_32.h"
+
+/*
+ * ABI:
+ *
+ * r4:r5	BPF register R0
+ * r6:r7	BPF register R7, X of converted classic filters
+ * r8:r9	BPF register R6, the context
+ * r10		the program argument, the skb for LD_ABS and LD_IND
+ * r0-r3	two scratch pairs, with ip and lr
+ *
+ * A 64-bit BPF register is kept in a pair of ARM registers, the low word in
+ * the lower numbered one, or in a stack slot.  R3-R5 sit where a function
+ * expects its third to fifth 64-bit argument, so BPF_CALL only has to load
+ * R1 and R2; like the calling convention it models, a call may change them.
+ * R10 is the top of the BPF stack, which follows the slots, and can't be
+ * written.
+ */
+
+#define r_skb		ARM_R10
+#define r_tmp		ARM_R0		/* scratch pair for the destination */
+#define r_tmp2		ARM_R2		/* scratch pair for the source */
+
+#define ON_STACK	0xff
+
+static const u8 bpf2a32[MAX_BPF_REG] = {
+	[0 ... MAX_BPF_REG - 1] = ON_STACK,
+	[0] = ARM_R4,
+	[CTX_REG] = ARM_R8,
+	[7] = ARM_R6,
+};
+
+static const u8 bpf_stack_off[MAX_BPF_REG] = {
+	[3] = 0,
+	[4] = 8,
+	[5] = 16,
+	[ARG1_REG] = 24,
+	[2] = 32,
+	[8] = 40,
+	[9] = 48,
+};
+
+#define STACK_BPF	56
+#define STACK_SIZE	(STACK_BPF + MAX_BPF_STACK)
+
+/* r4-r12 and lr or pc: ten registers keep the stack 8 byte aligned */
+#define SAVED_REGS	0x1ff0
+
+struct jit_ctx {
+	const struct sock_filter_int *insns;
+	unsigned int len;
+	unsigned int idx;
+	unsigned int exit_idx;
+	unsigned int ret0_idx;
+	u32 *offsets;
+	u32 *target;
+};
+
+/*
+ * Helpers for what ARMv7-A has no instruction for, with the semantics of
+ * do_div() in __sk_run_filter().  A 64-bit division is by the low word of
+ * the divisor.
+ */
+static u32 jit_udiv32(u32 dividend, u32 divisor)
+{
+	u64 tmp = dividend;
+
+	do_div(tmp, divisor);
+	return tmp;
+}
+
+static u32 jit_umod32(u32 dividend, u32 divisor)
+{
+	u64 tmp = dividend;
+
+	return do_div(tmp, divisor);
+}
+
+static u64 jit_udiv64(u64 dividend, u32 divisor)
+{
+	do_div(dividend, divisor);
+	return dividend;
+}
+
+static u64 jit_umod64(u64 dividend, u32 divisor)
+{
+	return do_div(dividend, divisor);
+}
+
+/*
+ * Slow path of LD_ABS and LD_IND: data outside the linear part of the skb
+ * and negative offsets.  The value comes back in the low word, the high
+ * word is non-zero if it's not in the packet.
+ */
+static u64 jit_skb_load(const struct sk_buff *skb, int k, unsigned int size)
+{
+	u8 buf[4];
+	void *ptr;
+
+	if (k >= 0)
+		ptr = skb_header_pointer(skb, k, size, buf);
+	else
+		ptr = bpf_internal_load_pointer_neg_helper(skb, k, size);
+
+	if (ptr == NULL)
+		return 1ULL << 32;
+
+	switch (size) {
+	case 1:
+		return *(u8 *)ptr;
+	case 2:
+		return get_unaligned_be16(ptr);
+	default:
+		return get_unaligned_be32(ptr);
+	}
+}
+
+static inline void _emit(int cond, u32 inst, struct jit_ctx *ctx)
+{
+	inst |= (cond << 28);
+	inst = __opcode_to_mem_arm(inst);
+
+	if (ctx->target != NULL)
+		ctx->target[ctx->idx] = inst;
+
+	ctx->idx++;
+}
+
+static inline void emit(u32 inst, struct jit_ctx *ctx)
+{
+	_emit(ARM_COND_AL, inst, ctx);
+}
+
+/*
+ * Branch to the instruction at index tgt.  Sizes don't change between the
+ * passes, so all offsets are known in the second one.
+ */
+static inline void emit_b(int cond, unsigned int tgt, struct jit_ctx *ctx)
+{
+	_emit(cond, ARM_B(tgt - (ctx->idx + 2)), ctx);
+}
+
+/* a forward branch within an instruction, patched by fixup_b() */
+static inline unsigned int emit_b_fwd(struct jit_ctx *ctx)
+{
+	return ctx->idx++;
+}
+
+static inline void fixup_b(int cond, unsigned int at, struct jit_ctx *ctx)
+{
+	if (ctx->target != NULL)
+		ctx->target[at] = __opcode_to_mem_arm(cond << 28 |
+					ARM_B(ctx->idx - (at + 2)));
+}
+
+static int16_t imm8m(u32 x)
+{
+	u32 rot;
+
+	for (rot = 0; rot < 16; rot++)
+		if ((x & ~ror32(0xff, 2 * rot)) == 0)
+			return rol32(x, 2 * rot) | (rot << 8);
+
+	return -1;
+}
+
+static void emit_mov_i(u8 rd, u32 val, struct jit_ctx *ctx)
+{
+	int imm12 = imm8m(val);
+
+	if (imm12 >= 0) {
+		emit(ARM_MOV_I(rd, imm12), ctx);
+		return;
+	}
+
+	imm12 = imm8m(~val);
+	if (imm12 >= 0) {
+		emit(ARM_MVN_I(rd, imm12), ctx);
+		return;
+	}
+
+	emit(ARM_MOVW(rd, val & 0xffff), ctx);
+	if (val > 0xffff)
+		emit(ARM_MOVT(rd, val >> 16), ctx);
+}
+
+/* rd = rn + k, rn must not be ip */
+static void emit_add_i(u8 rd, u8 rn, s32 k, struct jit_ctx *ctx)
+{
+	int imm12 = imm8m(k);
+
+	if (imm12 >= 0) {
+		emit(ARM_ADD_I(rd, rn, imm12), ctx);
+		return;
+	}
+
+	imm12 = imm8m(-k);
+	if (imm12 >= 0) {
+		emit(ARM_SUB_I(rd, rn, imm12), ctx);
+		return;
+	}
+
+	emit_mov_i(ARM_IP, k, ctx);
+	emit(ARM_ADD_R(rd, rn, ARM_IP), ctx);
+}
+
+static inline void emit_mov_r(u8 rd, u8 rm, struct jit_ctx *ctx)
+{
+	if (rd != rm)
+		emit(ARM_MOV_R(rd, rm), ctx);
+}
+
+/*
+ * Load or store with the immediate offset form of inst, going through ip
+ * if the offset doesn't fit: 12 bits, or 8 for halfwords.
+ */
+static void emit_ldst(u32 inst, bool half, u8 rt, u8 rn, s32 off,
+		      struct jit_ctx *ctx)
+{
+	s32 max = half ? 0xff : 0xfff;
+
+	if (off > max || off < -max) {
+		emit_add_i(ARM_IP, rn, off, ctx);
+		rn = ARM_IP;
+		off = 0;
+	}
+
+	if (off < 0) {
+		inst &= ~ARM_INST_LDST_U;
+		off = -off;
+	}
+
+	if (half)
+		off = (off & 0xf0) << 4 | (off & 0xf);
+
+	emit(inst | rt << 12 | rn << 16 | off, ctx);
+}
+
+/* the register with the low word of reg, loaded into tmp if on the stack */
+static u8 get_lo(u8 reg, u8 tmp, struct jit_ctx *ctx)
+{
+	if (reg == FP_REG) {
+		emit_add_i(tmp, ARM_SP, STACK_SIZE, ctx);
+		return tmp;
+	}
+
+	if (bpf2a32[reg] != ON_STACK)
+		return bpf2a32[reg];
+
+	emit(ARM_LDR_I(tmp, ARM_SP, bpf_stack_off[reg]), ctx);
+	return tmp;
+}
+
+/* the register pair with reg, loaded into tmp and tmp + 1 if on the stack */
+static u8 get64(u8 reg, u8 tmp, struct jit_ctx *ctx)
+{
+	if (reg == FP_REG) {
+		emit_add_i(tmp, ARM_SP, STACK_SIZE, ctx);
+		emit(ARM_MOV_I(tmp + 1, 0), ctx);
+		return tmp;
+	}
+
+	if (bpf2a32[reg] != ON_STACK)
+		return bpf2a32[reg];
+
+	emit(ARM_LDR_I(tmp, ARM_SP, bpf_stack_off[reg]), ctx);
+	emit(ARM_LDR_I(tmp + 1, ARM_SP, bpf_stack_off[reg] + 4), ctx);
+	return tmp;
+}
+
+/* the register pair a result for reg is computed in */
+static inline u8 dst64(u8 reg, u8 tmp)
+{
+	return bpf2a32[reg] != ON_STACK ? bpf2a32[reg] : tmp;
+}
+
+/* write back the result for reg computed in the pair rd */
+static void put64(u8 reg, u8 rd, struct jit_ctx *ctx)
+{
+	if (bpf2a32[reg] == ON_STACK) {
+		emit(ARM_STR_I(rd, ARM_SP, bpf_stack_off[reg]), ctx);
+		emit(ARM_STR_I(rd + 1, ARM_SP, bpf_stack_off[reg] + 4), ctx);
+	} else {
+		emit_mov_r(bpf2a32[reg], rd, ctx);
+		emit_mov_r(bpf2a32[reg] + 1, rd + 1, ctx);
+	}
+}
+
+/* base register and offset for a memory access through reg */
+static u8 get_base(u8 reg, s32 *off, struct jit_ctx *ctx)
+{
+	if (reg == FP_REG) {
+		*off += STACK_SIZE;
+		return ARM_SP;
+	}
+
+	return get_lo(reg, r_tmp, ctx);
+}
+
+static inline void emit_call(void *func, struct jit_ctx *ctx)
+{
+	emit_mov_i(ARM_IP, (u32)func, ctx);
+	emit(ARM_BLX_R(ARM_IP), ctx);
+}
+
+static void build_prologue(struct jit_ctx *ctx)
+{
+	emit(ARM_PUSH(SAVED_REGS | 1 << ARM_LR), ctx);
+	emit(ARM_SUB_I(ARM_SP, ARM_SP, imm8m(STACK_SIZE)), ctx);
+
+	/* R1 is the context, R0 and R7 start out as zero */
+	emit(ARM_MOV_R(r_skb, ARM_R0), ctx);
+	emit(ARM_MOV_I(ARM_R4, 0), ctx);
+	emit(ARM_MOV_I(ARM_R5, 0), ctx);
+	emit(ARM_MOV_I(ARM_R6, 0), ctx);
+	emit(ARM_MOV_I(ARM_R7, 0), ctx);
+	emit(ARM_STR_I(ARM_R0, ARM_SP, bpf_stack_off[ARG1_REG]), ctx);
+	emit(ARM_STR_I(ARM_R5, ARM_SP, bpf_stack_off[ARG1_REG] + 4), ctx);
+}
+
+static void build_epilogue(struct jit_ctx *ctx)
+{
+	ctx->exit_idx = ctx->idx;
+	emit(ARM_MOV_R(ARM_R0, bpf2a32[0]), ctx);
+	emit(ARM_ADD_I(ARM_SP, ARM_SP, imm8m(STACK_SIZE)), ctx);
+	emit(ARM_POP(SAVED_REGS | 1 << ARM_PC), ctx);
+
+	/* failed packet loads and divisions by zero return 0 */
+	ctx->ret0_idx = ctx->idx;
+	emit(ARM_MOV_I(ARM_R0, 0), ctx);
+	emit(ARM_ADD_I(ARM_SP, ARM_SP, imm8m(STACK_SIZE)), ctx);
+	emit(ARM_POP(SAVED_REGS | 1 << ARM_PC), ctx);
+}
+
+/* dst op= src on the low words */
+static int emit_alu32(u8 op, u8 rd, u8 rs, struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_ADD:
+		emit(ARM_ADD_R(rd, rd, rs), ctx);
+		break;
+	case BPF_SUB:
+		emit(ARM_SUB_R(rd, rd, rs), ctx);
+		break;
+	case BPF_AND:
+		emit(ARM_AND_R(rd, rd, rs), ctx);
+		break;
+	case BPF_OR:
+		emit(ARM_ORR_R(rd, rd, rs), ctx);
+		break;
+	case BPF_XOR:
+		emit(ARM_EOR_R(rd, rd, rs), ctx);
+		break;
+	case BPF_MUL:
+		emit(ARM_MUL(rd, rd, rs), ctx);
+		break;
+	case BPF_LSH:
+		emit(ARM_LSL_R(rd, rd, rs), ctx);
+		break;
+	case BPF_RSH:
+		emit(ARM_LSR_R(rd, rd, rs), ctx);
+		break;
+	case BPF_MOV:
+		emit_mov_r(rd, rs, ctx);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/* dst op= K on the low words, false if there's no immediate form */
+static bool emit_alu32_i(u8 op, u8 rd, u32 k, struct jit_ctx *ctx)
+{
+	int imm12 = imm8m(k);
+
+	switch (op) {
+	case BPF_ADD:
+		if (imm12 < 0 && imm8m(-k) >= 0) {
+			emit(ARM_SUB_I(rd, rd, imm8m(-k)), ctx);
+			return true;
+		}
+		if (imm12 >= 0)
+			emit(ARM_ADD_I(rd, rd, imm12), ctx);
+		break;
+	case BPF_SUB:
+		if (imm12 >= 0)
+			emit(ARM_SUB_I(rd, rd, imm12), ctx);
+		break;
+	case BPF_AND:
+		if (imm12 < 0 && imm8m(~k) >= 0) {
+			emit(ARM_BIC_I(rd, rd, imm8m(~k)), ctx);
+			return true;
+		}
+		if (imm12 >= 0)
+			emit(ARM_AND_I(rd, rd, imm12), ctx);
+		break;
+	case BPF_OR:
+		if (imm12 >= 0)
+			emit(ARM_ORR_I(rd, rd, imm12), ctx);
+		break;
+	case BPF_XOR:
+		if (imm12 >= 0)
+			emit(ARM_EOR_I(rd, rd, imm12), ctx);
+		break;
+	case BPF_LSH:
+		if (k >= 32)
+			return false;
+		if (k)
+			emit(ARM_LSL_I(rd, rd, k), ctx);
+		return true;
+	case BPF_RSH:
+		if (k >= 32)
+			return false;
+		if (k)
+			emit(ARM_LSR_I(rd, rd, k), ctx);
+		return true;
+	case BPF_MOV:
+		emit_mov_i(rd, k, ctx);
+		return true;
+	default:
+		return false;
+	}
+	return imm12 >= 0;
+}
+
+/*
+ * 64-bit shifts by a register: ARM register shifts of 32 or more give 0
+ * (or the sign for ASR), which the sequences rely on.  rs must not be in
+ * the rd pair.
+ */
+static void emit_shift64_r(u8 op, u8 rd, u8 rs, struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_LSH:
+		emit(ARM_SUB_I(ARM_IP, rs, 32), ctx);
+		emit(ARM_RSB_I(ARM_LR, rs, 32), ctx);
+		emit(ARM_LSL_R(rd + 1, rd + 1, rs), ctx);
+		emit(ARM_ORR_SR(rd + 1, rd + 1, rd, SRTYPE_LSL, ARM_IP), ctx);
+		emit(ARM_ORR_SR(rd + 1, rd + 1, rd, SRTYPE_LSR, ARM_LR), ctx);
+		emit(ARM_LSL_R(rd, rd, rs), ctx);
+		break;
+	case BPF_RSH:
+		emit(ARM_RSB_I(ARM_IP, rs, 32), ctx);
+		emit(ARM_SUB_I(ARM_LR, rs, 32), ctx);
+		emit(ARM_LSR_R(rd, rd, rs), ctx);
+		emit(ARM_ORR_SR(rd, rd, rd + 1, SRTYPE_LSL, ARM_IP), ctx);
+		emit(ARM_ORR_SR(rd, rd, rd + 1, SRTYPE_LSR, ARM_LR), ctx);
+		emit(ARM_LSR_R(rd + 1, rd + 1, rs), ctx);
+		break;
+	case BPF_ARSH:
+		emit(ARM_RSB_I(ARM_IP, rs, 32), ctx);
+		emit(ARM_SUBS_I(ARM_LR, rs, 32), ctx);
+		emit(ARM_LSR_R(rd, rd, rs), ctx);
+		emit(ARM_ORR_SR(rd, rd, rd + 1, SRTYPE_LSL, ARM_IP), ctx);
+		_emit(ARM_COND_PL, ARM_ORR_SR(rd, rd, rd + 1, SRTYPE_ASR,
+					      ARM_LR), ctx);
+		emit(ARM_ASR_R(rd + 1, rd + 1, rs), ctx);
+		break;
+	}
+}
+
+/* 64-bit shifts by 1 to 63 */
+static void emit_shift64_i(u8 op, u8 rd, u32 k, struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_LSH:
+		if (k < 32) {
+			emit(ARM_LSL_I(rd + 1, rd + 1, k), ctx);
+			emit(ARM_ORR_S(rd + 1, rd + 1, rd, SRTYPE_LSR, 32 - k),
+			     ctx);
+			emit(ARM_LSL_I(rd, rd, k), ctx);
+		} else {
+			emit(ARM_LSL_I(rd + 1, rd, k - 32), ctx);
+			emit(ARM_MOV_I(rd, 0), ctx);
+		}
+		break;
+	case BPF_RSH:
+		if (k < 32) {
+			emit(ARM_LSR_I(rd, rd, k), ctx);
+			emit(ARM_ORR_S(rd, rd, rd + 1, SRTYPE_LSL, 32 - k), ctx);
+			emit(ARM_LSR_I(rd + 1, rd + 1, k), ctx);
+		} else {
+			if (k == 32)
+				emit(ARM_MOV_R(rd, rd + 1), ctx);
+			else
+				emit(ARM_LSR_I(rd, rd + 1, k - 32), ctx);
+			emit(ARM_MOV_I(rd + 1, 0), ctx);
+		}
+		break;
+	case BPF_ARSH:
+		if (k < 32) {
+			emit(ARM_LSR_I(rd, rd, k), ctx);
+			emit(ARM_ORR_S(rd, rd, rd + 1, SRTYPE_LSL, 32 - k), ctx);
+			emit(ARM_ASR_I(rd + 1, rd + 1, k), ctx);
+		} else {
+			if (k == 32)
+				emit(ARM_MOV_R(rd, rd + 1), ctx);
+			else
+				emit(ARM_ASR_I(rd, rd + 1, k - 32), ctx);
+			emit(ARM_ASR_I(rd + 1, rd + 1, 31), ctx);
+		}
+		break;
+	}
+}
+
+/* dst op= src on 64 bits */
+static int emit_alu64(u8 op, u8 rd, u8 rs, struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_ADD:
+		emit(ARM_ADDS_R(rd, rd, rs), ctx);
+		emit(ARM_ADC_R(rd + 1, rd + 1, rs + 1), ctx);
+		break;
+	case BPF_SUB:
+		emit(ARM_SUBS_R(rd, rd, rs), ctx);
+		emit(ARM_SBC_R(rd + 1, rd + 1, rs + 1), ctx);
+		break;
+	case BPF_AND:
+		emit(ARM_AND_R(rd, rd, rs), ctx);
+		emit(ARM_AND_R(rd + 1, rd + 1, rs + 1), ctx);
+		break;
+	case BPF_OR:
+		emit(ARM_ORR_R(rd, rd, rs), ctx);
+		emit(ARM_ORR_R(rd + 1, rd + 1, rs + 1), ctx);
+		break;
+	case BPF_XOR:
+		emit(ARM_EOR_R(rd, rd, rs), ctx);
+		emit(ARM_EOR_R(rd + 1, rd + 1, rs + 1), ctx);
+		break;
+	case BPF_MUL:
+		/* lo * lo, plus both cross products in the high word */
+		emit(ARM_MUL(ARM_IP, rd, rs + 1), ctx);
+		emit(ARM_MLA(ARM_IP, rd + 1, rs, ARM_IP), ctx);
+		emit(ARM_UMULL(rd, ARM_LR, rd, rs), ctx);
+		emit(ARM_ADD_R(rd + 1, ARM_LR, ARM_IP), ctx);
+		break;
+	case BPF_LSH:
+	case BPF_RSH:
+	case BPF_ARSH:
+		if (rs == rd || rs == rd + 1) {
+			emit(ARM_MOV_R(r_tmp2, rs), ctx);
+			rs = r_tmp2;
+		}
+		emit_shift64_r(op, rd, rs, ctx);
+		break;
+	case BPF_MOV:
+		emit_mov_r(rd, rs, ctx);
+		emit_mov_r(rd + 1, rs + 1, ctx);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/* dst = dst / src or dst % src, by a helper */
+static void emit_div(bool is64, u8 op, u8 rd, u8 rs, struct jit_ctx *ctx)
+{
+	void *func;
+
+	emit_mov_r(ARM_R0, rd, ctx);
+	if (is64) {
+		emit_mov_r(ARM_R1, rd + 1, ctx);
+		emit_mov_r(ARM_R2, rs, ctx);
+		func = op == BPF_DIV ? (void *)jit_udiv64 : (void *)jit_umod64;
+	} else {
+		emit_mov_r(ARM_R1, rs, ctx);
+		func = op == BPF_DIV ? (void *)jit_udiv32 : (void *)jit_umod32;
+	}
+	emit_call(func, ctx);
+
+	emit_mov_r(rd, ARM_R0, ctx);
+	if (is64)
+		emit_mov_r(rd + 1, ARM_R1, ctx);
+	else
+		emit(ARM_MOV_I(rd + 1, 0), ctx);
+}
+
+static int build_alu(const struct sock_filter_int *insn, struct jit_ctx *ctx)
+{
+	bool is64 = BPF_CLASS(insn->code) == BPF_ALU64;
+	u8 op = BPF_OP(insn->code);
+	u8 dst = insn->a_reg;
+	u8 rd, rs;
+	u32 k = insn->imm;
+
+	if (dst == FP_REG)
+		return -EINVAL;
+
+	if (op == BPF_END) {
+		if (is64)
+			return -EINVAL;
+		rd = get64(dst, r_tmp, ctx);
+		switch (k) {
+		case 16:
+			if (BPF_SRC(insn->code) == BPF_TO_BE) {
+				emit(ARM_REV(rd, rd), ctx);
+				emit(ARM_LSR_I(rd, rd, 16), ctx);
+			} else {
+				emit(ARM_LSL_I(rd, rd, 16), ctx);
+				emit(ARM_LSR_I(rd, rd, 16), ctx);
+			}
+			emit(ARM_MOV_I(rd + 1, 0), ctx);
+			break;
+		case 32:
+			if (BPF_SRC(insn->code) == BPF_TO_BE)
+				emit(ARM_REV(rd, rd), ctx);
+			emit(ARM_MOV_I(rd + 1, 0), ctx);
+			break;
+		case 64:
+			if (BPF_SRC(insn->code) == BPF_TO_BE) {
+				emit(ARM_REV(ARM_IP, rd), ctx);
+				emit(ARM_REV(rd, rd + 1), ctx);
+				emit(ARM_MOV_R(rd + 1, ARM_IP), ctx);
+			}
+			break;
+		}
+		put64(dst, rd, ctx);
+		return 0;
+	}
+
+	if (op == BPF_NEG) {
+		rd = get64(dst, r_tmp, ctx);
+		if (is64) {
+			emit(ARM_RSBS_I(rd, rd, 0), ctx);
+			emit(ARM_RSC_I(rd + 1, rd + 1, 0), ctx);
+		} else {
+			emit(ARM_RSB_I(rd, rd, 0), ctx);
+			emit(ARM_MOV_I(rd + 1, 0), ctx);
+		}
+		put64(dst, rd, ctx);
+		return 0;
+	}
+
+	/* nothing to load for a move */
+	if (op == BPF_MOV)
+		rd = dst64(dst, r_tmp);
+	else if (is64)
+		rd = get64(dst, r_tmp, ctx);
+	else
+		rd = get_lo(dst, r_tmp, ctx);
+
+	if (op == BPF_DIV || op == BPF_MOD) {
+		if (BPF_SRC(insn->code) == BPF_X) {
+			rs = get64(insn->x_reg, r_tmp2, ctx);
+			emit(ARM_ORR_R(ARM_IP, rs, rs + 1) | 1 << 20, ctx);
+			emit_b(ARM_COND_EQ, ctx->ret0_idx, ctx);
+		} else {
+			rs = r_tmp2;
+			emit_mov_i(rs, k, ctx);
+		}
+		emit_div(is64, op, rd, rs, ctx);
+		put64(dst, rd, ctx);
+		return 0;
+	}
+
+	if (!is64) {
+		if (BPF_SRC(insn->code) == BPF_X) {
+			rs = get_lo(insn->x_reg, r_tmp2, ctx);
+		} else if (!emit_alu32_i(op, rd, k, ctx)) {
+			rs = r_tmp2;
+			emit_mov_i(rs, k, ctx);
+		} else {
+			goto done32;
+		}
+		if (emit_alu32(op, rd, rs, ctx))
+			return -EINVAL;
+done32:
+		emit(ARM_MOV_I(rd + 1, 0), ctx);
+		put64(dst, rd, ctx);
+		return 0;
+	}
+
+	if (BPF_SRC(insn->code) == BPF_K) {
+		if (op == BPF_MOV) {
+			emit_mov_i(rd, k, ctx);
+			emit_mov_i(rd + 1, (s32)k < 0 ? ~0 : 0, ctx);
+			put64(dst, rd, ctx);
+			return 0;
+		}
+		if ((op == BPF_LSH || op == BPF_RSH || op == BPF_ARSH) &&
+		    k < 64) {
+			if (k)
+				emit_shift64_i(op, rd, k, ctx);
+			put64(dst, rd, ctx);
+			return 0;
+		}
+		/* K is sign extended */
+		rs = r_tmp2;
+		emit_mov_i(rs, k, ctx);
+		emit_mov_i(rs + 1, (s32)k < 0 ? ~0 : 0, ctx);
+	} else {
+		rs = get64(insn->x_reg, r_tmp2, ctx);
+	}
+	if (emit_alu64(op, rd, rs, ctx))
+		return -EINVAL;
+	put64(dst, rd, ctx);
+	return 0;
+}
+
+static int build_ldst(const struct sock_filter_int *insn, struct jit_ctx *ctx)
+{
+	u8 size = BPF_SIZE(insn->code);
+	s32 off = insn->off;
+	u8 base, rd, rs;
+	u32 ld, st;
+	bool half = size == BPF_H;
+
+	switch (size) {
+	case BPF_B:
+		ld = ARM_INST_LDRB_I;
+		st = ARM_INST_STRB_I;
+		break;
+	case BPF_H:
+		ld = ARM_INST_LDRH_I;
+		st = ARM_INST_STRH_I;
+		break;
+	default:
+		ld = ARM_INST_LDR_I;
+		st = ARM_INST_STR_I;
+		break;
+	}
+
+	if (BPF_CLASS(insn->code) == BPF_LDX) {
+		if (insn->a_reg == FP_REG || BPF_MODE(insn->code) != BPF_MEM)
+			return -EINVAL;
+		base = get_base(insn->x_reg, &off, ctx);
+		rd = dst64(insn->a_reg, r_tmp);
+		/* the high word first, base may be the low one */
+		if (size == BPF_DW)
+			emit_ldst(ld, false, rd + 1, base, off + 4, ctx);
+		emit_ldst(ld, half, rd, base, off, ctx);
+		if (size != BPF_DW)
+			emit(ARM_MOV_I(rd + 1, 0), ctx);
+		put64(insn->a_reg, rd, ctx);
+		return 0;
+	}
+
+	base = get_base(insn->a_reg, &off, ctx);
+
+	if (BPF_CLASS(insn->code) == BPF_ST) {
+		rs = r_tmp2;
+		emit_mov_i(rs, insn->imm, ctx);
+		if (size == BPF_DW)
+			emit_mov_i(rs + 1, insn->imm < 0 ? ~0 : 0, ctx);
+	} else if (size == BPF_DW) {
+		rs = get64(insn->x_reg, r_tmp2, ctx);
+	} else {
+		rs = get_lo(insn->x_reg, r_tmp2, ctx);
+	}
+
+	if (BPF_MODE(insn->code) == BPF_XADD) {
+		unsigned int loop;
+
+		if (BPF_CLASS(insn->code) != BPF_STX ||
+		    (size != BPF_W && size != BPF_DW))
+			return -EINVAL;
+
+		emit_add_i(ARM_IP, base, off, ctx);
+		loop = ctx->idx;
+		if (size == BPF_W) {
+			emit(ARM_LDREX(ARM_R0, ARM_IP), ctx);
+			emit(ARM_ADD_R(ARM_R0, ARM_R0, rs), ctx);
+			emit(ARM_STREX(ARM_R1, ARM_R0, ARM_IP), ctx);
+			emit(ARM_CMP_I(ARM_R1, 0), ctx);
+		} else {
+			emit(ARM_LDREXD(ARM_R0, ARM_IP), ctx);
+			emit(ARM_ADDS_R(ARM_R0, ARM_R0, rs), ctx);
+			emit(ARM_ADC_R(ARM_R1, ARM_R1, rs + 1), ctx);
+			emit(ARM_STREXD(ARM_LR, ARM_R0, ARM_IP), ctx);
+			emit(ARM_CMP_I(ARM_LR, 0), ctx);
+		}
+		emit_b(ARM_COND_NE, loop, ctx);
+		return 0;
+	}
+
+	if (BPF_MODE(insn->code) != BPF_MEM)
+		return -EINVAL;
+
+	emit_ldst(st, half, rs, base, off, ctx);
+	if (size == BPF_DW)
+		emit_ldst(st, false, rs + 1, base, off + 4, ctx);
+	return 0;
+}
+
+/*
+ * R0 = ntohl/ntohs/byte at the offset in the skb.  Data in the linear part
+ * is loaded inline, everything else through jit_skb_load().
+ */
+static int build_ld_skb(const struct sock_filter_int *insn,
+			struct jit_ctx *ctx)
+{
+	u8 size = BPF_SIZE(insn->code);
+	unsigned int len, slow, done;
+
+	switch (size) {
+	case BPF_B:
+		len = 1;
+		break;
+	case BPF_H:
+		len = 2;
+		break;
+	case BPF_W:
+		len = 4;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	/* r1 = offset */
+	if (BPF_MODE(insn->code) == BPF_IND)
+		emit_add_i(ARM_R1, get_lo(insn->x_reg, ARM_R1, ctx),
+			   insn->imm, ctx);
+	else
+		emit_mov_i(ARM_R1, insn->imm, ctx);
+
+	/* fast path if 0 <= offset <= skb_headlen(skb) - size */
+	BUILD_BUG_ON(FIELD_SIZEOF(struct sk_buff, len) != 4);
+	BUILD_BUG_ON(FIELD_SIZEOF(struct sk_buff, data_len) != 4);
+	emit(ARM_LDR_I(ARM_R2, r_skb, offsetof(struct sk_buff, len)), ctx);
+	emit(ARM_LDR_I(ARM_R3, r_skb, offsetof(struct sk_buff, data_len)),
+	     ctx);
+	emit(ARM_SUB_R(ARM_R2, ARM_R2, ARM_R3), ctx);
+	emit(ARM_SUB_I(ARM_R2, ARM_R2, len), ctx);
+	emit(ARM_CMP_I(ARM_R1, 0), ctx);
+	_emit(ARM_COND_GE, ARM_CMP_R(ARM_R2, ARM_R1), ctx);
+	slow = emit_b_fwd(ctx);
+
+	emit(ARM_LDR_I(ARM_R3, r_skb, offsetof(struct sk_buff, data)), ctx);
+	switch (size) {
+	case BPF_B:
+		emit(ARM_LDRB_R(ARM_R0, ARM_R3, ARM_R1), ctx);
+		break;
+	case BPF_H:
+		emit(ARM_LDRH_R(ARM_R0, ARM_R3, ARM_R1), ctx);
+#ifdef __LITTLE_ENDIAN
+		emit(ARM_REV16(ARM_R0, ARM_R0), ctx);
+#endif
+		break;
+	case BPF_W:
+		emit(ARM_LDR_R(ARM_R0, ARM_R3, ARM_R1), ctx);
+#ifdef __LITTLE_ENDIAN
+		emit(ARM_REV(ARM_R0, ARM_R0), ctx);
+#endif
+		break;
+	}
+	done = emit_b_fwd(ctx);
+
+	fixup_b(ARM_COND_LT, slow, ctx);
+	emit(ARM_MOV_R(ARM_R0, r_skb), ctx);
+	emit(ARM_MOV_I(ARM_R2, len), ctx);
+	emit_call(jit_skb_load, ctx);
+	emit(ARM_CMP_I(ARM_R1, 0), ctx);
+	emit_b(ARM_COND_NE, ctx->ret0_idx, ctx);
+
+	fixup_b(ARM_COND_AL, done, ctx);
+	emit(ARM_MOV_R(bpf2a32[0], ARM_R0), ctx);
+	emit(ARM_MOV_I(bpf2a32[0] + 1, 0), ctx);
+	return 0;
+}
+
+static int build_jmp(const struct sock_filter_int *insn, unsigned int i,
+		     struct jit_ctx *ctx)
+{
+	u8 op = BPF_OP(insn->code);
+	unsigned int tgt = i + 1 + insn->off;
+	u8 ra, rs;
+	int cond;
+
+	if (op == BPF_EXIT) {
+		if (i != ctx->len - 1)
+			emit_b(ARM_COND_AL, ctx->exit_idx, ctx);
+		return 0;
+	}
+
+	if (op == BPF_CALL) {
+		/* R1 and R2 in r0-r3, R3-R5 are already in place */
+		emit(ARM_LDR_I(ARM_R0, ARM_SP, bpf_stack_off[ARG1_REG]), ctx);
+		emit(ARM_LDR_I(ARM_R1, ARM_SP, bpf_stack_off[ARG1_REG] + 4),
+		     ctx);
+		emit(ARM_LDR_I(ARM_R2, ARM_SP, bpf_stack_off[2]), ctx);
+		emit(ARM_LDR_I(ARM_R3, ARM_SP, bpf_stack_off[2] + 4), ctx);
+		emit_call((void *)__bpf_call_base + insn->imm, ctx);
+		emit(ARM_MOV_R(bpf2a32[0], ARM_R0), ctx);
+		emit(ARM_MOV_R(bpf2a32[0] + 1, ARM_R1), ctx);
+		return 0;
+	}
+
+	if (tgt >= ctx->len)
+		return -EINVAL;
+
+	if (op == BPF_JA) {
+		emit_b(ARM_COND_AL, ctx->offsets[tgt], ctx);
+		return 0;
+	}
+
+	ra = get64(insn->a_reg, r_tmp, ctx);
+
+	/* the common compares with a small K, whose high word is 0 */
+	if (BPF_SRC(insn->code) == BPF_K && insn->imm >= 0 &&
+	    imm8m(insn->imm) >= 0 &&
+	    (op == BPF_JEQ || op == BPF_JNE || op == BPF_JSET)) {
+		if (op == BPF_JSET) {
+			emit(ARM_TST_I(ra, imm8m(insn->imm)), ctx);
+			cond = ARM_COND_NE;
+		} else {
+			emit(ARM_CMP_I(ra + 1, 0), ctx);
+			_emit(ARM_COND_EQ, ARM_CMP_I(ra, imm8m(insn->imm)),
+			      ctx);
+			cond = op == BPF_JEQ ? ARM_COND_EQ : ARM_COND_NE;
+		}
+		emit_b(cond, ctx->offsets[tgt], ctx);
+		return 0;
+	}
+
+	if (BPF_SRC(insn->code) == BPF_K) {
+		rs = r_tmp2;
+		emit_mov_i(rs, insn->imm, ctx);
+		emit_mov_i(rs + 1, insn->imm < 0 ? ~0 : 0, ctx);
+	} else {
+		rs = get64(insn->x_reg, r_tmp2, ctx);
+	}
+
+	switch (op) {
+	case BPF_JEQ:
+	case BPF_JNE:
+		emit(ARM_CMP_R(ra + 1, rs + 1), ctx);
+		_emit(ARM_COND_EQ, ARM_CMP_R(ra, rs), ctx);
+		cond = op == BPF_JEQ ? ARM_COND_EQ : ARM_COND_NE;
+		break;
+	case BPF_JSET:
+		emit(ARM_TST_R(ra, rs), ctx);
+		_emit(ARM_COND_EQ, ARM_TST_R(ra + 1, rs + 1), ctx);
+		cond = ARM_COND_NE;
+		break;
+	case BPF_JGT:
+	case BPF_JSGT:
+		/* a > s is s - a borrowing */
+		emit(ARM_CMP_R(rs, ra), ctx);
+		emit(ARM_SBCS_R(ARM_IP, rs + 1, ra + 1), ctx);
+		cond = op == BPF_JGT ? ARM_COND_LO : ARM_COND_LT;
+		break;
+	case BPF_JGE:
+	case BPF_JSGE:
+		emit(ARM_CMP_R(ra, rs), ctx);
+		emit(ARM_SBCS_R(ARM_IP, ra + 1, rs + 1), ctx);
+		cond = op == BPF_JGE ? ARM_COND_HS : ARM_COND_GE;
+		break;
+	default:
+		return -EINVAL;
+	}
+	emit_b(cond, ctx->offsets[tgt], ctx);
+	return 0;
+}
+
+static int build_body(struct jit_ctx *ctx)
+{
+	const struct sock_filter_int *insn;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < ctx->len; i++) {
+		insn = &ctx->insns[i];
+		ctx->offsets[i] = ctx->idx;
+
+		if (insn->a_reg >= MAX_BPF_REG || insn->x_reg >= MAX_BPF_REG)
+			return -EINVAL;
+
+		switch (BPF_CLASS(insn->code)) {
+		case BPF_ALU:
+		case BPF_ALU64:
+			ret = build_alu(insn, ctx);
+			break;
+		case BPF_LDX:
+		case BPF_ST:
+		case BPF_STX:
+			ret = build_ldst(insn, ctx);
+			break;
+		case BPF_LD:
+			if (BPF_MODE(insn->code) != BPF_ABS &&
+			    BPF_MODE(insn->code) != BPF_IND)
+				return -EINVAL;
+			ret = build_ld_skb(insn, ctx);
+			break;
+		case BPF_JMP:
+			ret = build_jmp(insn, i, ctx);
+			break;
+		default:
+			ret = -EINVAL;
+			break;
+		}
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ *	bpf_int_jit_compile - compile an internal BPF program
+ *	@insnsi: the program
+ *	@len: number of instructions
+ *
+ * Returns the image, called like sk_run_filter_int_skb(), or NULL to keep
+ * interpreting the program.  ARMv7 only, for movw/movt and ldrexd, and
+ * little endian only, as 64-bit loads and stores take the low word from
+ * the lower address.
+ */
+void *bpf_int_jit_compile(const struct sock_filter_int *insnsi,
+			  unsigned int len)
+{
+	struct jit_ctx ctx;
+	u32 *image = NULL;
+
+	if (!bpf_jit_enable || __LINUX_ARM_ARCH__ < 7 ||
+	    IS_ENABLED(CONFIG_CPU_BIG_ENDIAN))
+		return NULL;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.insns = insnsi;
+	ctx.len = len;
+
+	ctx.offsets = kcalloc(len, sizeof(*ctx.offsets), GFP_KERNEL);
+	if (ctx.offsets == NULL)
+		return NULL;
+
+	/* sizing pass, which also finds the branch targets */
+	build_prologue(&ctx);
+	if (build_body(&ctx))
+		goto out;
+	build_epilogue(&ctx);
+
+	ctx.target = module_alloc(4 * ctx.idx);
+	if (unlikely(ctx.target == NULL))
+		goto out;
+
+	ctx.idx = 0;
+	build_prologue(&ctx);
+	build_body(&ctx);
+	build_epilogue(&ctx);
+
+	flush_icache_range((u32)ctx.target, (u32)(ctx.target + ctx.idx));
+
+	if (bpf_jit_enable > 1)
+		bpf_jit_dump(len, 4 * ctx.idx, 2, ctx.target);
+
+	image = ctx.target;
+out:
+	kfree(ctx.offsets);
+	return image;
+}
+
+void bpf_int_jit_free(void *image)
+{
+	module_free(NULL, image);
+}
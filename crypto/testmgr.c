@@ -1794,6 +1794,14 @@ static const struct alg_test_desc alg_test_descs[] = {
 	}, {
 		.alg = "__driver-ecb-twofish-avx",
 		.test = alg_test_null,
+	}, {
+		.alg = "__driver-gcm-aes-neon",
+		.test = alg_test_null,
+		.fips_allowed = 1,
+	}, {
+		.alg = "__ghash-neon",
+		.test = alg_test_null,
+		.fips_allowed = 1,
 	}, {
 		.alg = "__ghash-pclmulqdqni",
 		.test = alg_test_null,
@@ -2130,6 +2138,14 @@ static const struct alg_test_desc alg_test_descs[] = {
 		.alg = "cryptd(__driver-gcm-aes-aesni)",
 		.test = alg_test_null,
 		.fips_allowed = 1,
+	}, {
+		.alg = "cryptd(__driver-gcm-aes-neon)",
+		.test = alg_test_null,
+		.fips_allowed = 1,
+	}, {
+		.alg = "cryptd(__ghash-neon)",
+		.test = alg_test_null,
+		.fips_allowed = 1,
 	}, {
 		.alg = "cryptd(__ghash-pclmulqdqni)",
 		.test = alg_test_null,
@@ -28,6 +28,9 @@
 #include <linux/suspend.h>
 #include <linux/syscore_ops.h>
 #include <linux/reboot.h>
+#include <linux/scatterlist.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include <generated/utsrelease.h>
 
@@ -1195,6 +1198,201 @@ int request_firmware_direct(const struct firmware **firmware_p,
 EXPORT_SYMBOL_GPL(request_firmware_direct);
 #endif
 
+/* Direct loading into caller-provided memory */
+
+/* kernel_read() size, so that huge images can still be interrupted */
+#define FW_READ_CHUNK	(1024 * 1024)
+
+static struct file *fw_open_file(const char *name)
+{
+	struct file *file = ERR_PTR(-ENOENT);
+	char *path;
+	int i;
+
+	path = __getname();
+	if (!path)
+		return ERR_PTR(-ENOMEM);
+
+	for (i = 0; i < ARRAY_SIZE(fw_path); i++) {
+		if (!fw_path[i][0])
+			continue;
+
+		snprintf(path, PATH_MAX, "%s/%s", fw_path[i], name);
+		file = filp_open(path, O_RDONLY, 0);
+		if (!IS_ERR(file))
+			break;
+	}
+	__putname(path);
+
+	return file;
+}
+
+static int fw_read_chunks(struct file *file, loff_t pos, char *dst, size_t len)
+{
+	size_t n;
+	int rc;
+
+	while (len) {
+		n = min_t(size_t, len, FW_READ_CHUNK);
+		rc = kernel_read(file, pos, dst, n);
+		if (rc != n)
+			return rc < 0 ? rc : -EIO;
+		pos += n;
+		dst += n;
+		len -= n;
+
+		if (fatal_signal_pending(current))
+			return -EINTR;
+		cond_resched();
+	}
+	return 0;
+}
+
+static int fw_read_into_sg(struct file *file, size_t size,
+			   struct scatterlist *sgl, unsigned int nents)
+{
+	struct sg_mapping_iter miter;
+	size_t done = 0, n;
+	int rc = 0;
+
+	sg_miter_start(&miter, sgl, nents, SG_MITER_TO_SG);
+	while (done < size && sg_miter_next(&miter)) {
+		n = min(miter.length, size - done);
+		rc = fw_read_chunks(file, done, miter.addr, n);
+		if (rc)
+			break;
+		miter.consumed = n;
+		done += n;
+	}
+	sg_miter_stop(&miter);
+
+	return rc;
+}
+
+/*
+ * Read firmware @name straight into either the scatterlist @sgl or the
+ * kernel mapping @buf, without a vmalloc'd copy of the whole image. Only
+ * the built-in images and the filesystem are tried, and nothing is cached.
+ */
+static ssize_t fw_load_into(const char *name, struct device *device,
+			    struct scatterlist *sgl, unsigned int nents,
+			    void *buf, size_t size)
+{
+	struct firmware builtin = { };
+	struct scatterlist *sg;
+	struct file *file;
+	ktime_t start;
+	s64 us;
+	int fsize, i, ret;
+
+	if (!name || name[0] == '\0')
+		return -EINVAL;
+
+	if (sgl) {
+		size = 0;
+		for_each_sg(sgl, sg, nents, i)
+			size += sg->length;
+	}
+
+	if (fw_get_builtin_firmware(&builtin, name)) {
+		if (builtin.size > size)
+			return -EFBIG;
+		if (sgl)
+			sg_copy_from_buffer(sgl, nents, (void *)builtin.data,
+					    builtin.size);
+		else
+			memcpy(buf, builtin.data, builtin.size);
+		return builtin.size;
+	}
+
+	ret = usermodehelper_read_trylock();
+	if (WARN_ON(ret)) {
+		dev_err(device, "firmware: %s will not be loaded\n", name);
+		return ret;
+	}
+
+	start = ktime_get();
+	file = fw_open_file(name);
+	if (IS_ERR(file)) {
+		ret = PTR_ERR(file);
+		goto out;
+	}
+
+	fsize = fw_file_size(file);
+	if (fsize <= 0)
+		ret = -EINVAL;
+	else if ((size_t)fsize > size)
+		ret = -EFBIG;
+	else if (sgl)
+		ret = fw_read_into_sg(file, fsize, sgl, nents);
+	else
+		ret = fw_read_chunks(file, 0, buf, fsize);
+	fput(file);
+	if (ret)
+		goto out;
+
+	us = ktime_us_delta(ktime_get(), start);
+	dev_info(device, "firmware: loaded %s, %d bytes in %lld us (%llu KiB/s)\n",
+		 name, fsize, us,
+		 div64_u64((u64)fsize * USEC_PER_SEC, (us ?: 1) * 1024));
+	ret = fsize;
+ out:
+	usermodehelper_read_unlock();
+	if (ret < 0)
+		dev_warn(device, "firmware: direct loading %s failed with error %d\n",
+			 name, ret);
+	return ret;
+}
+
+/**
+ * request_firmware_into_sg: - load firmware directly into a scatterlist
+ * @name: name of firmware file
+ * @device: device for which firmware is being loaded
+ * @sgl: scatterlist to load the image into
+ * @nents: number of entries in @sgl
+ *
+ * Unlike request_firmware(), the image is read from the filesystem page by
+ * page into the memory described by @sgl, so that no vmalloc'd copy of the
+ * whole image is needed. There is no user helper fallback and the image is
+ * not cached for resume. The caller still has to map the scatterlist for
+ * DMA, or sync it for the device, once this returns.
+ *
+ * Returns the size of the image, -EFBIG if it doesn't fit into @sgl, or
+ * another negative errno.
+ **/
+ssize_t request_firmware_into_sg(const char *name, struct device *device,
+				 struct scatterlist *sgl, unsigned int nents)
+{
+	ssize_t ret;
+
+	__module_get(THIS_MODULE);
+	ret = fw_load_into(name, device, sgl, nents, NULL, 0);
+	module_put(THIS_MODULE);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(request_firmware_into_sg);
+
+/**
+ * request_firmware_into_buf: - load firmware directly into a buffer
+ * @name: name of firmware file
+ * @device: device for which firmware is being loaded
+ * @buf: kernel mapping of the buffer, e.g. from dma_alloc_coherent()
+ * @size: size of @buf
+ *
+ * Works like request_firmware_into_sg() for a virtually contiguous buffer.
+ **/
+ssize_t request_firmware_into_buf(const char *name, struct device *device,
+				  void *buf, size_t size)
+{
+	ssize_t ret;
+
+	__module_get(THIS_MODULE);
+	ret = fw_load_into(name, device, NULL, 0, buf, size);
+	module_put(THIS_MODULE);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(request_firmware_into_buf);
+
 /**
  * release_firmware: - release the resource associated with a firmware image
  * @fw: firmware resource to release
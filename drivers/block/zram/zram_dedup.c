@@ -0,0 +1,164 @@
+/*
+ * Compressed RAM block device - duplicate page elimination
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+/*
+ * With deduplication enabled, every compressed object is described by a
+ * reference counted zram_entry, which any number of table slots may point
+ * to, and which is kept in an rbtree keyed by the CRC32 of the
+ * uncompressed page.  A page being written whose checksum is found there
+ * is compared with the stored copy, and if identical only takes another
+ * reference to it, saving both its compression and its zsmalloc space.
+ * Without deduplication, table slots hold the zsmalloc handle directly.
+ */
+
+#include <linux/kernel.h>
+#include <linux/crc32.h>
+#include <linux/mm.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zram_drv.h"
+
+struct zram_entry *zram_entry_alloc(struct zram *zram, unsigned long handle,
+				unsigned int len, gfp_t flags)
+{
+	struct zram_entry *entry;
+
+	entry = kmalloc(sizeof(*entry), flags);
+	if (!entry)
+		return NULL;
+
+	RB_CLEAR_NODE(&entry->rb_node);
+	entry->handle = handle;
+	entry->len = len;
+	entry->refcount = 1;
+	entry->checksum = 0;
+
+	return entry;
+}
+
+/*
+ * Drop a reference to @entry, freeing it and its compressed object when it
+ * was the last one.  Returns true if the entry was freed.
+ */
+bool zram_entry_put(struct zram *zram, struct zram_entry *entry)
+{
+	struct zram_meta *meta = zram->meta;
+
+	spin_lock(&meta->dedup_lock);
+	if (--entry->refcount) {
+		spin_unlock(&meta->dedup_lock);
+		return false;
+	}
+	if (!RB_EMPTY_NODE(&entry->rb_node))
+		rb_erase(&entry->rb_node, &meta->dedup_root);
+	spin_unlock(&meta->dedup_lock);
+
+	zs_free(meta->mem_pool, entry->handle);
+	kfree(entry);
+
+	return true;
+}
+
+u32 zram_dedup_checksum(unsigned char *mem)
+{
+	return crc32_le(~0, mem, PAGE_SIZE);
+}
+
+void zram_dedup_insert(struct zram *zram, struct zram_entry *new,
+				u32 checksum)
+{
+	struct zram_meta *meta = zram->meta;
+	struct rb_node **rb_node, *parent = NULL;
+	struct zram_entry *entry;
+
+	new->checksum = checksum;
+
+	spin_lock(&meta->dedup_lock);
+	rb_node = &meta->dedup_root.rb_node;
+	while (*rb_node) {
+		parent = *rb_node;
+		entry = rb_entry(parent, struct zram_entry, rb_node);
+		/* entries with colliding checksums go to the right */
+		if (checksum < entry->checksum)
+			rb_node = &parent->rb_left;
+		else
+			rb_node = &parent->rb_right;
+	}
+
+	rb_link_node(&new->rb_node, parent, rb_node);
+	rb_insert_color(&new->rb_node, &meta->dedup_root);
+	spin_unlock(&meta->dedup_lock);
+}
+
+/* @buf is a PAGE_SIZE scratch buffer to decompress the stored copy into */
+static bool zram_dedup_match(struct zram *zram, struct zram_entry *entry,
+				unsigned char *mem, unsigned char *buf)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned char *cmem;
+	bool match;
+
+	cmem = zs_map_object(meta->mem_pool, entry->handle, ZS_MM_RO);
+	if (entry->len == PAGE_SIZE)
+		match = !memcmp(mem, cmem, PAGE_SIZE);
+	else
+		match = !zcomp_decompress(zram->comp, cmem, entry->len, buf) &&
+			!memcmp(mem, buf, PAGE_SIZE);
+	zs_unmap_object(meta->mem_pool, entry->handle);
+
+	return match;
+}
+
+/*
+ * Look for a stored copy of the page at @mem, returning its entry with a
+ * reference taken, or NULL.  Only the first entry with a matching checksum
+ * is compared: a CRC32 collision between different live pages is rare
+ * enough that searching further is not worth it.
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram, unsigned char *mem,
+				u32 checksum, unsigned char *buf)
+{
+	struct zram_meta *meta = zram->meta;
+	struct rb_node *rb_node;
+	struct zram_entry *entry = NULL;
+
+	spin_lock(&meta->dedup_lock);
+	rb_node = meta->dedup_root.rb_node;
+	while (rb_node) {
+		entry = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (checksum == entry->checksum)
+			break;
+		if (checksum < entry->checksum)
+			rb_node = rb_node->rb_left;
+		else
+			rb_node = rb_node->rb_right;
+	}
+
+	if (!rb_node) {
+		spin_unlock(&meta->dedup_lock);
+		return NULL;
+	}
+
+	entry->refcount++;
+	spin_unlock(&meta->dedup_lock);
+
+	if (zram_dedup_match(zram, entry, mem, buf))
+		return entry;
+
+	zram_entry_put(zram, entry);
+	return NULL;
+}
+
+void zram_dedup_init(struct zram_meta *meta)
+{
+	meta->dedup_root = RB_ROOT;
+	spin_lock_init(&meta->dedup_lock);
+}
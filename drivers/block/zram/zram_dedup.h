@@ -0,0 +1,28 @@
+/*
+ * Compressed RAM block device - duplicate page elimination
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+struct zram;
+struct zram_meta;
+struct zram_entry;
+
+struct zram_entry *zram_entry_alloc(struct zram *zram, unsigned long handle,
+				unsigned int len, gfp_t flags);
+bool zram_entry_put(struct zram *zram, struct zram_entry *entry);
+
+u32 zram_dedup_checksum(unsigned char *mem);
+struct zram_entry *zram_dedup_find(struct zram *zram, unsigned char *mem,
+				u32 checksum, unsigned char *buf);
+void zram_dedup_insert(struct zram *zram, struct zram_entry *new,
+				u32 checksum);
+void zram_dedup_init(struct zram_meta *meta);
+
+#endif /* _ZRAM_DEDUP_H_ */
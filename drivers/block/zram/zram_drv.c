@@ -32,6 +32,7 @@
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 #include <linux/err.h>
+#include <linux/workqueue.h>
 
 #include "zram_drv.h"
 
@@ -179,23 +180,88 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
-/* flag operations needs meta->tb_lock */
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (kstrtoint(buf, 10, &val) || (val != 0 && val != 1))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+	return len;
+}
+
+/*
+ * flag operations needs meta->tb_lock, except that ZRAM_IDLE is also
+ * changed with only the read-side held, hence the atomic bitops.
+ */
 static int zram_test_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
 {
-	return meta->table[index].flags & BIT(flag);
+	return test_bit(flag, &meta->table[index].flags);
 }
 
 static void zram_set_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
 {
-	meta->table[index].flags |= BIT(flag);
+	set_bit(flag, &meta->table[index].flags);
 }
 
 static void zram_clear_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
 {
-	meta->table[index].flags &= ~BIT(flag);
+	clear_bit(flag, &meta->table[index].flags);
+}
+
+static size_t zram_get_obj_size(struct zram_meta *meta, u32 index)
+{
+	return meta->table[index].flags & (BIT(ZRAM_FLAG_SHIFT) - 1);
+}
+
+static void zram_set_obj_size(struct zram_meta *meta, u32 index, size_t size)
+{
+	unsigned long flags = meta->table[index].flags >> ZRAM_FLAG_SHIFT;
+
+	meta->table[index].flags = (flags << ZRAM_FLAG_SHIFT) | size;
+}
+
+/*
+ * Whether the page at @index has a compressed object, if it is neither
+ * ZRAM_SAME nor ZRAM_WB.  Both the entry and the handle are 0 when not.
+ */
+static bool zram_has_obj(struct zram_meta *meta, u32 index)
+{
+	return meta->table[index].handle != 0;
+}
+
+/* The handle of the compressed object at @index, see zram_has_obj() */
+static unsigned long zram_get_handle(struct zram *zram, u32 index)
+{
+	struct table *t = &zram->meta->table[index];
+
+	return zram->use_dedup ? t->entry->handle : t->handle;
 }
 
 static inline int is_partial_io(struct bio_vec *bvec)
@@ -256,6 +322,7 @@ static struct zram_meta *zram_meta_alloc(u64 disksize)
 	}
 
 	rwlock_init(&meta->tb_lock);
+	zram_dedup_init(meta);
 	return meta;
 
 free_table:
@@ -274,61 +341,338 @@ static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 	*offset = (*offset + bvec->bv_len) % PAGE_SIZE;
 }
 
-static int page_zero_filled(void *ptr)
+/*
+ * Check whether the page consists of a single repeated word, which is then
+ * stored in *element instead of the page.  Zero filled pages are the most
+ * common case, but pages of e.g. 0xff or a repeated pattern are not rare.
+ */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 0; pos < PAGE_SIZE / sizeof(*page) - 1; pos++) {
+		if (page[pos] != page[pos + 1])
 			return 0;
 	}
 
+	*element = page[pos];
+
 	return 1;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void zram_fill_page(void *ptr, unsigned long len,
+			unsigned long element)
+{
+	unsigned long *page = ptr;
+	unsigned long pos;
+
+	if (likely(element == 0)) {
+		memset(ptr, 0, len);
+		return;
+	}
+
+	for (pos = 0; pos < len / sizeof(*page); pos++)
+		page[pos] = element;
+}
+
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
-	if (is_partial_io(bvec))
-		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
-	else
-		clear_page(user_mem);
+	zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len, element);
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+#define ZRAM_BD_MODE	(FMODE_READ | FMODE_WRITE | FMODE_EXCL)
+
+/* Pages written back per bio, 128KiB with 4KiB pages */
+#define ZRAM_WB_BATCH	32
+
+static void zram_reset_bdev(struct zram *zram)
+{
+	if (!zram->bdev)
+		return;
+
+	blkdev_put(zram->bdev, ZRAM_BD_MODE);
+	vfree(zram->bd_bitmap);
+	kfree(zram->bd_name);
+	zram->bdev = NULL;
+	zram->bd_bitmap = NULL;
+	zram->bd_name = NULL;
+	zram->bd_pages = 0;
+}
+
+/*
+ * Allocate up to *count contiguous blocks on the backing device, returning
+ * the first one and setting *count to the number allocated, or 0 if the
+ * device is full.  Block 0 is never handed out, so 0 can mean failure.
+ */
+static unsigned long zram_bd_alloc(struct zram *zram, unsigned int *count)
+{
+	unsigned long blk = 0;
+	unsigned int n = *count;
+
+	spin_lock(&zram->bd_bitmap_lock);
+	for (; n; n /= 2) {
+		blk = bitmap_find_next_zero_area(zram->bd_bitmap,
+				zram->bd_pages, 1, n, 0);
+		if (blk < zram->bd_pages) {
+			bitmap_set(zram->bd_bitmap, blk, n);
+			break;
+		}
+	}
+	spin_unlock(&zram->bd_bitmap_lock);
+
+	*count = n;
+	return n ? blk : 0;
+}
+
+/*
+ * A block being read is pinned so that it can't be freed and reused for
+ * another page before the read completes.  Freeing a pinned block only
+ * marks the pin; the last reader of the block then frees it.
+ */
+struct zram_bd_pin {
+	struct list_head list;
+	unsigned long blk;
+	bool freed;
+};
+
+static struct zram_bd_pin *zram_bd_find_pin(struct zram *zram,
+			unsigned long blk)
+{
+	struct zram_bd_pin *pin;
+
+	list_for_each_entry(pin, &zram->bd_pins, list)
+		if (pin->blk == blk)
+			return pin;
+	return NULL;
+}
+
+/* NOTE: caller should hold meta->tb_lock, so that @blk is still in use */
+static void zram_bd_pin(struct zram *zram, struct zram_bd_pin *pin,
+			unsigned long blk)
+{
+	pin->blk = blk;
+	pin->freed = false;
+	spin_lock(&zram->bd_bitmap_lock);
+	list_add(&pin->list, &zram->bd_pins);
+	spin_unlock(&zram->bd_bitmap_lock);
+}
+
+static void zram_bd_unpin(struct zram *zram, struct zram_bd_pin *pin)
+{
+	struct zram_bd_pin *other;
+
+	spin_lock(&zram->bd_bitmap_lock);
+	list_del(&pin->list);
+	if (pin->freed) {
+		other = zram_bd_find_pin(zram, pin->blk);
+		if (other)
+			other->freed = true;
+		else
+			bitmap_clear(zram->bd_bitmap, pin->blk, 1);
+	}
+	spin_unlock(&zram->bd_bitmap_lock);
+}
+
+static void zram_bd_free(struct zram *zram, unsigned long blk,
+			unsigned int count)
+{
+	struct zram_bd_pin *pin;
+
+	spin_lock(&zram->bd_bitmap_lock);
+	if (list_empty(&zram->bd_pins)) {
+		bitmap_clear(zram->bd_bitmap, blk, count);
+	} else {
+		for (; count; count--, blk++) {
+			pin = zram_bd_find_pin(zram, blk);
+			if (pin)
+				pin->freed = true;
+			else
+				bitmap_clear(zram->bd_bitmap, blk, 1);
+		}
+	}
+	spin_unlock(&zram->bd_bitmap_lock);
+}
+
+/* Synchronously read or write @count pages at block @blk */
+static int zram_bd_rw(struct zram *zram, int rw, struct page **pages,
+			unsigned int count, unsigned long blk)
+{
+	struct bio *bio;
+	unsigned int i;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, count);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_bdev = zram->bdev;
+	bio->bi_iter.bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	for (i = 0; i < count; i++) {
+		if (!bio_add_page(bio, pages[i], PAGE_SIZE, 0)) {
+			bio_put(bio);
+			return -EIO;
+		}
+	}
+
+	ret = submit_bio_wait(rw, bio);
+	bio_put(bio);
+
+	return ret;
+}
+
+struct zram_bd_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct page *page;
+	unsigned long blk;
+	int ret;
+};
+
+static void zram_bd_read_work(struct work_struct *work)
+{
+	struct zram_bd_work *zw = container_of(work, struct zram_bd_work,
+						work);
+
+	zw->ret = zram_bd_rw(zw->zram, READ, &zw->page, 1, zw->blk);
+}
+
+/*
+ * Bios submitted from within zram_make_request() are only started once it
+ * returns (see generic_make_request()), so waiting on one there would
+ * never finish.  The read is issued and waited for from a worker instead.
+ */
+static int zram_bd_read(struct zram *zram, struct page *page,
+			unsigned long blk)
+{
+	struct zram_bd_work zw;
+
+	zw.zram = zram;
+	zw.page = page;
+	zw.blk = blk;
+	INIT_WORK_ONSTACK(&zw.work, zram_bd_read_work);
+	queue_work(system_unbound_wq, &zw.work);
+	flush_work(&zw.work);
+	destroy_work_on_stack(&zw.work);
+
+	atomic64_inc(&zram->stats.bd_reads);
+	return zw.ret;
+}
+#else
+struct zram_bd_pin {
+};
+
+static inline void zram_reset_bdev(struct zram *zram) {}
+
+static inline void zram_bd_pin(struct zram *zram, struct zram_bd_pin *pin,
+			unsigned long blk) {}
+
+static inline void zram_bd_unpin(struct zram *zram,
+			struct zram_bd_pin *pin) {}
+
+static inline void zram_bd_free(struct zram *zram, unsigned long blk,
+			unsigned int count) {}
+
+static inline int zram_bd_read(struct zram *zram, struct page *page,
+			unsigned long blk)
+{
+	return -EIO;
+}
+#endif
+
+/*
+ * Read the written back page at @index into @page, or return -EAGAIN if it
+ * is no longer on the backing device.
+ */
+static int zram_bd_read_index(struct zram *zram, struct page *page, u32 index)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zram_bd_pin pin;
+	unsigned long blk;
+	int ret;
+
+	read_lock(&meta->tb_lock);
+	if (!zram_test_flag(meta, index, ZRAM_WB)) {
+		read_unlock(&meta->tb_lock);
+		return -EAGAIN;
+	}
+	blk = meta->table[index].element;
+	zram_bd_pin(zram, &pin, blk);
+	read_unlock(&meta->tb_lock);
+
+	ret = zram_bd_read(zram, page, blk);
+	zram_bd_unpin(zram, &pin);
+	if (unlikely(ret)) {
+		pr_err("Backing device read failed! err=%d, page=%u\n",
+			ret, index);
+		atomic64_inc(&zram->stats.failed_reads);
+	}
+
+	return ret;
+}
+
 /* NOTE: caller should hold meta->tb_lock with write-side */
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	struct zram_meta *meta = zram->meta;
-	unsigned long handle = meta->table[index].handle;
+	size_t len;
+
+	/* an ongoing writeback of this page will notice and drop it */
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+	zram_clear_flag(meta, index, ZRAM_HUGE);
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		zram_bd_free(zram, meta->table[index].element, 1);
+		meta->table[index].element = 0;
+		atomic64_dec(&zram->stats.bd_count);
+		atomic64_dec(&zram->stats.pages_stored);
+		return;
+	}
 
-	if (unlikely(!handle)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(meta, index, ZRAM_ZERO)) {
-			zram_clear_flag(meta, index, ZRAM_ZERO);
+	/*
+	 * No memory is allocated for same element filled pages.
+	 * Simply clear same page flag.
+	 */
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		if (!meta->table[index].element)
 			atomic64_dec(&zram->stats.zero_pages);
-		}
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = 0;
+		atomic64_dec(&zram->stats.same_pages);
 		return;
 	}
 
-	zs_free(meta->mem_pool, handle);
+	if (unlikely(!zram_has_obj(meta, index)))
+		return;
 
-	atomic64_sub(meta->table[index].size, &zram->stats.compr_data_size);
+	len = zram_get_obj_size(meta, index);
+	if (!zram->use_dedup) {
+		zs_free(meta->mem_pool, meta->table[index].handle);
+		atomic64_sub(len, &zram->stats.compr_data_size);
+		meta->table[index].handle = 0;
+	} else {
+		if (zram_entry_put(zram, meta->table[index].entry)) {
+			atomic64_sub(len, &zram->stats.compr_data_size);
+		} else {
+			atomic64_dec(&zram->stats.dup_pages);
+			atomic64_sub(len, &zram->stats.dup_data_size);
+		}
+		meta->table[index].entry = NULL;
+	}
+	zram_set_obj_size(meta, index, 0);
 	atomic64_dec(&zram->stats.pages_stored);
-
-	meta->table[index].handle = 0;
-	meta->table[index].size = 0;
 }
 
 static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
@@ -337,18 +681,28 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	unsigned char *cmem;
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle;
-	u16 size;
+	size_t size;
 
 	read_lock(&meta->tb_lock);
-	handle = meta->table[index].handle;
-	size = meta->table[index].size;
 
-	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
+	/* the caller has to read it with zram_bd_read_index() */
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		read_unlock(&meta->tb_lock);
+		return -EAGAIN;
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_SAME) ||
+			!zram_has_obj(meta, index)) {
+		unsigned long element = zram_test_flag(meta, index, ZRAM_SAME) ?
+					meta->table[index].element : 0;
+
 		read_unlock(&meta->tb_lock);
-		clear_page(mem);
+		zram_fill_page(mem, PAGE_SIZE, element);
 		return 0;
 	}
 
+	handle = zram_get_handle(zram, index);
+	size = zram_get_obj_size(meta, index);
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
 	if (size == PAGE_SIZE)
 		copy_page(mem, cmem);
@@ -367,54 +721,89 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+/* Like zram_decompress_page(), but may sleep to read written back pages */
+static int zram_read_page(struct zram *zram, char *mem, u32 index)
+{
+	struct page *page = NULL;
+	int ret;
+
+	while ((ret = zram_decompress_page(zram, mem, index)) == -EAGAIN) {
+		if (!page) {
+			page = alloc_page(GFP_NOIO);
+			if (!page)
+				return -ENOMEM;
+		}
+
+		ret = zram_bd_read_index(zram, page, index);
+		if (ret != -EAGAIN) {
+			if (!ret)
+				copy_page(mem, page_address(page));
+			break;
+		}
+	}
+
+	if (page)
+		__free_page(page);
+	return ret;
+}
+
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
 	int ret;
 	struct page *page;
-	unsigned char *user_mem, *uncmem = NULL;
+	unsigned char *user_mem, *uncmem;
 	struct zram_meta *meta = zram->meta;
 	page = bvec->bv_page;
 
 	read_lock(&meta->tb_lock);
-	if (unlikely(!meta->table[index].handle) ||
-			zram_test_flag(meta, index, ZRAM_ZERO)) {
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	if (zram_test_flag(meta, index, ZRAM_SAME) ||
+			(!zram_test_flag(meta, index, ZRAM_WB) &&
+			 unlikely(!zram_has_obj(meta, index)))) {
+		unsigned long element = zram_test_flag(meta, index, ZRAM_SAME) ?
+					meta->table[index].element : 0;
+
 		read_unlock(&meta->tb_lock);
-		handle_zero_page(bvec);
+		handle_same_page(bvec, element);
 		return 0;
 	}
 	read_unlock(&meta->tb_lock);
 
-	if (is_partial_io(bvec))
+	if (is_partial_io(bvec)) {
 		/* Use  a temporary buffer to decompress the page */
 		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
+		if (!uncmem) {
+			pr_info("Unable to allocate temp memory\n");
+			return -ENOMEM;
+		}
 
-	user_mem = kmap_atomic(page);
-	if (!is_partial_io(bvec))
-		uncmem = user_mem;
-
-	if (!uncmem) {
-		pr_info("Unable to allocate temp memory\n");
-		ret = -ENOMEM;
-		goto out_cleanup;
+		ret = zram_read_page(zram, uncmem, index);
+		if (!ret) {
+			user_mem = kmap_atomic(page);
+			memcpy(user_mem + bvec->bv_offset, uncmem + offset,
+					bvec->bv_len);
+			kunmap_atomic(user_mem);
+		}
+		kfree(uncmem);
+	} else {
+		do {
+			user_mem = kmap_atomic(page);
+			ret = zram_decompress_page(zram, user_mem, index);
+			kunmap_atomic(user_mem);
+
+			/* written back pages are read straight into the page */
+			if (ret == -EAGAIN)
+				ret = zram_bd_read_index(zram, page, index);
+		} while (ret == -EAGAIN);
 	}
 
-	ret = zram_decompress_page(zram, uncmem, index);
 	/* Should NEVER happen. Return bio error if it does. */
 	if (unlikely(ret))
-		goto out_cleanup;
-
-	if (is_partial_io(bvec))
-		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
-				bvec->bv_len);
+		return ret;
 
 	flush_dcache_page(page);
-	ret = 0;
-out_cleanup:
-	kunmap_atomic(user_mem);
-	if (is_partial_io(bvec))
-		kfree(uncmem);
-	return ret;
+	return 0;
 }
 
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
@@ -422,12 +811,14 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 {
 	int ret = 0;
 	size_t clen;
-	unsigned long handle;
+	unsigned long handle = 0, element;
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
+	struct zram_entry *entry = NULL;
 	struct zcomp_strm *zstrm;
-	bool locked = false;
+	bool locked = false, dup = false;
+	u32 checksum = 0;
 
 	page = bvec->bv_page;
 	if (is_partial_io(bvec)) {
@@ -440,7 +831,7 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			ret = -ENOMEM;
 			goto out;
 		}
-		ret = zram_decompress_page(zram, uncmem, index);
+		ret = zram_read_page(zram, uncmem, index);
 		if (ret)
 			goto out;
 	}
@@ -458,19 +849,36 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
-		kunmap_atomic(user_mem);
+	if (page_same_filled(uncmem, &element)) {
+		if (user_mem)
+			kunmap_atomic(user_mem);
 		/* Free memory associated with this sector now. */
 		write_lock(&zram->meta->tb_lock);
 		zram_free_page(zram, index);
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		zram_set_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = element;
 		write_unlock(&zram->meta->tb_lock);
 
-		atomic64_inc(&zram->stats.zero_pages);
+		atomic64_inc(&zram->stats.same_pages);
+		if (!element)
+			atomic64_inc(&zram->stats.zero_pages);
 		ret = 0;
 		goto out;
 	}
 
+	if (zram->use_dedup) {
+		/* the stream buffer is free until the page is compressed */
+		checksum = zram_dedup_checksum(uncmem);
+		entry = zram_dedup_find(zram, uncmem, checksum, zstrm->buffer);
+		if (entry) {
+			if (user_mem)
+				kunmap_atomic(user_mem);
+			clen = entry->len;
+			dup = true;
+			goto found;
+		}
+	}
+
 	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
 	if (!is_partial_io(bvec)) {
 		kunmap_atomic(user_mem);
@@ -496,6 +904,16 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		ret = -ENOMEM;
 		goto out;
 	}
+
+	if (zram->use_dedup) {
+		entry = zram_entry_alloc(zram, handle, clen, GFP_NOIO);
+		if (!entry) {
+			zs_free(meta->mem_pool, handle);
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_WO);
 
 	if ((clen == PAGE_SIZE) && !is_partial_io(bvec)) {
@@ -510,6 +928,10 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	locked = false;
 	zs_unmap_object(meta->mem_pool, handle);
 
+	if (zram->use_dedup)
+		zram_dedup_insert(zram, entry, checksum);
+
+found:
 	/*
 	 * Free memory associated with this sector
 	 * before overwriting unused sectors.
@@ -517,12 +939,22 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	write_lock(&zram->meta->tb_lock);
 	zram_free_page(zram, index);
 
-	meta->table[index].handle = handle;
-	meta->table[index].size = clen;
+	if (zram->use_dedup)
+		meta->table[index].entry = entry;
+	else
+		meta->table[index].handle = handle;
+	zram_set_obj_size(meta, index, clen);
+	if (clen == PAGE_SIZE)
+		zram_set_flag(meta, index, ZRAM_HUGE);
 	write_unlock(&zram->meta->tb_lock);
 
 	/* Update stats */
-	atomic64_add(clen, &zram->stats.compr_data_size);
+	if (dup) {
+		atomic64_inc(&zram->stats.dup_pages);
+		atomic64_add(clen, &zram->stats.dup_data_size);
+	} else {
+		atomic64_add(clen, &zram->stats.compr_data_size);
+	}
 	atomic64_inc(&zram->stats.pages_stored);
 out:
 	if (locked)
@@ -534,6 +966,239 @@ out:
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE, "%s\n",
+			zram->bd_name ? zram->bd_name : "none");
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct block_device *bdev;
+	unsigned long *bitmap, pages;
+	char *name;
+	int err;
+
+	name = kstrndup(buf, len, GFP_KERNEL);
+	if (!name)
+		return -ENOMEM;
+	strim(name);
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	bdev = blkdev_get_by_path(name, ZRAM_BD_MODE, zram);
+	if (IS_ERR(bdev)) {
+		err = PTR_ERR(bdev);
+		goto out;
+	}
+
+	pages = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(pages) * sizeof(long));
+	if (!bitmap) {
+		blkdev_put(bdev, ZRAM_BD_MODE);
+		err = -ENOMEM;
+		goto out;
+	}
+
+	zram_reset_bdev(zram);
+	zram->bdev = bdev;
+	zram->bd_name = name;
+	zram->bd_pages = pages;
+	zram->bd_bitmap = bitmap;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s, %lu pages\n", name, pages);
+	return len;
+
+out:
+	up_write(&zram->init_lock);
+	kfree(name);
+	return err;
+}
+
+/* Writing "all" marks every stored page idle, until it is next accessed */
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	size_t index, nr_pages;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		read_lock(&meta->tb_lock);
+		if (!zram_test_flag(meta, index, ZRAM_SAME) &&
+				!zram_test_flag(meta, index, ZRAM_WB) &&
+				zram_has_obj(meta, index))
+			zram_set_flag(meta, index, ZRAM_IDLE);
+		read_unlock(&meta->tb_lock);
+	}
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+/*
+ * Write the @count pages collected for writeback with as few bios as the
+ * free space on the backing device allows, then switch the slots that
+ * weren't changed meanwhile over to their block.
+ */
+static int zram_wb_flush(struct zram *zram, struct page **pages, u32 *index,
+			unsigned long *handles, unsigned int count)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long blk;
+	unsigned int i, n, done;
+	int ret = 0;
+
+	for (i = 0; i < count; i += n) {
+		n = count - i;
+		blk = ret ? 0 : zram_bd_alloc(zram, &n);
+		if (!ret && !blk)
+			ret = -ENOSPC;
+
+		if (blk) {
+			ret = zram_bd_rw(zram, WRITE, pages + i, n, blk);
+			if (ret) {
+				zram_bd_free(zram, blk, n);
+				blk = 0;
+			} else {
+				atomic64_add(n, &zram->stats.bd_writes);
+				atomic64_inc(&zram->stats.bd_batches);
+			}
+		}
+
+		for (done = 0; done < n; done++) {
+			u32 idx = index[i + done];
+
+			write_lock(&meta->tb_lock);
+			if (!blk || !zram_test_flag(meta, idx, ZRAM_UNDER_WB) ||
+				zram_get_handle(zram, idx) != handles[i + done]) {
+				zram_clear_flag(meta, idx, ZRAM_UNDER_WB);
+				write_unlock(&meta->tb_lock);
+				if (blk)
+					zram_bd_free(zram, blk + done, 1);
+				continue;
+			}
+
+			zram_free_page(zram, idx);
+			zram_set_flag(meta, idx, ZRAM_WB);
+			meta->table[idx].element = blk + done;
+			write_unlock(&meta->tb_lock);
+
+			atomic64_inc(&zram->stats.pages_stored);
+			atomic64_inc(&zram->stats.bd_count);
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Writing "huge" writes back the pages that are stored uncompressed, "idle"
+ * those marked idle (see idle_store()).  Pages are collected ZRAM_WB_BATCH
+ * at a time and written to contiguous blocks, so the backing device sees
+ * large sequential writes.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	struct page *pages[ZRAM_WB_BATCH] = { NULL };
+	unsigned long handles[ZRAM_WB_BATCH];
+	u32 index[ZRAM_WB_BATCH];
+	enum zram_pageflags mode;
+	unsigned int i, count = 0;
+	size_t n, nr_pages;
+	int ret = 0;
+
+	if (sysfs_streq(buf, "huge"))
+		mode = ZRAM_HUGE;
+	else if (sysfs_streq(buf, "idle"))
+		mode = ZRAM_IDLE;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram->bdev) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (n = 0; n < nr_pages && !ret; n++) {
+		write_lock(&meta->tb_lock);
+		if (!zram_test_flag(meta, n, mode) ||
+				zram_test_flag(meta, n, ZRAM_UNDER_WB)) {
+			write_unlock(&meta->tb_lock);
+			continue;
+		}
+		zram_set_flag(meta, n, ZRAM_UNDER_WB);
+		handles[count] = zram_get_handle(zram, n);
+		write_unlock(&meta->tb_lock);
+
+		if (zram_decompress_page(zram, page_address(pages[count]), n)) {
+			write_lock(&meta->tb_lock);
+			zram_clear_flag(meta, n, ZRAM_UNDER_WB);
+			write_unlock(&meta->tb_lock);
+			continue;
+		}
+
+		index[count++] = n;
+		if (count == ZRAM_WB_BATCH) {
+			ret = zram_wb_flush(zram, pages, index, handles, count);
+			count = 0;
+		}
+	}
+
+	if (count)
+		ret = zram_wb_flush(zram, pages, index, handles, count);
+out:
+	up_read(&zram->init_lock);
+	for (i = 0; i < ZRAM_WB_BATCH; i++)
+		if (pages[i])
+			__free_page(pages[i]);
+
+	return ret ? ret : len;
+}
+#endif
+
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, struct bio *bio)
 {
@@ -599,6 +1264,7 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 
 	down_write(&zram->init_lock);
 	if (!init_done(zram)) {
+		zram_reset_bdev(zram);
 		up_write(&zram->init_lock);
 		return;
 	}
@@ -606,13 +1272,20 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 	meta = zram->meta;
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
-		unsigned long handle = meta->table[index].handle;
-		if (!handle)
+		if (zram_test_flag(meta, index, ZRAM_SAME) ||
+				zram_test_flag(meta, index, ZRAM_WB) ||
+				!zram_has_obj(meta, index))
 			continue;
 
-		zs_free(meta->mem_pool, handle);
+		if (zram->use_dedup)
+			zram_entry_put(zram, meta->table[index].entry);
+		else
+			zs_free(meta->mem_pool, meta->table[index].handle);
 	}
 
+	/* pages on the backing device go with its bitmap */
+	zram_reset_bdev(zram);
+
 	zcomp_destroy(zram->comp);
 	zram->max_comp_streams = 1;
 
@@ -825,6 +1498,14 @@ static DEVICE_ATTR(max_comp_streams, S_IRUGO | S_IWUSR,
 		max_comp_streams_show, max_comp_streams_store);
 static DEVICE_ATTR(comp_algorithm, S_IRUGO | S_IWUSR,
 		comp_algorithm_show, comp_algorithm_store);
+static DEVICE_ATTR(use_dedup, S_IRUGO | S_IWUSR,
+		use_dedup_show, use_dedup_store);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR(backing_dev, S_IRUGO | S_IWUSR,
+		backing_dev_show, backing_dev_store);
+static DEVICE_ATTR(idle, S_IWUSR, NULL, idle_store);
+static DEVICE_ATTR(writeback, S_IWUSR, NULL, writeback_store);
+#endif
 
 ZRAM_ATTR_RO(num_reads);
 ZRAM_ATTR_RO(num_writes);
@@ -833,7 +1514,16 @@ ZRAM_ATTR_RO(failed_writes);
 ZRAM_ATTR_RO(invalid_io);
 ZRAM_ATTR_RO(notify_free);
 ZRAM_ATTR_RO(zero_pages);
+ZRAM_ATTR_RO(same_pages);
+ZRAM_ATTR_RO(dup_pages);
+ZRAM_ATTR_RO(dup_data_size);
 ZRAM_ATTR_RO(compr_data_size);
+#ifdef CONFIG_ZRAM_WRITEBACK
+ZRAM_ATTR_RO(bd_count);
+ZRAM_ATTR_RO(bd_reads);
+ZRAM_ATTR_RO(bd_writes);
+ZRAM_ATTR_RO(bd_batches);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -846,11 +1536,24 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_invalid_io.attr,
 	&dev_attr_notify_free.attr,
 	&dev_attr_zero_pages.attr,
+	&dev_attr_same_pages.attr,
+	&dev_attr_dup_pages.attr,
+	&dev_attr_dup_data_size.attr,
 	&dev_attr_orig_data_size.attr,
 	&dev_attr_compr_data_size.attr,
 	&dev_attr_mem_used_total.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_use_dedup.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_count.attr,
+	&dev_attr_bd_reads.attr,
+	&dev_attr_bd_writes.attr,
+	&dev_attr_bd_batches.attr,
+#endif
 	NULL,
 };
 
@@ -929,6 +1632,10 @@ static int create_device(struct zram *zram, int device_id)
 	strlcpy(zram->compressor, default_compressor, sizeof(zram->compressor));
 	zram->meta = NULL;
 	zram->max_comp_streams = 1;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	spin_lock_init(&zram->bd_bitmap_lock);
+	INIT_LIST_HEAD(&zram->bd_pins);
+#endif
 	return 0;
 
 out_free_disk:
@@ -15,10 +15,12 @@
 #ifndef _ZRAM_DRV_H_
 #define _ZRAM_DRV_H_
 
+#include <linux/rbtree.h>
 #include <linux/spinlock.h>
 #include <linux/zsmalloc.h>
 
 #include "zcomp.h"
+#include "zram_dedup.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -51,22 +53,48 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 #define ZRAM_SECTOR_PER_LOGICAL_BLOCK	\
 	(1 << (ZRAM_LOGICAL_BLOCK_SHIFT - SECTOR_SHIFT))
 
+/*
+ * The lower ZRAM_FLAG_SHIFT bits of table.flags hold the object size,
+ * the upper bits the zram_pageflags.
+ */
+#define ZRAM_FLAG_SHIFT		24
+
 /* Flags for zram pages (table[page_no].flags) */
 enum zram_pageflags {
-	/* Page consists entirely of zeros */
-	ZRAM_ZERO,
+	/* Page consists of one repeated word, kept in table[].element */
+	ZRAM_SAME = ZRAM_FLAG_SHIFT,
+	/* Page is on the backing device, table[].element is its block */
+	ZRAM_WB,
+	/* Page is being written to the backing device */
+	ZRAM_UNDER_WB,
+	/* Page is stored uncompressed */
+	ZRAM_HUGE,
+	/* Page hasn't been accessed since it was marked idle */
+	ZRAM_IDLE,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
 
 /*-- Data structures */
 
+/* With use_dedup, allocated for each compressed object and shared */
+struct zram_entry {
+	struct rb_node rb_node;
+	u32 checksum;	/* of the uncompressed page, if in the dedup tree */
+	u32 len;	/* object size (excluding header) */
+	unsigned long refcount;	/* protected by meta->dedup_lock */
+	unsigned long handle;
+};
+
 /* Allocated for each disk page */
 struct table {
-	unsigned long handle;
-	u16 size;	/* object size (excluding header) */
-	u8 flags;
-} __aligned(4);
+	union {
+		struct zram_entry *entry;	/* with use_dedup */
+		unsigned long handle;		/* without */
+		unsigned long element;	/* ZRAM_SAME fill word or ZRAM_WB block */
+	};
+	unsigned long flags;
+};
 
 struct zram_stats {
 	atomic64_t compr_data_size;	/* compressed size of pages stored */
@@ -77,13 +105,22 @@ struct zram_stats {
 	atomic64_t invalid_io;	/* non-page-aligned I/O requests */
 	atomic64_t notify_free;	/* no. of swap slot free notifications */
 	atomic64_t zero_pages;		/* no. of zero filled pages */
+	atomic64_t same_pages;	/* no. of pages filled with one word */
 	atomic64_t pages_stored;	/* no. of pages currently stored */
+	atomic64_t dup_pages;	/* no. of pages sharing a stored copy */
+	atomic64_t dup_data_size;	/* compressed size not stored by dedup */
+	atomic64_t bd_count;	/* no. of pages on the backing device */
+	atomic64_t bd_reads;	/* no. of pages read from the backing device */
+	atomic64_t bd_writes;	/* no. of pages written back */
+	atomic64_t bd_batches;	/* no. of writeback I/Os */
 };
 
 struct zram_meta {
 	rwlock_t tb_lock;	/* protect table */
 	struct table *table;
 	struct zs_pool *mem_pool;
+	spinlock_t dedup_lock;	/* protect dedup_root and entry refcounts */
+	struct rb_root dedup_root;
 };
 
 struct zram {
@@ -100,7 +137,16 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	int max_comp_streams;
+	bool use_dedup;
 	struct zram_stats stats;
 	char compressor[10];
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct block_device *bdev;
+	char *bd_name;
+	unsigned long bd_pages;
+	unsigned long *bd_bitmap;
+	spinlock_t bd_bitmap_lock;
+	struct list_head bd_pins;	/* blocks being read, see zram_bd_pin() */
+#endif
 };
 #endif
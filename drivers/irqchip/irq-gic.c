@@ -21,6 +21,13 @@
  * Note that IRQs 0-31 are special - they are local to each CPU.
  * As such, the enable set/clear, pending set/clear and active bit
  * registers are banked per-cpu for these sources.
+ *
+ * All interrupts get the same priority by default. Interrupts can be
+ * given a higher priority (a lower value) from the device tree with the
+ * "arm,irq-priorities" property of the GIC node, a list of <hwirq
+ * priority> pairs, or with gic_set_irq_priority(). As handlers run with
+ * interrupts masked, this decides which of several pending interrupts
+ * is taken next, not whether a running handler is preempted.
  */
 #include <linux/init.h>
 #include <linux/kernel.h>
@@ -41,6 +48,11 @@
 #include <linux/slab.h>
 #include <linux/irqchip/chained_irq.h>
 #include <linux/irqchip/arm-gic.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sched_clock.h>
+#include <linux/math64.h>
+#include <linux/u64_stats_sync.h>
 
 #include <asm/irq.h>
 #include <asm/exception.h>
@@ -60,6 +72,7 @@ struct gic_chip_data {
 	u32 saved_spi_enable[DIV_ROUND_UP(1020, 32)];
 	u32 saved_spi_conf[DIV_ROUND_UP(1020, 16)];
 	u32 saved_spi_target[DIV_ROUND_UP(1020, 4)];
+	u32 saved_spi_pri[DIV_ROUND_UP(1020, 4)];
 	u32 __percpu *saved_ppi_enable;
 	u32 __percpu *saved_ppi_conf;
 #endif
@@ -80,6 +93,15 @@ static DEFINE_RAW_SPINLOCK(irq_controller_lock);
 #define NR_GIC_CPU_IF 8
 static u8 gic_cpu_map[NR_GIC_CPU_IF] __read_mostly;
 
+/*
+ * Priorities of the banked SGIs and PPIs of GIC 0, programmed into each
+ * CPU interface as it comes up. Values from GIC_PRI_MASK on are masked
+ * by the CPU interface, so never signalled.
+ */
+#define GIC_PRI_DEFAULT		0xa0
+#define GIC_PRI_MASK		0xf0
+static u8 gic_ppi_pri[32] = { [0 ... 31] = GIC_PRI_DEFAULT };
+
 /*
  * Supported arch specific GIC irq extension.
  * Default make them NULL.
@@ -294,19 +316,95 @@ static int gic_set_wake(struct irq_data *d, unsigned int on)
 #define gic_set_wake	NULL
 #endif
 
+#ifdef CONFIG_ARM_GIC_IRQ_STATS
+/*
+ * Per interrupt timing of GIC 0, in log2 buckets of microseconds: "wait"
+ * is the time from the exception entry until the interrupt is
+ * acknowledged, i.e. spent handling interrupts taken before it in the
+ * same exception, "run" the time from acknowledge to the end of its
+ * handler. The time the CPU ran with interrupts masked before the
+ * exception is not seen by the GIC. Each CPU accounts the interrupts it
+ * takes in its own copy, which are summed up when read.
+ */
+#define GIC_STATS_BUCKETS	16
+
+struct gic_irq_stats {
+	u32 count;
+	u32 wait_max_ns;
+	u32 run_max_ns;
+	u64 run_ns;
+	u32 wait[GIC_STATS_BUCKETS];
+	u32 run[GIC_STATS_BUCKETS];
+};
+
+struct gic_cpu_stats {
+	struct u64_stats_sync syncp;
+	struct gic_irq_stats irq[0];
+};
+
+/* kmalloc'ed rather than alloc_percpu, 1020 irqs exceed a percpu unit */
+static DEFINE_PER_CPU(struct gic_cpu_stats *, gic_cpu_stats);
+
+static inline u64 gic_stats_clock(void)
+{
+	return __this_cpu_read(gic_cpu_stats) ? sched_clock() : 0;
+}
+
+static inline void gic_stats_bucket(u32 *hist, u32 ns)
+{
+	hist[min(fls(ns / NSEC_PER_USEC), GIC_STATS_BUCKETS - 1)]++;
+}
+
+static void gic_stats_account(u32 hwirq, u64 entry, u64 ack)
+{
+	struct gic_cpu_stats *stats = __this_cpu_read(gic_cpu_stats);
+	struct gic_irq_stats *st;
+	u32 wait, run;
+
+	if (!stats || !entry)
+		return;
+
+	st = &stats->irq[hwirq];
+	wait = min_t(u64, ack - entry, U32_MAX);
+	run = min_t(u64, sched_clock() - ack, U32_MAX);
+
+	u64_stats_update_begin(&stats->syncp);
+	st->count++;
+	st->run_ns += run;
+	st->wait_max_ns = max(st->wait_max_ns, wait);
+	st->run_max_ns = max(st->run_max_ns, run);
+	gic_stats_bucket(st->wait, wait);
+	gic_stats_bucket(st->run, run);
+	u64_stats_update_end(&stats->syncp);
+}
+#else
+static inline u64 gic_stats_clock(void)
+{
+	return 0;
+}
+
+static inline void gic_stats_account(u32 hwirq, u64 entry, u64 ack)
+{
+}
+#endif
+
 static void __exception_irq_entry gic_handle_irq(struct pt_regs *regs)
 {
-	u32 irqstat, irqnr;
+	u32 irqstat, irqnr, hwirq;
 	struct gic_chip_data *gic = &gic_data[0];
 	void __iomem *cpu_base = gic_data_cpu_base(gic);
+	u64 entry = gic_stats_clock(), ack;
 
 	do {
 		irqstat = readl_relaxed(cpu_base + GIC_CPU_INTACK);
 		irqnr = irqstat & ~0x1c00;
 
 		if (likely(irqnr > 15 && irqnr < 1021)) {
+			ack = gic_stats_clock();
+			hwirq = irqnr;
 			irqnr = irq_find_mapping(gic->domain, irqnr);
 			handle_IRQ(irqnr, regs);
+			gic_stats_account(hwirq, entry, ack);
 			continue;
 		}
 		if (irqnr < 16) {
@@ -360,6 +458,43 @@ static struct irq_chip gic_chip = {
 	.irq_set_wake		= gic_set_wake,
 };
 
+/**
+ * gic_set_irq_priority - set the priority of a shared peripheral interrupt
+ * @irq: Linux interrupt number
+ * @priority: GIC priority, lower values are higher priorities
+ *
+ * Of several pending interrupts, the one with the highest priority is
+ * acknowledged first. The GIC ignores the low order bits it does not
+ * implement. Priorities of banked interrupts (SGIs and PPIs) can only be
+ * set from the device tree.
+ *
+ * Returns 0 on success, -EINVAL if @irq is not a GIC SPI or @priority
+ * would be masked.
+ */
+int gic_set_irq_priority(unsigned int irq, u8 priority)
+{
+	struct irq_data *d = irq_get_irq_data(irq);
+	unsigned long flags;
+
+	if (!d || irq_data_get_irq_chip(d) != &gic_chip || gic_irq(d) < 32 ||
+	    priority >= GIC_PRI_MASK)
+		return -EINVAL;
+
+	raw_spin_lock_irqsave(&irq_controller_lock, flags);
+	writeb_relaxed(priority, gic_dist_base(d) + GIC_DIST_PRI + gic_irq(d));
+	raw_spin_unlock_irqrestore(&irq_controller_lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(gic_set_irq_priority);
+
+/* priority register value for banked interrupts @i to @i + 3 */
+static u32 gic_ppi_pri_word(int i)
+{
+	return gic_ppi_pri[i] | gic_ppi_pri[i + 1] << 8 |
+	       gic_ppi_pri[i + 2] << 16 | gic_ppi_pri[i + 3] << 24;
+}
+
 void __init gic_cascade_irq(unsigned int gic_nr, unsigned int irq)
 {
 	if (gic_nr >= MAX_GIC_NR)
@@ -416,7 +551,8 @@ static void __init gic_dist_init(struct gic_chip_data *gic)
 	 * Set priority on all global interrupts.
 	 */
 	for (i = 32; i < gic_irqs; i += 4)
-		writel_relaxed(0xa0a0a0a0, base + GIC_DIST_PRI + i * 4 / 4);
+		writel_relaxed(GIC_PRI_DEFAULT * 0x01010101,
+			       base + GIC_DIST_PRI + i * 4 / 4);
 
 	/*
 	 * Disable all interrupts.  Leave the PPI and SGIs alone
@@ -461,9 +597,10 @@ static void gic_cpu_init(struct gic_chip_data *gic)
 	 * Set priority on PPI and SGI interrupts
 	 */
 	for (i = 0; i < 32; i += 4)
-		writel_relaxed(0xa0a0a0a0, dist_base + GIC_DIST_PRI + i * 4 / 4);
+		writel_relaxed(gic_ppi_pri_word(i),
+			       dist_base + GIC_DIST_PRI + i * 4 / 4);
 
-	writel_relaxed(0xf0, base + GIC_CPU_PRIMASK);
+	writel_relaxed(GIC_PRI_MASK, base + GIC_CPU_PRIMASK);
 	writel_relaxed(1, base + GIC_CPU_CTRL);
 }
 
@@ -503,6 +640,10 @@ static void gic_dist_save(unsigned int gic_nr)
 		gic_data[gic_nr].saved_spi_target[i] =
 			readl_relaxed(dist_base + GIC_DIST_TARGET + i * 4);
 
+	for (i = 0; i < DIV_ROUND_UP(gic_irqs, 4); i++)
+		gic_data[gic_nr].saved_spi_pri[i] =
+			readl_relaxed(dist_base + GIC_DIST_PRI + i * 4);
+
 	for (i = 0; i < DIV_ROUND_UP(gic_irqs, 32); i++)
 		gic_data[gic_nr].saved_spi_enable[i] =
 			readl_relaxed(dist_base + GIC_DIST_ENABLE_SET + i * 4);
@@ -537,7 +678,7 @@ static void gic_dist_restore(unsigned int gic_nr)
 			dist_base + GIC_DIST_CONFIG + i * 4);
 
 	for (i = 0; i < DIV_ROUND_UP(gic_irqs, 4); i++)
-		writel_relaxed(0xa0a0a0a0,
+		writel_relaxed(gic_data[gic_nr].saved_spi_pri[i],
 			dist_base + GIC_DIST_PRI + i * 4);
 
 	for (i = 0; i < DIV_ROUND_UP(gic_irqs, 4); i++)
@@ -602,9 +743,10 @@ static void gic_cpu_restore(unsigned int gic_nr)
 		writel_relaxed(ptr[i], dist_base + GIC_DIST_CONFIG + i * 4);
 
 	for (i = 0; i < DIV_ROUND_UP(32, 4); i++)
-		writel_relaxed(0xa0a0a0a0, dist_base + GIC_DIST_PRI + i * 4);
+		writel_relaxed(gic_ppi_pri_word(i * 4),
+			       dist_base + GIC_DIST_PRI + i * 4);
 
-	writel_relaxed(0xf0, cpu_base + GIC_CPU_PRIMASK);
+	writel_relaxed(GIC_PRI_MASK, cpu_base + GIC_CPU_PRIMASK);
 	writel_relaxed(1, cpu_base + GIC_CPU_CTRL);
 }
 
@@ -1050,7 +1192,182 @@ void __init gic_init_bases(unsigned int gic_nr, int irq_start,
 	gic_pm_init(gic);
 }
 
+#ifdef CONFIG_ARM_GIC_IRQ_STATS
+/* sum up the copies of all CPUs */
+static void gic_stats_read(unsigned int hwirq, struct gic_irq_stats *sum)
+{
+	struct gic_cpu_stats *stats;
+	struct gic_irq_stats st;
+	unsigned int start;
+	int cpu, i;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		stats = per_cpu(gic_cpu_stats, cpu);
+		if (!stats)
+			continue;
+		do {
+			start = u64_stats_fetch_begin_irq(&stats->syncp);
+			st = stats->irq[hwirq];
+		} while (u64_stats_fetch_retry_irq(&stats->syncp, start));
+
+		sum->count += st.count;
+		sum->run_ns += st.run_ns;
+		sum->wait_max_ns = max(sum->wait_max_ns, st.wait_max_ns);
+		sum->run_max_ns = max(sum->run_max_ns, st.run_max_ns);
+		for (i = 0; i < GIC_STATS_BUCKETS; i++) {
+			sum->wait[i] += st.wait[i];
+			sum->run[i] += st.run[i];
+		}
+	}
+}
+
+static int gic_stats_show(struct seq_file *s, void *v)
+{
+	struct gic_chip_data *gic = &gic_data[0];
+	void __iomem *base = gic_data_dist_base(gic);
+	struct gic_irq_stats sum, *st = &sum;
+	unsigned int hwirq;
+	int i;
+
+	seq_puts(s, "# bucket i counts events of less than 2^i us\n");
+	seq_puts(s, "# hwirq irq pri count run_avg_us run_max_us wait_max_us | run buckets | wait buckets\n");
+	for (hwirq = 16; hwirq < gic->gic_irqs; hwirq++) {
+		gic_stats_read(hwirq, st);
+		if (!st->count)
+			continue;
+
+		seq_printf(s, "%u %u %u %u %llu %u %u |", hwirq,
+			   irq_find_mapping(gic->domain, hwirq),
+			   readb_relaxed(base + GIC_DIST_PRI + hwirq),
+			   st->count,
+			   div_u64(div_u64(st->run_ns, st->count),
+				   NSEC_PER_USEC),
+			   st->run_max_ns / NSEC_PER_USEC,
+			   st->wait_max_ns / NSEC_PER_USEC);
+		for (i = 0; i < GIC_STATS_BUCKETS; i++)
+			seq_printf(s, " %u", st->run[i]);
+		seq_puts(s, " |");
+		for (i = 0; i < GIC_STATS_BUCKETS; i++)
+			seq_printf(s, " %u", st->wait[i]);
+		seq_putc(s, '\n');
+	}
+
+	return 0;
+}
+
+static int gic_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, gic_stats_show, NULL);
+}
+
+static void gic_stats_reset_cpu(void *info)
+{
+	struct gic_cpu_stats *stats = __this_cpu_read(gic_cpu_stats);
+
+	if (!stats)
+		return;
+
+	u64_stats_update_begin(&stats->syncp);
+	memset(stats->irq, 0, gic_data[0].gic_irqs * sizeof(stats->irq[0]));
+	u64_stats_update_end(&stats->syncp);
+}
+
+/*
+ * Any write resets the statistics. Each online CPU clears its own copy
+ * with interrupts off, so that it can't race with its updates.
+ */
+static ssize_t gic_stats_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	get_online_cpus();
+	on_each_cpu(gic_stats_reset_cpu, NULL, 1);
+	for_each_possible_cpu(cpu)
+		if (!cpu_online(cpu) && per_cpu(gic_cpu_stats, cpu))
+			memset(per_cpu(gic_cpu_stats, cpu)->irq, 0,
+			       gic_data[0].gic_irqs *
+			       sizeof(struct gic_irq_stats));
+	put_online_cpus();
+
+	return count;
+}
+
+static const struct file_operations gic_stats_fops = {
+	.open		= gic_stats_open,
+	.read		= seq_read,
+	.write		= gic_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init gic_stats_init(void)
+{
+	struct gic_cpu_stats *stats[NR_CPUS] = { NULL };
+	size_t size;
+	int cpu;
+
+	if (!gic_data[0].gic_irqs)
+		return 0;
+
+	size = sizeof(struct gic_cpu_stats) +
+	       gic_data[0].gic_irqs * sizeof(struct gic_irq_stats);
+	for_each_possible_cpu(cpu) {
+		stats[cpu] = kzalloc_node(size, GFP_KERNEL, cpu_to_node(cpu));
+		if (!stats[cpu])
+			goto err;
+		u64_stats_init(&stats[cpu]->syncp);
+	}
+
+	if (!debugfs_create_file("gic_irq_stats", S_IRUSR | S_IWUSR, NULL,
+				 NULL, &gic_stats_fops))
+		goto err;
+
+	for_each_possible_cpu(cpu)
+		per_cpu(gic_cpu_stats, cpu) = stats[cpu];
+
+	return 0;
+
+err:
+	for_each_possible_cpu(cpu)
+		kfree(stats[cpu]);
+	return -ENOMEM;
+}
+late_initcall(gic_stats_init);
+#endif
+
 #ifdef CONFIG_OF
+/*
+ * Apply "arm,irq-priorities": SPIs are set in the distributor, SGIs and
+ * PPIs in the table the CPU interfaces are set up from. The boot CPU
+ * interface is already up, so its banked registers are updated here.
+ */
+static void __init gic_of_set_priorities(struct gic_chip_data *gic,
+					 struct device_node *node)
+{
+	void __iomem *base = gic_data_dist_base(gic);
+	u32 hwirq, pri;
+	int i, n;
+
+	n = of_property_count_u32_elems(node, "arm,irq-priorities");
+	for (i = 0; i + 1 < n; i += 2) {
+		of_property_read_u32_index(node, "arm,irq-priorities", i,
+					   &hwirq);
+		of_property_read_u32_index(node, "arm,irq-priorities", i + 1,
+					   &pri);
+		if (hwirq >= gic->gic_irqs || pri >= GIC_PRI_MASK ||
+		    (hwirq < 32 && gic != &gic_data[0])) {
+			pr_warn("GIC: bad priority %u for IRQ %u\n",
+				pri, hwirq);
+			continue;
+		}
+		if (hwirq < 32)
+			gic_ppi_pri[hwirq] = pri;
+		writeb_relaxed(pri, base + GIC_DIST_PRI + hwirq);
+	}
+}
+
 static int gic_cnt __initdata;
 
 static int __init
@@ -1074,6 +1391,7 @@ gic_of_init(struct device_node *node, struct device_node *parent)
 		percpu_offset = 0;
 
 	gic_init_bases(gic_cnt, -1, dist_base, cpu_base, percpu_offset, node);
+	gic_of_set_priorities(&gic_data[gic_cnt], node);
 	if (!gic_cnt)
 		gic_init_physaddr(node);
 
@@ -12,10 +12,12 @@
 #include <linux/slab.h>
 #include <linux/module.h>
 #include <linux/blkdev.h>
+#include <linux/blk-mq.h>
 #include <linux/freezer.h>
 #include <linux/kthread.h>
 #include <linux/scatterlist.h>
 #include <linux/dma-mapping.h>
+#include <linux/math64.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -23,6 +25,17 @@
 
 #define MMC_QUEUE_BOUNCESZ	65536
 
+/*
+ * blk-mq tags bound the requests handed to mmcqd ahead of the two it
+ * pipelines; the rest wait in the software queues where they can still be
+ * merged.
+ */
+#define MMC_QUEUE_DEPTH		8
+
+static bool use_blk_mq = IS_ENABLED(CONFIG_MMC_BLOCK_MQ);
+module_param(use_blk_mq, bool, 0444);
+MODULE_PARM_DESC(use_blk_mq, "Use blk-mq request queues for new cards");
+
 /*
  * Prepare a MMC request. This just filters out odd stuff.
  */
@@ -46,10 +59,41 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 	return BLKPREP_OK;
 }
 
+/*
+ * Take the next request for mmcqd, from the elevator or, with blk-mq, from
+ * the requests ->queue_rq() has handed over.
+ */
+static struct request *mmc_queue_fetch(struct mmc_queue *mq)
+{
+	struct request_queue *q = mq->queue;
+	struct request *req;
+
+	if (mq->use_mq) {
+		spin_lock_irq(&mq->mq_lock);
+		set_current_state(TASK_INTERRUPTIBLE);
+		req = list_first_entry_or_null(&mq->mq_list, struct request,
+					       queuelist);
+		if (req)
+			list_del_init(&req->queuelist);
+		mq->mqrq_cur->req = req;
+		spin_unlock_irq(&mq->mq_lock);
+	} else {
+		spin_lock_irq(q->queue_lock);
+		set_current_state(TASK_INTERRUPTIBLE);
+		req = blk_fetch_request(q);
+		mq->mqrq_cur->req = req;
+		spin_unlock_irq(q->queue_lock);
+	}
+
+	if (req)
+		mq->mqrq_cur->start = ktime_get();
+
+	return req;
+}
+
 static int mmc_queue_thread(void *d)
 {
 	struct mmc_queue *mq = d;
-	struct request_queue *q = mq->queue;
 
 	current->flags |= PF_MEMALLOC;
 
@@ -59,11 +103,7 @@ static int mmc_queue_thread(void *d)
 		struct mmc_queue_req *tmp;
 		unsigned int cmd_flags = 0;
 
-		spin_lock_irq(q->queue_lock);
-		set_current_state(TASK_INTERRUPTIBLE);
-		req = blk_fetch_request(q);
-		mq->mqrq_cur->req = req;
-		spin_unlock_irq(q->queue_lock);
+		req = mmc_queue_fetch(mq);
 
 		if (req || mq->mqrq_prev->req) {
 			set_current_state(TASK_RUNNING);
@@ -105,27 +145,14 @@ static int mmc_queue_thread(void *d)
 }
 
 /*
- * Generic MMC request handler.  This is called for any queue on a
- * particular host.  When the host is not busy, we look for a request
- * on any queue on this host, and attempt to issue it.  This may
- * not be the queue we were asked to process.
+ * Tell mmcqd a new request is available. Called with the lock that
+ * mmc_queue_fetch() takes held.
  */
-static void mmc_request_fn(struct request_queue *q)
+static void mmc_queue_kick(struct mmc_queue *mq)
 {
-	struct mmc_queue *mq = q->queuedata;
-	struct request *req;
+	struct mmc_context_info *cntx = &mq->card->host->context_info;
 	unsigned long flags;
-	struct mmc_context_info *cntx;
-
-	if (!mq) {
-		while ((req = blk_fetch_request(q)) != NULL) {
-			req->cmd_flags |= REQ_QUIET;
-			__blk_end_request_all(req, -EIO);
-		}
-		return;
-	}
 
-	cntx = &mq->card->host->context_info;
 	if (!mq->mqrq_cur->req && mq->mqrq_prev->req) {
 		/*
 		 * New MMC request arrived when MMC thread may be
@@ -142,6 +169,78 @@ static void mmc_request_fn(struct request_queue *q)
 		wake_up_process(mq->thread);
 }
 
+/*
+ * Generic MMC request handler.  This is called for any queue on a
+ * particular host.  When the host is not busy, we look for a request
+ * on any queue on this host, and attempt to issue it.  This may
+ * not be the queue we were asked to process.
+ */
+static void mmc_request_fn(struct request_queue *q)
+{
+	struct mmc_queue *mq = q->queuedata;
+	struct request *req;
+
+	if (!mq) {
+		while ((req = blk_fetch_request(q)) != NULL) {
+			req->cmd_flags |= REQ_QUIET;
+			__blk_end_request_all(req, -EIO);
+		}
+		return;
+	}
+
+	mmc_queue_kick(mq);
+}
+
+/*
+ * blk-mq counterpart of mmc_request_fn(). Issuing a request sleeps, so it
+ * is queued for mmcqd, which keeps preparing the next request while the
+ * previous one is on the bus, just as it does for the legacy queue.
+ */
+static int mmc_queue_rq(struct blk_mq_hw_ctx *hctx, struct request *req)
+{
+	struct mmc_queue *mq = hctx->driver_data;
+	unsigned long flags;
+
+	if (mmc_prep_request(hctx->queue, req) != BLKPREP_OK)
+		return BLK_MQ_RQ_QUEUE_ERROR;
+
+	spin_lock_irqsave(&mq->mq_lock, flags);
+	if (!hctx->queue->queuedata) {
+		spin_unlock_irqrestore(&mq->mq_lock, flags);
+		req->cmd_flags |= REQ_QUIET;
+		return BLK_MQ_RQ_QUEUE_ERROR;
+	}
+	list_add_tail(&req->queuelist, &mq->mq_list);
+	mmc_queue_kick(mq);
+	spin_unlock_irqrestore(&mq->mq_lock, flags);
+
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static int mmc_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
+			 unsigned int index)
+{
+	hctx->driver_data = data;
+	return 0;
+}
+
+static struct blk_mq_ops mmc_mq_ops = {
+	.queue_rq	= mmc_queue_rq,
+	.map_queue	= blk_mq_map_queue,
+	.alloc_hctx	= blk_mq_alloc_single_hw_queue,
+	.free_hctx	= blk_mq_free_single_hw_queue,
+	.init_hctx	= mmc_init_hctx,
+};
+
+/* one hardware queue: a card executes one command at a time */
+static struct blk_mq_reg mmc_mq_reg = {
+	.ops		= &mmc_mq_ops,
+	.nr_hw_queues	= 1,
+	.queue_depth	= MMC_QUEUE_DEPTH,
+	.numa_node	= NUMA_NO_NODE,
+	.flags		= BLK_MQ_F_SHOULD_MERGE,
+};
+
 static struct scatterlist *mmc_alloc_sg(int sg_len, int *err)
 {
 	struct scatterlist *sg;
@@ -200,15 +299,28 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 		limit = (u64)dma_max_pfn(mmc_dev(host)) << PAGE_SHIFT;
 
 	mq->card = card;
-	mq->queue = blk_init_queue(mmc_request_fn, lock);
-	if (!mq->queue)
-		return -ENOMEM;
+	mq->use_mq = use_blk_mq;
+	spin_lock_init(&mq->lat_lock);
+	mmc_queue_lat_reset(mq);
+
+	if (mq->use_mq) {
+		spin_lock_init(&mq->mq_lock);
+		INIT_LIST_HEAD(&mq->mq_list);
+		mq->queue = blk_mq_init_queue(&mmc_mq_reg, mq);
+		if (IS_ERR(mq->queue))
+			return PTR_ERR(mq->queue);
+	} else {
+		mq->queue = blk_init_queue(mmc_request_fn, lock);
+		if (!mq->queue)
+			return -ENOMEM;
+	}
 
 	mq->mqrq_cur = mqrq_cur;
 	mq->mqrq_prev = mqrq_prev;
 	mq->queue->queuedata = mq;
 
-	blk_queue_prep_rq(mq->queue, mmc_prep_request);
+	if (!mq->use_mq)
+		blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
 	if (mmc_can_erase(card))
 		mmc_queue_setup_discard(mq->queue, card);
@@ -329,14 +441,37 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	/* Make sure the queue isn't suspended, as that will deadlock */
 	mmc_queue_resume(mq);
 
-	/* Then terminate our worker thread */
-	kthread_stop(mq->thread);
+	if (mq->use_mq) {
+		struct request *req, *tmp;
+		LIST_HEAD(list);
+
+		/* Fail new requests; mmcqd drains the ones it was given */
+		spin_lock_irqsave(&mq->mq_lock, flags);
+		q->queuedata = NULL;
+		spin_unlock_irqrestore(&mq->mq_lock, flags);
+
+		kthread_stop(mq->thread);
+
+		spin_lock_irqsave(&mq->mq_lock, flags);
+		list_splice_init(&mq->mq_list, &list);
+		spin_unlock_irqrestore(&mq->mq_lock, flags);
+
+		list_for_each_entry_safe(req, tmp, &list, queuelist) {
+			list_del_init(&req->queuelist);
+			req->cmd_flags |= REQ_QUIET;
+			blk_mq_end_io(req, -EIO);
+		}
+		blk_mq_start_stopped_hw_queues(q);
+	} else {
+		/* Then terminate our worker thread */
+		kthread_stop(mq->thread);
 
-	/* Empty the queue */
-	spin_lock_irqsave(q->queue_lock, flags);
-	q->queuedata = NULL;
-	blk_start_queue(q);
-	spin_unlock_irqrestore(q->queue_lock, flags);
+		/* Empty the queue */
+		spin_lock_irqsave(q->queue_lock, flags);
+		q->queuedata = NULL;
+		blk_start_queue(q);
+		spin_unlock_irqrestore(q->queue_lock, flags);
+	}
 
 	kfree(mqrq_cur->bounce_sg);
 	mqrq_cur->bounce_sg = NULL;
@@ -419,9 +554,13 @@ void mmc_queue_suspend(struct mmc_queue *mq)
 	if (!(mq->flags & MMC_QUEUE_SUSPENDED)) {
 		mq->flags |= MMC_QUEUE_SUSPENDED;
 
-		spin_lock_irqsave(q->queue_lock, flags);
-		blk_stop_queue(q);
-		spin_unlock_irqrestore(q->queue_lock, flags);
+		if (mq->use_mq) {
+			blk_mq_stop_hw_queues(q);
+		} else {
+			spin_lock_irqsave(q->queue_lock, flags);
+			blk_stop_queue(q);
+			spin_unlock_irqrestore(q->queue_lock, flags);
+		}
 
 		down(&mq->thread_sem);
 	}
@@ -441,9 +580,13 @@ void mmc_queue_resume(struct mmc_queue *mq)
 
 		up(&mq->thread_sem);
 
-		spin_lock_irqsave(q->queue_lock, flags);
-		blk_start_queue(q);
-		spin_unlock_irqrestore(q->queue_lock, flags);
+		if (mq->use_mq) {
+			blk_mq_start_stopped_hw_queues(q);
+		} else {
+			spin_lock_irqsave(q->queue_lock, flags);
+			blk_start_queue(q);
+			spin_unlock_irqrestore(q->queue_lock, flags);
+		}
 	}
 }
 
@@ -553,3 +696,147 @@ void mmc_queue_bounce_post(struct mmc_queue_req *mqrq)
 	sg_copy_from_buffer(mqrq->bounce_sg, mqrq->bounce_sg_len,
 		mqrq->bounce_buf, mqrq->sg[0].length);
 }
+
+static unsigned int mmc_lat_bucket(u32 us)
+{
+	unsigned int msb;
+
+	if (us < 4)
+		return us;
+
+	msb = fls(us) - 1;
+	return min_t(unsigned int, (msb - 1) * 4 + ((us >> (msb - 2)) & 3),
+		     MMC_LAT_BUCKETS - 1);
+}
+
+/* largest latency in microseconds that falls into bucket @i */
+static u32 mmc_lat_bucket_max(unsigned int i)
+{
+	unsigned int msb;
+
+	if (i < 4)
+		return i;
+
+	msb = i / 4 + 1;
+	return ((4 + i % 4 + 1) << (msb - 2)) - 1;
+}
+
+/**
+ * mmc_queue_end_request - complete (part of) a request
+ * @mq: MMC queue the request was issued on
+ * @mqrq: queue slot that carried the request
+ * @req: the request
+ * @error: 0 or a negative errno
+ * @nr_bytes: number of bytes to complete
+ *
+ * Works like blk_end_request() for both the legacy and the blk-mq queue.
+ * Data requests are accounted in the latency histogram of their direction
+ * once fully completed, from the time mmcqd took them.
+ *
+ * Return: %true if bytes remain in the request, %false once it is done.
+ */
+bool mmc_queue_end_request(struct mmc_queue *mq, struct mmc_queue_req *mqrq,
+			   struct request *req, int error,
+			   unsigned int nr_bytes)
+{
+	unsigned int cmd_flags = req->cmd_flags;
+	struct mmc_queue_lat *lat = &mq->lat[rq_data_dir(req)];
+	unsigned long flags;
+	bool pending;
+	u32 us;
+
+	if (mq->use_mq)
+		pending = blk_mq_end_io_partial(req, error, nr_bytes);
+	else
+		pending = blk_end_request(req, error, nr_bytes);
+
+	if (cmd_flags & MMC_REQ_SPECIAL_MASK)
+		return pending;
+
+	us = pending ? 0 : ktime_us_delta(ktime_get(), mqrq->start);
+
+	spin_lock_irqsave(&mq->lat_lock, flags);
+	if (!error)
+		lat->bytes += nr_bytes;
+	if (!pending) {
+		lat->ios++;
+		lat->sum_us += us;
+		lat->min_us = min(lat->min_us, us);
+		lat->max_us = max(lat->max_us, us);
+		lat->hist[mmc_lat_bucket(us)]++;
+	}
+	spin_unlock_irqrestore(&mq->lat_lock, flags);
+
+	return pending;
+}
+
+void mmc_queue_lat_reset(struct mmc_queue *mq)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&mq->lat_lock, flags);
+	memset(mq->lat, 0, sizeof(mq->lat));
+	mq->lat[READ].min_us = mq->lat[WRITE].min_us = U32_MAX;
+	spin_unlock_irqrestore(&mq->lat_lock, flags);
+}
+
+/* the completion latency percentiles fio reports, in hundredths */
+static const unsigned int mmc_lat_pct[] = {
+	100, 500, 1000, 2000, 3000, 4000, 5000, 6000,
+	7000, 8000, 9000, 9500, 9900, 9950, 9990, 9995,
+};
+
+/**
+ * mmc_queue_lat_show - format the latency statistics of a queue
+ * @mq: MMC queue
+ * @buf: PAGE_SIZE buffer
+ *
+ * The output follows the completion latency part of the fio report, per
+ * direction. Percentiles are the upper bound of the histogram bucket they
+ * fall into, within 25% of the exact value.
+ */
+int mmc_queue_lat_show(struct mmc_queue *mq, char *buf)
+{
+	static const char * const dirs[] = { "read", "write" };
+	struct mmc_queue_lat lat;
+	u64 seen, want;
+	int dir, i, b, len = 0;
+
+	for (dir = READ; dir <= WRITE; dir++) {
+		spin_lock_irq(&mq->lat_lock);
+		lat = mq->lat[dir];
+		spin_unlock_irq(&mq->lat_lock);
+
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%s: ios=%llu, bytes=%llu\n", dirs[dir],
+				 lat.ios, lat.bytes);
+		if (!lat.ios)
+			continue;
+
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "  clat (usec): min=%u, max=%u, avg=%llu\n",
+				 lat.min_us, lat.max_us,
+				 div64_u64(lat.sum_us, lat.ios));
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "  clat percentiles (usec):\n");
+
+		seen = 0;
+		b = 0;
+		for (i = 0; i < ARRAY_SIZE(mmc_lat_pct); i++) {
+			want = div_u64(lat.ios * mmc_lat_pct[i] + 9999, 10000);
+			while (seen + lat.hist[b] < want &&
+			       b < MMC_LAT_BUCKETS - 1)
+				seen += lat.hist[b++];
+
+			len += scnprintf(buf + len, PAGE_SIZE - len,
+					 "%s%2u.%02uth=[%6u]%s",
+					 i % 4 ? " " : "   |",
+					 mmc_lat_pct[i] / 100,
+					 mmc_lat_pct[i] % 100,
+					 min(mmc_lat_bucket_max(b), lat.max_us),
+					 i % 4 == 3 ? "\n" : ",");
+		}
+	}
+
+	return len;
+}
@@ -1,10 +1,14 @@
 #ifndef MMC_QUEUE_H
 #define MMC_QUEUE_H
 
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+
 #define MMC_REQ_SPECIAL_MASK	(REQ_DISCARD | REQ_FLUSH)
 
 struct request;
 struct task_struct;
+struct blk_mq_hw_ctx;
 
 struct mmc_blk_request {
 	struct mmc_request	mrq;
@@ -41,6 +45,22 @@ struct mmc_queue_req {
 	struct mmc_async_req	mmc_active;
 	enum mmc_packed_type	cmd_type;
 	struct mmc_packed	*packed;
+	ktime_t			start;		/* taken by mmcqd */
+};
+
+/*
+ * Completion latency histogram: exact below 4us, then four buckets per
+ * power of two, the last one catching everything above ~16s.
+ */
+#define MMC_LAT_BUCKETS		96
+
+struct mmc_queue_lat {
+	u64			ios;
+	u64			bytes;
+	u64			sum_us;
+	u32			min_us;
+	u32			max_us;
+	u32			hist[MMC_LAT_BUCKETS];
 };
 
 struct mmc_queue {
@@ -57,6 +77,14 @@ struct mmc_queue {
 	struct mmc_queue_req	mqrq[2];
 	struct mmc_queue_req	*mqrq_cur;
 	struct mmc_queue_req	*mqrq_prev;
+
+	/* blk-mq only: requests handed over by ->queue_rq() to mmcqd */
+	bool			use_mq;
+	spinlock_t		mq_lock;
+	struct list_head	mq_list;
+
+	spinlock_t		lat_lock;
+	struct mmc_queue_lat	lat[2];		/* READ, WRITE */
 };
 
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *,
@@ -70,6 +98,11 @@ extern unsigned int mmc_queue_map_sg(struct mmc_queue *,
 extern void mmc_queue_bounce_pre(struct mmc_queue_req *);
 extern void mmc_queue_bounce_post(struct mmc_queue_req *);
 
+extern bool mmc_queue_end_request(struct mmc_queue *, struct mmc_queue_req *,
+				  struct request *, int, unsigned int);
+extern int mmc_queue_lat_show(struct mmc_queue *, char *);
+extern void mmc_queue_lat_reset(struct mmc_queue *);
+
 extern int mmc_packed_init(struct mmc_queue *, struct mmc_card *);
 extern void mmc_packed_clean(struct mmc_queue *);
 
@@ -42,6 +42,7 @@
 #define	OPCODE_FAST_READ	0x0b	/* Read data bytes (high frequency) */
 #define	OPCODE_DUAL_READ        0x3b    /* Read data bytes (Dual SPI) */
 #define	OPCODE_QUAD_READ        0x6b    /* Read data bytes (Quad SPI) */
+#define	OPCODE_QUAD_IO_READ	0xeb	/* Read data bytes (Quad I/O SPI) */
 #define	OPCODE_PP		0x02	/* Page program (up to 256 bytes) */
 #define OPCODE_QPP		0x32	/* Quad page program */
 #define	OPCODE_BE_4K		0x20	/* Erase 4KiB block */
@@ -60,7 +61,9 @@
 #define	OPCODE_FAST_READ_4B	0x0c	/* Read data bytes (high frequency) */
 #define	OPCODE_DUAL_READ_4B	0x3c    /* Read data bytes (Dual SPI) */
 #define	OPCODE_QUAD_READ_4B	0x6c    /* Read data bytes (Quad SPI) */
+#define	OPCODE_QUAD_IO_READ_4B	0xec	/* Read data bytes (Quad I/O SPI) */
 #define	OPCODE_PP_4B		0x12	/* Page program (up to 256 bytes) */
+#define	OPCODE_QPP_4B		0x34	/* Quad page program */
 #define	OPCODE_SE_4B		0xdc	/* Sector erase (usually 64KiB) */
 
 /* Used for SST flashes only. */
@@ -109,7 +112,7 @@
 
 /* Define max times to check status register before we give up. */
 #define	MAX_READY_WAIT_JIFFIES	(480 * HZ) /* N25Q specs 480s max chip erase */
-#define	MAX_CMD_SIZE		6
+#define	MAX_CMD_SIZE		10	/* opcode, 4 address, 5 dummy */
 
 #define JEDEC_MFR(_jedec_id)	((_jedec_id) >> 16)
 
@@ -120,6 +123,7 @@ enum read_type {
 	M25P80_FAST,
 	M25P80_DUAL,
 	M25P80_QUAD,
+	M25P80_QUAD_IO,
 };
 
 struct m25p {
@@ -131,10 +135,12 @@ struct m25p {
 	u16			n_sectors;
 	u32			sector_size;
 	u8			erase_opcode;
+	u8			erase_opcode_big;
 	u8			read_opcode;
 	u8			program_opcode;
 	u8			*command;
 	enum read_type		flash_read;
+	u8			quad_io_dummy;
 	u16			curbank;
 	u32			jedec_id;
 	bool			check_fsr;
@@ -327,16 +333,19 @@ static int wait_till_ready(struct m25p *flash)
 	deadline = jiffies + MAX_READY_WAIT_JIFFIES;
 
 	do {
-		if ((sr = read_sr(flash)) < 0)
+		/*
+		 * The flag status register alone tells when program and
+		 * erase are done, so don't spend two reads on each poll.
+		 */
+		if (flash->check_fsr) {
+			if ((fsr = read_fsr(flash)) < 0)
+				break;
+			else if (fsr & FSR_RDY)
+				return 0;
+		} else if ((sr = read_sr(flash)) < 0)
 			break;
-		else if (!(sr & SR_WIP)) {
-			if (flash->check_fsr) {
-				fsr = read_fsr(flash);
-				if (!(fsr & FSR_RDY))
-					return 1;
-			}
+		else if (!(sr & SR_WIP))
 			return 0;
-		}
 
 		cond_resched();
 
@@ -476,6 +485,26 @@ static int set_quad_mode(struct m25p *flash, u32 jedec_id)
 	}
 }
 
+/*
+ * Number of dummy bytes, sent on four lines, after the address of a quad
+ * I/O read: the mode byte plus the default dummy cycles. The mode byte
+ * is sent as zero, which never enters continuous read (XIP) mode.
+ * Returns 0 if quad I/O read is not known to work for the vendor.
+ */
+static u8 quad_io_dummy_bytes(u32 jedec_id)
+{
+	switch (JEDEC_MFR(jedec_id)) {
+	case CFI_MFR_ST: /* Micron, actually */
+		return 5;	/* 10 cycles */
+	case CFI_MFR_AMD: /* Spansion, actually */
+	case CFI_MFR_MACRONIX:
+	case 0xEF /* winbond */:
+		return 3;	/* mode byte + 4 cycles */
+	default:
+		return 0;
+	}
+}
+
 /*
  * Erase the whole flash memory
  *
@@ -534,16 +563,33 @@ static int m25p_cmdsz(struct m25p *flash)
 	return 1 + flash->addr_width;
 }
 
+/*
+ * Set up a Write Enable transfer to start a program or erase message
+ * with, saving a separate trip through the SPI message queue. The chip
+ * select toggle after it latches the WEL bit. The opcode lives past the
+ * end of the command buffer, to be DMA safe.
+ */
+static void m25p_wren_transfer(struct m25p *flash, struct spi_transfer *t)
+{
+	memset(t, 0, sizeof(*t));
+	t->tx_buf = flash->command + MAX_CMD_SIZE;
+	t->len = 1;
+	t->cs_change = 1;
+}
+
 /*
  * Erase one sector of flash memory at offset ``offset'' which is any
- * address within the sector which should be erased.
+ * address within the sector which should be erased, using @opcode.
  *
  * Returns 0 if successful, non-zero otherwise.
  */
-static int erase_sector(struct m25p *flash, u32 offset)
+static int erase_sector(struct m25p *flash, u32 offset, u8 opcode)
 {
-	pr_debug("%s: %s %dKiB at 0x%08x\n", dev_name(&flash->spi->dev),
-			__func__, flash->mtd.erasesize / 1024, offset);
+	struct spi_transfer t[2];
+	struct spi_message m;
+
+	pr_debug("%s: %s 0x%02x at 0x%08x\n", dev_name(&flash->spi->dev),
+			__func__, opcode, offset);
 
 	/* Wait until finished previous write command. */
 	if (wait_till_ready(flash))
@@ -553,16 +599,21 @@ static int erase_sector(struct m25p *flash, u32 offset)
 	if (write_ear(flash, offset))
 		return 1;
 
-	/* Send write enable, then erase commands. */
-	write_enable(flash);
-
 	/* Set up command buffer. */
-	flash->command[0] = flash->erase_opcode;
+	flash->command[0] = opcode;
 	m25p_addr2cmd(flash, offset, flash->command);
 
-	spi_write(flash->spi, flash->command, m25p_cmdsz(flash));
+	/* Send write enable, then erase commands. */
+	spi_message_init(&m);
+	m25p_wren_transfer(flash, &t[0]);
+	spi_message_add_tail(&t[0], &m);
 
-	return 0;
+	memset(&t[1], 0, sizeof(t[1]));
+	t[1].tx_buf = flash->command;
+	t[1].len = m25p_cmdsz(flash);
+	spi_message_add_tail(&t[1], &m);
+
+	return spi_sync(flash->spi, &m) ? 1 : 0;
 }
 
 /****************************************************************************/
@@ -602,14 +653,23 @@ static int m25p80_erase(struct mtd_info *mtd, struct erase_info *instr)
 			return -EIO;
 		}
 
-	/* REVISIT in some cases we could speed up erasing large regions
-	 * by using OPCODE_SE instead of OPCODE_BE_4K.  We may have set up
-	 * to use "small sector erase", but that's not always optimal.
+	/*
+	 * "sector"-at-a-time erase. If we use small sector erase, whole
+	 * sectors in the range are still erased with OPCODE_SE, which is
+	 * much faster than erasing them in small blocks.
 	 */
-
-	/* "sector"-at-a-time erase */
 	} else {
 		while (len) {
+			u8 opcode = flash->erase_opcode;
+			u32 size = mtd->erasesize;
+
+			if (flash->erase_opcode_big &&
+			    !(addr % flash->sector_size) &&
+			    len >= flash->sector_size) {
+				opcode = flash->erase_opcode_big;
+				size = flash->sector_size;
+			}
+
 			offset = addr;
 			if (flash->isparallel == 1)
 				offset /= 2;
@@ -622,14 +682,14 @@ static int m25p80_erase(struct mtd_info *mtd, struct erase_info *instr)
 					flash->spi->master->flags &=
 							~SPI_MASTER_U_PAGE;
 			}
-			if (erase_sector(flash, offset)) {
+			if (erase_sector(flash, offset, opcode)) {
 				instr->state = MTD_ERASE_FAILED;
 				mutex_unlock(&flash->lock);
 				return -EIO;
 			}
 
-			addr += mtd->erasesize;
-			len -= mtd->erasesize;
+			addr += size;
+			len -= size;
 		}
 	}
 
@@ -653,6 +713,8 @@ static inline int m25p80_dummy_cycles_read(struct m25p *flash)
 	case M25P80_DUAL:
 	case M25P80_QUAD:
 		return 1;
+	case M25P80_QUAD_IO:
+		return flash->quad_io_dummy;
 	case M25P80_NORMAL:
 		return 0;
 	default:
@@ -667,6 +729,7 @@ static inline unsigned int m25p80_rx_nbits(const struct m25p *flash)
 	case M25P80_DUAL:
 		return 2;
 	case M25P80_QUAD:
+	case M25P80_QUAD_IO:
 		return 4;
 	default:
 		return 0;
@@ -716,6 +779,8 @@ static int m25p80_read(struct mtd_info *mtd, loff_t from, size_t len,
 	opcode = flash->read_opcode;
 	flash->command[0] = opcode;
 	m25p_addr2cmd(flash, from, flash->command);
+	/* quad I/O reads take the first dummy byte as mode bits */
+	memset(flash->command + m25p_cmdsz(flash), 0, dummy);
 
 	spi_sync(flash->spi, &m);
 
@@ -785,74 +850,63 @@ static int m25p80_write(struct mtd_info *mtd, loff_t to, size_t len,
 {
 	struct m25p *flash = mtd_to_m25p(mtd);
 	u32 page_offset, page_size;
-	struct spi_transfer t[2];
+	struct spi_transfer t[3];
 	struct spi_message m;
+	u32 i;
 
 	pr_debug("%s: %s to 0x%08x, len %zd\n", dev_name(&flash->spi->dev),
 			__func__, (u32)to, len);
 
-	spi_message_init(&m);
-	memset(t, 0, (sizeof t));
+	*retlen = 0;
 
-	t[0].tx_buf = flash->command;
-	t[0].len = m25p_cmdsz(flash);
+	/*
+	 * Each page goes out as one message: write enable, then the
+	 * program command and its data. The next page is set up while the
+	 * flash is still busy with the previous one, so only the status
+	 * polls are left between page programs.
+	 */
+	spi_message_init(&m);
+	m25p_wren_transfer(flash, &t[0]);
 	spi_message_add_tail(&t[0], &m);
 
-	t[1].tx_buf = buf;
+	memset(&t[1], 0, sizeof(t[1]));
+	t[1].tx_buf = flash->command;
+	t[1].len = m25p_cmdsz(flash);
 	spi_message_add_tail(&t[1], &m);
 
-	/* Wait until finished previous write command. */
-	if (wait_till_ready(flash))
-		return 1;
-
-	write_enable(flash);
-
-	/* Set up the opcode in the write buffer. */
-	flash->command[0] = flash->program_opcode;
-	m25p_addr2cmd(flash, (to >> flash->shift), flash->command);
+	memset(&t[2], 0, sizeof(t[2]));
+	if (flash->program_opcode == OPCODE_QPP ||
+	    flash->program_opcode == OPCODE_QPP_4B)
+		t[2].tx_nbits = SPI_NBITS_QUAD;
+	spi_message_add_tail(&t[2], &m);
 
+	/* the size of data remaining on the first page */
 	page_offset = to & (flash->page_size - 1);
+	page_size = min_t(u32, len, flash->page_size - page_offset);
 
-	/* do all the bytes fit onto one page? */
-	if (page_offset + len <= flash->page_size) {
-		t[1].len = len;
-
-		spi_sync(flash->spi, &m);
-
-		*retlen = m.actual_length - m25p_cmdsz(flash);
-	} else {
-		u32 i;
-
-		/* the size of data remaining on the first page */
-		page_size = flash->page_size - page_offset;
-
-		t[1].len = page_size;
-		spi_sync(flash->spi, &m);
-
-		*retlen = m.actual_length - m25p_cmdsz(flash);
-
-		/* write everything in flash->page_size chunks */
-		for (i = page_size; i < len; i += page_size) {
+	for (i = 0; i < len; i += page_size) {
+		if (i) {
 			page_size = len - i;
 			if (page_size > flash->page_size)
 				page_size = flash->page_size;
+		}
 
-			/* write the next page to flash */
-			m25p_addr2cmd(flash, ((to + i) >> flash->shift),
-					flash->command);
-
-			t[1].tx_buf = buf + i;
-			t[1].len = page_size;
+		t[2].tx_buf = buf + i;
+		t[2].len = page_size;
 
-			if (wait_till_ready(flash))
-				return 1;
+		/* Set up the opcode in the write buffer. */
+		flash->command[0] = flash->program_opcode;
+		m25p_addr2cmd(flash, ((to + i) >> flash->shift),
+			      flash->command);
 
-			write_enable(flash);
+		/* Wait until finished previous write command. */
+		if (wait_till_ready(flash))
+			return 1;
 
-			spi_sync(flash->spi, &m);
+		if (spi_sync(flash->spi, &m))
+			return 1;
 
-			*retlen += m.actual_length - m25p_cmdsz(flash);
-		}
+		*retlen += page_size;
 	}
 
 	return 0;
@@ -869,6 +923,7 @@ static int m25p80_write_ext(struct mtd_info *mtd, loff_t to, size_t len,
 	u32 write_count = 0;
 	u32 rem_bank_len = 0;
 	u8 bank = 0;
+	int ret = 0;
 
 #define OFFSET_16_MB 0x1000000
 
@@ -893,7 +948,11 @@ static int m25p80_write_ext(struct mtd_info *mtd, loff_t to, size_t len,
 		else
 			write_len = rem_bank_len;
 
-		m25p80_write(mtd, offset, write_len, &actual_len, buf);
+		ret = m25p80_write(mtd, offset, write_len, &actual_len, buf);
+		if (ret) {
+			ret = -EIO;
+			break;
+		}
 
 		addr += actual_len;
 		len -= actual_len;
@@ -904,7 +963,7 @@ static int m25p80_write_ext(struct mtd_info *mtd, loff_t to, size_t len,
 	*retlen = write_count;
 
 	mutex_unlock(&flash->lock);
-	return 0;
+	return ret;
 }
 
 static int sst_write(struct mtd_info *mtd, loff_t to, size_t len,
@@ -1554,9 +1613,10 @@ static int m25p_probe(struct spi_device *spi)
 	if (!flash)
 		return -ENOMEM;
 
-	flash->command = devm_kzalloc(&spi->dev, MAX_CMD_SIZE, GFP_KERNEL);
+	flash->command = devm_kzalloc(&spi->dev, MAX_CMD_SIZE + 1, GFP_KERNEL);
 	if (!flash->command)
 		return -ENOMEM;
+	flash->command[MAX_CMD_SIZE] = OPCODE_WREN;
 
 	flash->spi = spi;
 	mutex_init(&flash->lock);
@@ -1661,6 +1721,9 @@ static int m25p_probe(struct spi_device *spi)
 		flash->erase_opcode = OPCODE_SE;
 		flash->mtd.erasesize = info->sector_size;
 	}
+	/* ... but erase whole sectors at once */
+	if (flash->mtd.erasesize < info->sector_size)
+		flash->erase_opcode_big = OPCODE_SE;
 
 	flash->read_opcode = OPCODE_NORM_READ;
 	flash->program_opcode = OPCODE_PP;
@@ -1700,12 +1763,29 @@ static int m25p_probe(struct spi_device *spi)
 			return ret;
 		}
 		flash->flash_read = M25P80_QUAD;
+
+		/*
+		 * Quad I/O read sends the address on four lines too. Only
+		 * use it on controllers that switch the bus width from the
+		 * opcode, as the address is in the same transfer as the
+		 * opcode.
+		 */
+		if (spi->mode & SPI_TX_QUAD &&
+		    spi->master->flags & SPI_MASTER_QUAD_MODE) {
+			flash->quad_io_dummy =
+				quad_io_dummy_bytes(info->jedec_id);
+			if (flash->quad_io_dummy)
+				flash->flash_read = M25P80_QUAD_IO;
+		}
 	} else if (spi->mode & SPI_RX_DUAL && info->flags & M25P80_DUAL_READ) {
 		flash->flash_read = M25P80_DUAL;
 	}
 
 	/* Default commands */
 	switch (flash->flash_read) {
+	case M25P80_QUAD_IO:
+		flash->read_opcode = OPCODE_QUAD_IO_READ;
+		break;
 	case M25P80_QUAD:
 		flash->read_opcode = OPCODE_QUAD_READ;
 		break;
@@ -1725,7 +1805,13 @@ static int m25p_probe(struct spi_device *spi)
 
 	flash->program_opcode = OPCODE_PP;
 
-	if (spi->master->mode_bits & SPI_TX_QUAD)
+	/*
+	 * Quad page program needs the flash to be set up for quad I/O as
+	 * for quad read. Macronix has a 4PP opcode with a quad address
+	 * instead.
+	 */
+	if (spi->mode & SPI_TX_QUAD && info->flags & M25P80_QUAD_READ &&
+	    JEDEC_MFR(info->jedec_id) != CFI_MFR_MACRONIX)
 		flash->program_opcode = OPCODE_QPP;
 
 	if (info->addr_width)
@@ -1750,6 +1836,9 @@ static int m25p_probe(struct spi_device *spi)
 		if (JEDEC_MFR(info->jedec_id) == CFI_MFR_AMD) {
 			/* Dedicated 4-byte command set */
 			switch (flash->flash_read) {
+			case M25P80_QUAD_IO:
+				flash->read_opcode = OPCODE_QUAD_IO_READ_4B;
+				break;
 			case M25P80_QUAD:
 				flash->read_opcode = OPCODE_QUAD_READ_4B;
 				break;
@@ -1763,9 +1852,13 @@ static int m25p_probe(struct spi_device *spi)
 				flash->read_opcode = OPCODE_NORM_READ_4B;
 				break;
 			}
-			flash->program_opcode = OPCODE_PP_4B;
+			if (flash->program_opcode == OPCODE_QPP)
+				flash->program_opcode = OPCODE_QPP_4B;
+			else
+				flash->program_opcode = OPCODE_PP_4B;
 			/* No small sector erase for 4-byte command set */
 			flash->erase_opcode = OPCODE_SE_4B;
+			flash->erase_opcode_big = 0;
 			flash->mtd.erasesize = info->sector_size;
 		} else
 			set_4byte(flash, info->jedec_id, 1);
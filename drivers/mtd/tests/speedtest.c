@@ -42,7 +42,9 @@ MODULE_PARM_DESC(count, "Maximum number of eraseblocks to use "
 			"(0 means use all)");
 
 static struct mtd_info *mtd;
+/* iobuf holds the written pattern, reads go to rbuf and never touch it */
 static unsigned char *iobuf;
+static unsigned char *rbuf;
 static unsigned char *bbt;
 
 static int pgsize;
@@ -126,14 +128,30 @@ static int read_eraseblock(int ebnum)
 {
 	loff_t addr = ebnum * mtd->erasesize;
 
-	return mtdtest_read(mtd, addr, mtd->erasesize, iobuf);
+	return mtdtest_read(mtd, addr, mtd->erasesize, rbuf);
+}
+
+/* compare with what write_eraseblock() wrote, outside of the timing */
+static int verify_eraseblock(int ebnum)
+{
+	loff_t addr = ebnum * mtd->erasesize;
+	int err;
+
+	err = mtdtest_read(mtd, addr, mtd->erasesize, rbuf);
+	if (err)
+		return err;
+	if (memcmp(iobuf, rbuf, mtd->erasesize)) {
+		pr_err("error: verify failed at EB %d\n", ebnum);
+		return -EIO;
+	}
+	return 0;
 }
 
 static int read_eraseblock_by_page(int ebnum)
 {
 	int i, err = 0;
 	loff_t addr = ebnum * mtd->erasesize;
-	void *buf = iobuf;
+	void *buf = rbuf;
 
 	for (i = 0; i < pgcnt; i++) {
 		err = mtdtest_read(mtd, addr, pgsize, buf);
@@ -151,7 +169,7 @@ static int read_eraseblock_by_2pages(int ebnum)
 	size_t sz = pgsize * 2;
 	int i, n = pgcnt / 2, err = 0;
 	loff_t addr = ebnum * mtd->erasesize;
-	void *buf = iobuf;
+	void *buf = rbuf;
 
 	for (i = 0; i < n; i++) {
 		err = mtdtest_read(mtd, addr, sz, buf);
@@ -245,6 +263,10 @@ static int __init mtd_speedtest_init(void)
 
 	prandom_bytes(iobuf, mtd->erasesize);
 
+	rbuf = kmalloc(mtd->erasesize, GFP_KERNEL);
+	if (!rbuf)
+		goto out;
+
 	bbt = kzalloc(ebcnt, GFP_KERNEL);
 	if (!bbt)
 		goto out;
@@ -290,6 +312,16 @@ static int __init mtd_speedtest_init(void)
 	speed = calc_speed();
 	pr_info("eraseblock read speed is %ld KiB/s\n", speed);
 
+	for (i = 0; i < ebcnt; ++i) {
+		if (bbt[i])
+			continue;
+		err = verify_eraseblock(i);
+		if (err)
+			goto out;
+		cond_resched();
+	}
+	pr_info("eraseblocks verified\n");
+
 	err = mtdtest_erase_good_eraseblocks(mtd, bbt, 0, ebcnt);
 	if (err)
 		goto out;
@@ -393,8 +425,27 @@ static int __init mtd_speedtest_init(void)
 		pr_info("%dx multi-block erase speed is %ld KiB/s\n",
 		       blocks, speed);
 	}
+	/* Erase and write all eraseblocks, as a firmware update does */
+	pr_info("testing update speed\n");
+	start_timing();
+	for (i = 0; i < ebcnt; ++i) {
+		if (bbt[i])
+			continue;
+		err = multiblock_erase(i, 1);
+		if (err)
+			goto out;
+		err = write_eraseblock(i);
+		if (err)
+			goto out;
+		cond_resched();
+	}
+	stop_timing();
+	speed = calc_speed();
+	pr_info("update speed is %ld KiB/s\n", speed);
+
 	pr_info("finished\n");
 out:
+	kfree(rbuf);
 	kfree(iobuf);
 	kfree(bbt);
 	put_mtd_device(mtd);
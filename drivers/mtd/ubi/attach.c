@@ -87,6 +87,9 @@
 #include <linux/crc32.h>
 #include <linux/math64.h>
 #include <linux/random.h>
+#include <linux/ktime.h>
+#include <linux/cpumask.h>
+#include <linux/workqueue.h>
 #include "ubi.h"
 
 static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
@@ -95,6 +98,66 @@ static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
 static struct ubi_ec_hdr *ech;
 static struct ubi_vid_hdr *vidh;
 
+/*
+ * When scanning, the headers of %UBI_SCAN_BATCH PEBs at a time are read
+ * ahead by up to %UBI_SCAN_MAX_THREADS workers, one per online CPU.
+ */
+#define UBI_SCAN_BATCH		128
+#define UBI_SCAN_MAX_THREADS	8
+
+/**
+ * struct ubi_scan_hdrs - headers of a PEB read ahead of scanning.
+ * @bad: what 'ubi_io_is_bad()' returned
+ * @ec_err: what 'ubi_io_read_ec_hdr()' returned
+ * @vid_err: what 'ubi_io_read_vid_hdr()' returned, valid only if the EC
+ *           header was read and the PEB is not empty
+ * @ech: copy of the EC header
+ * @vidh: copy of the VID header
+ */
+struct ubi_scan_hdrs {
+	int bad;
+	int ec_err;
+	int vid_err;
+	struct ubi_ec_hdr ech;
+	struct ubi_vid_hdr vidh;
+};
+
+struct ubi_scan_ctx;
+
+/**
+ * struct ubi_scan_worker - a PEB header reading worker.
+ * @work: the work item
+ * @ctx: the scanning context this worker belongs to
+ * @ech: EC header buffer of this worker
+ * @vidh: VID header buffer of this worker
+ */
+struct ubi_scan_worker {
+	struct work_struct work;
+	struct ubi_scan_ctx *ctx;
+	struct ubi_ec_hdr *ech;
+	struct ubi_vid_hdr *vidh;
+};
+
+/**
+ * struct ubi_scan_ctx - parallel PEB header reading context.
+ * @ubi: UBI device description object
+ * @first: first PEB of the current batch
+ * @count: count of PEBs in the current batch
+ * @next: index of the next PEB of the batch to be read
+ * @hdrs: headers of the PEBs of the current batch
+ * @nr_workers: count of workers
+ * @workers: the workers
+ */
+struct ubi_scan_ctx {
+	struct ubi_device *ubi;
+	int first;
+	int count;
+	atomic_t next;
+	struct ubi_scan_hdrs hdrs[UBI_SCAN_BATCH];
+	int nr_workers;
+	struct ubi_scan_worker workers[UBI_SCAN_MAX_THREADS];
+};
+
 /**
  * add_to_list - add physical eraseblock to a list.
  * @ai: attaching information
@@ -807,6 +870,7 @@ out_unlock:
  * @pnum: the physical eraseblock number
  * @vid: The volume ID of the found volume will be stored in this pointer
  * @sqnum: The sqnum of the found volume will be stored in this pointer
+ * @hdrs: the headers of @pnum if they were read ahead, %NULL otherwise
  *
  * This function reads UBI headers of PEB @pnum, checks them, and adds
  * information about this PEB to the corresponding list or RB-tree in the
@@ -814,15 +878,20 @@ out_unlock:
  * successfully handled and a negative error code in case of failure.
  */
 static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
-		    int pnum, int *vid, unsigned long long *sqnum)
+		    int pnum, int *vid, unsigned long long *sqnum,
+		    const struct ubi_scan_hdrs *hdrs)
 {
 	long long uninitialized_var(ec);
 	int err, bitflips = 0, vol_id = -1, ec_err = 0;
 
 	dbg_bld("scan PEB %d", pnum);
+	ubi->attach_stats.scanned_pebs += 1;
 
 	/* Skip bad physical eraseblocks */
-	err = ubi_io_is_bad(ubi, pnum);
+	if (hdrs)
+		err = hdrs->bad;
+	else
+		err = ubi_io_is_bad(ubi, pnum);
 	if (err < 0)
 		return err;
 	else if (err) {
@@ -830,7 +899,11 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
-	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	if (hdrs) {
+		err = hdrs->ec_err;
+		memcpy(ech, &hdrs->ech, sizeof(struct ubi_ec_hdr));
+	} else
+		err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -912,7 +985,11 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	/* OK, we've done with the EC header, let's look at the VID header */
 
-	err = ubi_io_read_vid_hdr(ubi, pnum, vidh, 0);
+	if (hdrs) {
+		err = hdrs->vid_err;
+		memcpy(vidh, &hdrs->vidh, sizeof(struct ubi_vid_hdr));
+	} else
+		err = ubi_io_read_vid_hdr(ubi, pnum, vidh, 0);
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -1211,6 +1288,122 @@ static void destroy_ai(struct ubi_attach_info *ai)
 	kfree(ai);
 }
 
+/**
+ * read_hdrs_work - read the headers of the PEBs of the current batch.
+ * @work: the work item of the worker
+ *
+ * The workers take the PEBs of the batch one at a time, so that a PEB which
+ * is slow to read (e.g., because of ECC correction) does not hold back the
+ * others. The VID header is not read if the PEB is bad or empty, as
+ * 'scan_peb()' would not read it either.
+ */
+static void read_hdrs_work(struct work_struct *work)
+{
+	struct ubi_scan_worker *w = container_of(work, struct ubi_scan_worker,
+						 work);
+	struct ubi_scan_ctx *ctx = w->ctx;
+	struct ubi_device *ubi = ctx->ubi;
+	struct ubi_scan_hdrs *h;
+	int i, pnum;
+
+	while ((i = atomic_inc_return(&ctx->next) - 1) < ctx->count) {
+		h = &ctx->hdrs[i];
+		pnum = ctx->first + i;
+
+		h->bad = ubi_io_is_bad(ubi, pnum);
+		if (h->bad)
+			continue;
+
+		h->ec_err = ubi_io_read_ec_hdr(ubi, pnum, w->ech, 0);
+		if (h->ec_err < 0 || h->ec_err == UBI_IO_FF ||
+		    h->ec_err == UBI_IO_FF_BITFLIPS)
+			continue;
+		memcpy(&h->ech, w->ech, sizeof(struct ubi_ec_hdr));
+
+		h->vid_err = ubi_io_read_vid_hdr(ubi, pnum, w->vidh, 0);
+		memcpy(&h->vidh, w->vidh, sizeof(struct ubi_vid_hdr));
+	}
+}
+
+/**
+ * read_hdrs_batch - read the headers of a batch of PEBs in parallel.
+ * @ctx: parallel reading context
+ * @first: first PEB of the batch
+ * @count: count of PEBs in the batch, at most %UBI_SCAN_BATCH
+ */
+static void read_hdrs_batch(struct ubi_scan_ctx *ctx, int first, int count)
+{
+	int i;
+
+	ctx->first = first;
+	ctx->count = count;
+	atomic_set(&ctx->next, 0);
+
+	for (i = 0; i < ctx->nr_workers; i++)
+		queue_work(system_unbound_wq, &ctx->workers[i].work);
+	for (i = 0; i < ctx->nr_workers; i++)
+		flush_work(&ctx->workers[i].work);
+}
+
+static void free_scan_ctx(struct ubi_device *ubi, struct ubi_scan_ctx *ctx)
+{
+	int i;
+
+	if (!ctx)
+		return;
+
+	for (i = 0; i < ctx->nr_workers; i++) {
+		ubi_free_vid_hdr(ubi, ctx->workers[i].vidh);
+		kfree(ctx->workers[i].ech);
+	}
+	vfree(ctx);
+}
+
+/**
+ * alloc_scan_ctx - allocate a parallel PEB header reading context.
+ * @ubi: UBI device description object
+ *
+ * Returns %NULL if there is only one online CPU, or if the memory for at
+ * least two workers cannot be allocated; the headers are then read by
+ * 'scan_peb()' itself.
+ */
+static struct ubi_scan_ctx *alloc_scan_ctx(struct ubi_device *ubi)
+{
+	struct ubi_scan_ctx *ctx;
+	struct ubi_scan_worker *w;
+	int i, n = min_t(int, num_online_cpus(), UBI_SCAN_MAX_THREADS);
+
+	if (n < 2)
+		return NULL;
+
+	ctx = vzalloc(sizeof(struct ubi_scan_ctx));
+	if (!ctx)
+		return NULL;
+	ctx->ubi = ubi;
+
+	for (i = 0; i < n; i++) {
+		w = &ctx->workers[i];
+		w->ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+		w->vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+		if (!w->ech || !w->vidh) {
+			ubi_free_vid_hdr(ubi, w->vidh);
+			kfree(w->ech);
+			break;
+		}
+
+		w->ctx = ctx;
+		INIT_WORK(&w->work, read_hdrs_work);
+		ctx->nr_workers += 1;
+	}
+
+	if (ctx->nr_workers < 2) {
+		free_scan_ctx(ubi, ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
 /**
  * scan_all - scan entire MTD device.
  * @ubi: UBI device description object
@@ -1224,10 +1417,11 @@ static void destroy_ai(struct ubi_attach_info *ai)
 static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		    int start)
 {
-	int err, pnum;
+	int err, pnum, i, n;
 	struct rb_node *rb1, *rb2;
 	struct ubi_ainf_volume *av;
 	struct ubi_ainf_peb *aeb;
+	struct ubi_scan_ctx *ctx;
 
 	err = -ENOMEM;
 
@@ -1239,15 +1433,33 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (!vidh)
 		goto out_ech;
 
-	for (pnum = start; pnum < ubi->peb_count; pnum++) {
-		cond_resched();
+	/*
+	 * Reading the headers is what takes the time, so it is done in
+	 * parallel a batch at a time. The PEBs are still processed one by one
+	 * and in order, exactly as if 'scan_peb()' had read them.
+	 */
+	ctx = alloc_scan_ctx(ubi);
+	ubi->attach_stats.scan_threads = ctx ? ctx->nr_workers : 1;
 
-		dbg_gen("process PEB %d", pnum);
-		err = scan_peb(ubi, ai, pnum, NULL, NULL);
-		if (err < 0)
-			goto out_vidh;
+	for (pnum = start; pnum < ubi->peb_count; pnum += n) {
+		n = min(ubi->peb_count - pnum, UBI_SCAN_BATCH);
+		if (ctx)
+			read_hdrs_batch(ctx, pnum, n);
+
+		for (i = 0; i < n; i++) {
+			cond_resched();
+
+			dbg_gen("process PEB %d", pnum + i);
+			err = scan_peb(ubi, ai, pnum + i, NULL, NULL,
+				       ctx ? &ctx->hdrs[i] : NULL);
+			if (err < 0) {
+				free_scan_ctx(ubi, ctx);
+				goto out_vidh;
+			}
+		}
 	}
 
+	free_scan_ctx(ubi, ctx);
 	ubi_msg("scanning is finished");
 
 	/* Calculate mean erase counter */
@@ -1330,7 +1542,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info *ai)
 		cond_resched();
 
 		dbg_gen("process PEB %d", pnum);
-		err = scan_peb(ubi, ai, pnum, &vol_id, &sqnum);
+		err = scan_peb(ubi, ai, pnum, &vol_id, &sqnum, NULL);
 		if (err < 0)
 			goto out_vidh;
 
@@ -1382,6 +1594,16 @@ static struct ubi_attach_info *alloc_ai(const char *slab_name)
 	return ai;
 }
 
+/* Returns the microseconds elapsed since @t and moves @t to now */
+static unsigned int attach_phase_us(ktime_t *t)
+{
+	ktime_t now = ktime_get();
+	unsigned int us = ktime_us_delta(now, *t);
+
+	*t = now;
+	return us;
+}
+
 /**
  * ubi_attach - attach an MTD device.
  * @ubi: UBI device descriptor
@@ -1394,6 +1616,12 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 {
 	int err;
 	struct ubi_attach_info *ai;
+	struct ubi_attach_stats *st = &ubi->attach_stats;
+	ktime_t start, t;
+
+	memset(st, 0, sizeof(struct ubi_attach_stats));
+	st->scan_threads = 1;
+	start = t = ktime_get();
 
 	ai = alloc_ai("ubi_aeb_slab_cache");
 	if (!ai)
@@ -1406,10 +1634,12 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 		force_scan = 1;
 	}
 
-	if (force_scan)
+	if (force_scan) {
 		err = scan_all(ubi, ai, 0);
-	else {
+		st->scan_us = attach_phase_us(&t);
+	} else {
 		err = scan_fast(ubi, ai);
+		st->fastmap_us = attach_phase_us(&t);
 		if (err > 0) {
 			if (err != UBI_NO_FASTMAP) {
 				destroy_ai(ai);
@@ -1421,10 +1651,12 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 			} else {
 				err = scan_all(ubi, ai, UBI_FM_MAX_START);
 			}
+			st->scan_us = attach_phase_us(&t);
 		}
 	}
 #else
 	err = scan_all(ubi, ai, 0);
+	st->scan_us = attach_phase_us(&t);
 #endif
 	if (err)
 		goto out_ai;
@@ -1439,14 +1671,17 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	err = ubi_read_volume_table(ubi, ai);
 	if (err)
 		goto out_ai;
+	st->vtbl_us = attach_phase_us(&t);
 
 	err = ubi_wl_init(ubi, ai);
 	if (err)
 		goto out_vtbl;
+	st->wl_us = attach_phase_us(&t);
 
 	err = ubi_eba_init(ubi, ai);
 	if (err)
 		goto out_wl;
+	st->eba_us = attach_phase_us(&t);
 
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	if (ubi->fm && ubi_dbg_chk_gen(ubi)) {
@@ -1473,6 +1708,12 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 #endif
 
 	destroy_ai(ai);
+
+	st->total_us = ktime_us_delta(ktime_get(), start);
+	ubi_msg("attached in %u us: %d PEBs scanned by %d thread(s), fastmap %u us, scan %u us, vtbl %u us, wl %u us, eba %u us",
+		st->total_us, st->scanned_pebs, st->scan_threads,
+		st->fastmap_us, st->scan_us, st->vtbl_us, st->wl_us,
+		st->eba_us);
 	return 0;
 
 out_wl:
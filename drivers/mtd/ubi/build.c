@@ -81,6 +81,12 @@ static struct mtd_dev_param __initdata mtd_dev_param[UBI_MAX_DEVICES];
 #ifdef CONFIG_MTD_UBI_FASTMAP
 /* UBI module parameter to enable fastmap automatically on non-fastmap images */
 static bool fm_autoconvert;
+/*
+ * UBI module parameters overriding the fastmap pool sizes, zero means the
+ * default size or the size recorded in the fastmap
+ */
+int ubi_fm_pool_size;
+int ubi_fm_wl_pool_size;
 #endif
 /* Root UBI "class" object (corresponds to '/<sysfs>/class/ubi/') */
 struct class *ubi_class;
@@ -941,14 +947,21 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 
 	/*
 	 * fm_pool.max_size is 5% of the total number of PEBs but it's also
-	 * between UBI_FM_MAX_POOL_SIZE and UBI_FM_MIN_POOL_SIZE.
+	 * between UBI_FM_MAX_POOL_SIZE and UBI_FM_MIN_POOL_SIZE. Both pool
+	 * sizes can be overridden by module parameters.
 	 */
 	ubi->fm_pool.max_size = min(((int)mtd_div_by_eb(ubi->mtd->size,
 		ubi->mtd) / 100) * 5, UBI_FM_MAX_POOL_SIZE);
 	if (ubi->fm_pool.max_size < UBI_FM_MIN_POOL_SIZE)
 		ubi->fm_pool.max_size = UBI_FM_MIN_POOL_SIZE;
+	if (ubi_fm_pool_size)
+		ubi->fm_pool.max_size = clamp(ubi_fm_pool_size,
+			UBI_FM_MIN_POOL_SIZE, UBI_FM_MAX_POOL_SIZE);
 
 	ubi->fm_wl_pool.max_size = UBI_FM_WL_POOL_SIZE;
+	if (ubi_fm_wl_pool_size)
+		ubi->fm_wl_pool.max_size = clamp(ubi_fm_wl_pool_size,
+			UBI_FM_MIN_POOL_SIZE, UBI_FM_MAX_POOL_SIZE);
 	ubi->fm_disabled = !fm_autoconvert;
 
 	if (!ubi->fm_disabled && (int)mtd_div_by_eb(ubi->mtd->size, ubi->mtd)
@@ -1493,6 +1506,14 @@ MODULE_PARM_DESC(mtd, "MTD devices to attach. Parameter format: mtd=<name|num|pa
 #ifdef CONFIG_MTD_UBI_FASTMAP
 module_param(fm_autoconvert, bool, 0644);
 MODULE_PARM_DESC(fm_autoconvert, "Set this parameter to enable fastmap automatically on images without a fastmap.");
+module_param_named(fm_pool_size, ubi_fm_pool_size, int, 0644);
+MODULE_PARM_DESC(fm_pool_size, "Maximum number of PEBs in the fastmap user pool, between "
+		 __stringify(UBI_FM_MIN_POOL_SIZE) " and " __stringify(UBI_FM_MAX_POOL_SIZE)
+		 " (default: 5% of the PEBs). Larger pools mean fewer fastmap writes but more PEBs to scan on attach.");
+module_param_named(fm_wl_pool_size, ubi_fm_wl_pool_size, int, 0644);
+MODULE_PARM_DESC(fm_wl_pool_size, "Maximum number of PEBs in the fastmap WL pool, between "
+		 __stringify(UBI_FM_MIN_POOL_SIZE) " and " __stringify(UBI_FM_MAX_POOL_SIZE)
+		 " (default: " __stringify(UBI_FM_WL_POOL_SIZE) ").");
 #endif
 MODULE_VERSION(__stringify(UBI_VERSION));
 MODULE_DESCRIPTION("UBI - Unsorted Block Images");
@@ -359,6 +359,47 @@ static const struct file_operations dfs_fops = {
 	.owner  = THIS_MODULE,
 };
 
+/* Read the attach statistics debugfs file */
+static ssize_t dfs_attach_stats_read(struct file *file, char __user *user_buf,
+				     size_t count, loff_t *ppos)
+{
+	unsigned long ubi_num = (unsigned long)file->private_data;
+	struct ubi_device *ubi;
+	struct ubi_attach_stats *st;
+	char buf[256];
+	int len;
+
+	ubi = ubi_get_device(ubi_num);
+	if (!ubi)
+		return -ENODEV;
+	st = &ubi->attach_stats;
+
+	len = snprintf(buf, sizeof(buf),
+		       "scanned_pebs:\t%d\n"
+		       "scan_threads:\t%d\n"
+		       "fastmap_us:\t%u\n"
+		       "scan_us:\t%u\n"
+		       "vtbl_us:\t%u\n"
+		       "wl_us:\t\t%u\n"
+		       "eba_us:\t\t%u\n"
+		       "total_us:\t%u\n",
+		       st->scanned_pebs, st->scan_threads, st->fastmap_us,
+		       st->scan_us, st->vtbl_us, st->wl_us, st->eba_us,
+		       st->total_us);
+
+	count = simple_read_from_buffer(user_buf, count, ppos, buf, len);
+
+	ubi_put_device(ubi);
+	return count;
+}
+
+static const struct file_operations dfs_attach_stats_fops = {
+	.read   = dfs_attach_stats_read,
+	.open	= simple_open,
+	.llseek = default_llseek,
+	.owner  = THIS_MODULE,
+};
+
 /**
  * ubi_debugfs_init_dev - initialize debugfs for an UBI device.
  * @ubi: UBI device description object
@@ -427,6 +468,12 @@ int ubi_debugfs_init_dev(struct ubi_device *ubi)
 		goto out_remove;
 	d->dfs_emulate_io_failures = dent;
 
+	fname = "attach_stats";
+	dent = debugfs_create_file(fname, S_IRUSR, d->dfs_dir, (void *)ubi_num,
+				   &dfs_attach_stats_fops);
+	if (IS_ERR_OR_NULL(dent))
+		goto out_remove;
+
 	return 0;
 
 out_remove:
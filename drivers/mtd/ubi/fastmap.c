@@ -1063,8 +1063,11 @@ int ubi_scan_fastmap(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	}
 
 	ubi->fm = fm;
-	ubi->fm_pool.max_size = ubi->fm->max_pool_size;
-	ubi->fm_wl_pool.max_size = ubi->fm->max_wl_pool_size;
+	/* The pool sizes set by module parameters take precedence */
+	if (!ubi_fm_pool_size)
+		ubi->fm_pool.max_size = ubi->fm->max_pool_size;
+	if (!ubi_fm_wl_pool_size)
+		ubi->fm_wl_pool.max_size = ubi->fm->max_wl_pool_size;
 	ubi_msg("attached by fastmap");
 	ubi_msg("fastmap pool size: %d", ubi->fm_pool.max_size);
 	ubi_msg("fastmap WL pool size: %d", ubi->fm_wl_pool.max_size);
@@ -378,6 +378,29 @@ struct ubi_debug_info {
 	struct dentry *dfs_emulate_io_failures;
 };
 
+/**
+ * struct ubi_attach_stats - statistics of the last attach.
+ * @scanned_pebs: count of PEBs whose headers were read while attaching
+ * @scan_threads: count of threads reading PEB headers in parallel (%1 if the
+ *                headers were read by the attaching task itself)
+ * @fastmap_us: time spent looking for the fastmap and reading it
+ * @scan_us: time spent scanning all PEBs (zero if attached by fastmap)
+ * @vtbl_us: time spent reading the volume table
+ * @wl_us: time spent initializing the WL sub-system
+ * @eba_us: time spent initializing the EBA sub-system
+ * @total_us: total attach time
+ */
+struct ubi_attach_stats {
+	int scanned_pebs;
+	int scan_threads;
+	unsigned int fastmap_us;
+	unsigned int scan_us;
+	unsigned int vtbl_us;
+	unsigned int wl_us;
+	unsigned int eba_us;
+	unsigned int total_us;
+};
+
 /**
  * struct ubi_device - UBI device description structure
  * @dev: UBI device object to use the the Linux device model
@@ -486,6 +509,7 @@ struct ubi_debug_info {
  * @buf_mutex: protects @peb_buf
  * @ckvol_mutex: serializes static volume checking when opening
  *
+ * @attach_stats: statistics of the last attach
  * @dbg: debugging information for this UBI device
  */
 struct ubi_device {
@@ -582,6 +606,7 @@ struct ubi_device {
 	struct mutex buf_mutex;
 	struct mutex ckvol_mutex;
 
+	struct ubi_attach_stats attach_stats;
 	struct ubi_debug_info dbg;
 };
 
@@ -738,6 +763,10 @@ extern const struct file_operations ubi_vol_cdev_operations;
 extern struct class *ubi_class;
 extern struct mutex ubi_devices_mutex;
 extern struct blocking_notifier_head ubi_notifiers;
+#ifdef CONFIG_MTD_UBI_FASTMAP
+extern int ubi_fm_pool_size;
+extern int ubi_fm_wl_pool_size;
+#endif
 
 /* attach.c */
 int ubi_add_to_av(struct ubi_device *ubi, struct ubi_attach_info *ai, int pnum,
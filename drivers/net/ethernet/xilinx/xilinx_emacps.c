@@ -2200,6 +2200,22 @@ static void unwind_tx_frag_mapping(struct net_local *lp, int fragcnt)
 	}
 }
 
+/**
+ * xemacps_start_tx - kick the controller to send the queued descriptors
+ * @lp: local device instance pointer
+ */
+static void xemacps_start_tx(struct net_local *lp)
+{
+	unsigned long flags;
+	u32 regval;
+
+	spin_lock_irqsave(&lp->nwctrlreg_lock, flags);
+	regval = xemacps_read(lp->baseaddr, XEMACPS_NWCTRL_OFFSET);
+	xemacps_write(lp->baseaddr, XEMACPS_NWCTRL_OFFSET,
+			(regval | XEMACPS_NWCTRL_STARTTX_MASK));
+	spin_unlock_irqrestore(&lp->nwctrlreg_lock, flags);
+}
+
 /**
  * xemacps_start_xmit - transmit a packet (called by kernel)
  * @skb: socket buffer
@@ -2209,6 +2225,7 @@ static void unwind_tx_frag_mapping(struct net_local *lp, int fragcnt)
 static int xemacps_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 {
 	struct net_local *lp = netdev_priv(ndev);
+	struct netdev_queue *txq = netdev_get_tx_queue(ndev, 0);
 	dma_addr_t  mapping;
 	unsigned int nr_frags, len;
 	int i;
@@ -2216,16 +2233,19 @@ static int xemacps_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 	void       *virt_addr;
 	skb_frag_t *frag;
 	struct xemacps_bd *cur_p;
-	unsigned long flags;
 	u32 bd_tail;
 
 	nr_frags = skb_shinfo(skb)->nr_frags + 1;
 	if (nr_frags > lp->tx_bd_freecnt) {
 		netif_stop_queue(ndev); /* stop send queue */
+		/* start what earlier xmit_more packets left queued */
+		xemacps_start_tx(lp);
 		return NETDEV_TX_BUSY;
 	}
 
 	if (xemacps_clear_csum(skb, ndev)) {
+		if (!skb->xmit_more || netif_xmit_stopped(txq))
+			xemacps_start_tx(lp);
 		kfree(skb);
 		return NETDEV_TX_OK;
 	}
@@ -2288,16 +2308,17 @@ static int xemacps_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 	lp->tx_bd_freecnt -= nr_frags;
 	spin_unlock_bh(&lp->tx_lock);
 
-	spin_lock_irqsave(&lp->nwctrlreg_lock, flags);
-	regval = xemacps_read(lp->baseaddr, XEMACPS_NWCTRL_OFFSET);
-	xemacps_write(lp->baseaddr, XEMACPS_NWCTRL_OFFSET,
-			(regval | XEMACPS_NWCTRL_STARTTX_MASK));
-	spin_unlock_irqrestore(&lp->nwctrlreg_lock, flags);
+	/* with more packets on the way, start them all with the last one,
+	 * unless the queue was stopped and no more will come */
+	if (!skb->xmit_more || netif_xmit_stopped(txq))
+		xemacps_start_tx(lp);
 
 	ndev->trans_start = jiffies;
 	return 0;
 
 dma_err:
+	if (!skb->xmit_more || netif_xmit_stopped(txq))
+		xemacps_start_tx(lp);
 	kfree_skb(skb);
 	return NETDEV_TX_OK;
 }
@@ -42,6 +42,7 @@
 #include <linux/seq_file.h>
 #include <linux/compat.h>
 #include <linux/rculist.h>
+#include <net/busy_poll.h>
 
 /*
  * LOCKING:
@@ -103,6 +104,12 @@
 
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
 
+/* Number of NAPI contexts busy polled before sleeping */
+#define EP_NAPI_IDS 4
+
+/* busy_poll_usecs of an instance that has not been set with EPIOCSPARAMS */
+#define EP_BUSY_POLL_UNSET U32_MAX
+
 struct epoll_filefd {
 	struct file *file;
 	int fd;
@@ -219,6 +226,14 @@ struct eventpoll {
 	/* used to optimize loop detection check */
 	int visited;
 	struct list_head visited_list_link;
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	/* NAPI IDs of the sockets last seen ready, most recent first */
+	unsigned int napi_id[EP_NAPI_IDS];
+
+	/* busy poll time set by EPIOCSPARAMS, or EP_BUSY_POLL_UNSET */
+	u32 busy_poll_usecs;
+#endif
 };
 
 /* Wait structure used by the poll hooks */
@@ -379,6 +394,119 @@ static inline int ep_events_available(struct eventpoll *ep)
 	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
 }
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+static inline u32 ep_busy_poll_usecs(struct eventpoll *ep)
+{
+	u32 usecs = ACCESS_ONCE(ep->busy_poll_usecs);
+
+	return usecs != EP_BUSY_POLL_UNSET ? usecs :
+	       ACCESS_ONCE(sysctl_net_busy_poll);
+}
+
+/*
+ * Busy poll the NAPI contexts the ready sockets came in on until an event
+ * shows up, or the time is up or something else wants the CPU.
+ */
+static void ep_busy_loop(struct eventpoll *ep, int nonblock)
+{
+	u32 usecs = ep_busy_poll_usecs(ep);
+	unsigned long end_time;
+	unsigned int napi_id;
+	int i;
+
+	if (!usecs || !ACCESS_ONCE(ep->napi_id[0]))
+		return;
+
+	end_time = busy_loop_us_clock() + usecs;
+	do {
+		for (i = 0; i < EP_NAPI_IDS; i++) {
+			napi_id = ACCESS_ONCE(ep->napi_id[i]);
+			if (!napi_id)
+				break;
+			napi_id_busy_poll(napi_id);
+		}
+		cpu_relax();
+	} while (!nonblock && !ep_events_available(ep) && !need_resched() &&
+		 !signal_pending(current) && !busy_loop_timeout(end_time));
+}
+
+/*
+ * Remember the NAPI context of a socket that was added or found ready.
+ * Called with "mtx" held, ep_busy_loop() reads the IDs without it.
+ */
+static void ep_set_busy_poll_napi_id(struct epitem *epi)
+{
+	struct eventpoll *ep = epi->ep;
+	unsigned int napi_id;
+	struct socket *sock;
+	int err, i;
+
+	if (!ep_busy_poll_usecs(ep))
+		return;
+
+	sock = sock_from_file(epi->ffd.file, &err);
+	if (!sock || !sock->sk)
+		return;
+
+	napi_id = ACCESS_ONCE(sock->sk->sk_napi_id);
+	if (!napi_id || napi_id == ep->napi_id[0])
+		return;
+
+	for (i = 1; i < EP_NAPI_IDS - 1; i++)
+		if (ep->napi_id[i] == napi_id)
+			break;
+	for (; i > 0; i--)
+		ACCESS_ONCE(ep->napi_id[i]) = ep->napi_id[i - 1];
+	ACCESS_ONCE(ep->napi_id[0]) = napi_id;
+}
+
+static long ep_eventpoll_ioctl(struct file *file, unsigned int cmd,
+			       unsigned long arg)
+{
+	struct eventpoll *ep = file->private_data;
+	void __user *uarg = (void __user *)arg;
+	struct epoll_params params;
+
+	switch (cmd) {
+	case EPIOCSPARAMS:
+		if (copy_from_user(&params, uarg, sizeof(params)))
+			return -EFAULT;
+		if (params.__pad || params.busy_poll_usecs > INT_MAX)
+			return -EINVAL;
+		/* like SO_BUSY_POLL, unprivileged users may only decrease it */
+		if (params.busy_poll_usecs > ep_busy_poll_usecs(ep) &&
+		    !capable(CAP_NET_ADMIN))
+			return -EPERM;
+		ACCESS_ONCE(ep->busy_poll_usecs) = params.busy_poll_usecs;
+		return 0;
+	case EPIOCGPARAMS:
+		memset(&params, 0, sizeof(params));
+		params.busy_poll_usecs = ep_busy_poll_usecs(ep);
+		if (copy_to_user(uarg, &params, sizeof(params)))
+			return -EFAULT;
+		return 0;
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
+#ifdef CONFIG_COMPAT
+static long ep_eventpoll_compat_ioctl(struct file *file, unsigned int cmd,
+				      unsigned long arg)
+{
+	return ep_eventpoll_ioctl(file, cmd, (unsigned long)compat_ptr(arg));
+}
+#endif
+#else
+static inline void ep_busy_loop(struct eventpoll *ep, int nonblock)
+{
+}
+
+static inline void ep_set_busy_poll_napi_id(struct epitem *epi)
+{
+}
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 /**
  * ep_call_nested - Perform a bound (possibly) nested call, by checking
  *                  that the recursion limit is not exceeded, and that
@@ -900,6 +1028,12 @@ static const struct file_operations eventpoll_fops = {
 	.release	= ep_eventpoll_release,
 	.poll		= ep_eventpoll_poll,
 	.llseek		= noop_llseek,
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	.unlocked_ioctl	= ep_eventpoll_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl	= ep_eventpoll_compat_ioctl,
+#endif
+#endif
 };
 
 /*
@@ -955,6 +1089,9 @@ static int ep_alloc(struct eventpoll **pep)
 	ep->rbr = RB_ROOT;
 	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	ep->busy_poll_usecs = EP_BUSY_POLL_UNSET;
+#endif
 
 	*pep = ep;
 
@@ -1308,6 +1445,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	 * the new item.
 	 */
 	revents = ep_item_poll(epi, &epq.pt);
+	ep_set_busy_poll_napi_id(epi);
 
 	/*
 	 * We have to check if something went wrong during the poll wait queue
@@ -1507,6 +1645,8 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 		list_del_init(&epi->rdllink);
 
 		revents = ep_item_poll(epi, &pt);
+		if (revents)
+			ep_set_busy_poll_napi_id(epi);
 
 		/*
 		 * If the event mask intersect the caller-requested one,
@@ -1611,6 +1751,9 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 	}
 
 fetch_events:
+	if (!ep_events_available(ep))
+		ep_busy_loop(ep, timed_out);
+
 	spin_lock_irqsave(&ep->lock, flags);
 
 	if (!ep_events_available(ep)) {
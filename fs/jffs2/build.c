@@ -17,6 +17,7 @@
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/mtd/mtd.h>
+#include <linux/ktime.h>
 #include "nodelist.h"
 
 static void jffs2_build_remove_unlinked_inode(struct jffs2_sb_info *,
@@ -99,17 +100,20 @@ static int jffs2_build_filesystem(struct jffs2_sb_info *c)
 	struct jffs2_inode_cache *ic;
 	struct jffs2_full_dirent *fd;
 	struct jffs2_full_dirent *dead_fds = NULL;
+	ktime_t start, scanned, pass1, pass2, end;
 
 	dbg_fsbuild("build FS data structures\n");
 
 	/* First, scan the medium and build all the inode caches with
 	   lists of physical nodes */
 
+	start = ktime_get();
 	c->flags |= JFFS2_SB_FLAG_SCANNING;
 	ret = jffs2_scan_medium(c);
 	c->flags &= ~JFFS2_SB_FLAG_SCANNING;
 	if (ret)
 		goto exit;
+	scanned = ktime_get();
 
 	dbg_fsbuild("scanned flash completely\n");
 	jffs2_dbg_dump_block_lists_nolock(c);
@@ -125,6 +129,7 @@ static int jffs2_build_filesystem(struct jffs2_sb_info *c)
 	}
 
 	dbg_fsbuild("pass 1 complete\n");
+	pass1 = ktime_get();
 
 	/* Next, scan for inodes with nlink == 0 and remove them. If
 	   they were directories, then decrement the nlink of their
@@ -167,10 +172,17 @@ static int jffs2_build_filesystem(struct jffs2_sb_info *c)
 		ic->scan_dents = NULL;
 		cond_resched();
 	}
+	pass2 = ktime_get();
 	jffs2_build_xattr_subsystem(c);
 	c->flags &= ~JFFS2_SB_FLAG_BUILDING;
 
+	end = ktime_get();
+
 	dbg_fsbuild("FS build complete\n");
+	pr_info("%s: built in %lld us (scan %lld us, pass 1 %lld us, pass 2 %lld us, xattr %lld us)\n",
+		c->mtd->name, ktime_us_delta(end, start),
+		ktime_us_delta(scanned, start), ktime_us_delta(pass1, scanned),
+		ktime_us_delta(pass2, pass1), ktime_us_delta(end, pass2));
 
 	/* Rotate the lists by some number to ensure wear levelling */
 	jffs2_rotate_lists(c);
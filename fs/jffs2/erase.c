@@ -150,6 +150,8 @@ int jffs2_erase_pending_blocks(struct jffs2_sb_info *c, int count)
 			spin_unlock(&c->erase_completion_lock);
 			mutex_unlock(&c->erase_free_sem);
 
+			/* A summary kept for this block will no longer fit */
+			jffs2_sum_drop_pending(c, jeb);
 			jffs2_erase_block(c, jeb);
 
 		} else {
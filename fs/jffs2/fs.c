@@ -408,6 +408,8 @@ int jffs2_do_remount_fs(struct super_block *sb, int *flags, char *data)
 		mutex_lock(&c->alloc_sem);
 		jffs2_flush_wbuf_pad(c);
 		mutex_unlock(&c->alloc_sem);
+		if (*flags & MS_RDONLY)
+			jffs2_sum_write_pending(c);
 	}
 
 	if (!(*flags & MS_RDONLY))
@@ -91,7 +91,7 @@ static int file_dirty(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb)
 int jffs2_scan_medium(struct jffs2_sb_info *c)
 {
 	int i, ret;
-	uint32_t empty_blocks = 0, bad_blocks = 0;
+	uint32_t empty_blocks = 0, bad_blocks = 0, free_ofs;
 	unsigned char *flashbuf = NULL;
 	uint32_t buf_size = 0;
 	struct jffs2_summary *s = NULL; /* summary info collected by the scan process */
@@ -199,11 +199,14 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 					(!c->nextblock || c->nextblock->free_size < jeb->free_size)) {
 				/* Better candidate for the next writes to go to */
 				if (c->nextblock) {
+					/* file_dirty() zeroes free_size */
+					free_ofs = c->sector_size - c->nextblock->free_size;
 					ret = file_dirty(c, c->nextblock);
 					if (ret)
 						goto out;
-					/* deleting summary information of the old nextblock */
-					jffs2_sum_reset_collected(c->summary);
+					/* keep summary information of the old nextblock for unmount */
+					jffs2_sum_save_collected(c, c->nextblock, c->summary,
+								 free_ofs);
 				}
 				/* update collected summary information for the current nextblock */
 				jffs2_sum_move_collected(c, s);
@@ -211,9 +214,11 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 					  __func__, jeb->offset);
 				c->nextblock = jeb;
 			} else {
+				free_ofs = c->sector_size - jeb->free_size;
 				ret = file_dirty(c, jeb);
 				if (ret)
 					goto out;
+				jffs2_sum_save_collected(c, jeb, s, free_ofs);
 			}
 			break;
 
@@ -42,6 +42,8 @@ int jffs2_sum_init(struct jffs2_sb_info *c)
 		return -ENOMEM;
 	}
 
+	INIT_LIST_HEAD(&c->summary->pending);
+
 	dbg_summary("returned successfully\n");
 
 	return 0;
@@ -49,10 +51,15 @@ int jffs2_sum_init(struct jffs2_sb_info *c)
 
 void jffs2_sum_exit(struct jffs2_sb_info *c)
 {
+	struct jffs2_sum_pending *p, *next;
+
 	dbg_summary("called\n");
 
 	jffs2_sum_disable_collecting(c->summary);
 
+	list_for_each_entry_safe(p, next, &c->summary->pending, list)
+		kfree(p);
+
 	kfree(c->summary->sum_buf);
 	c->summary->sum_buf = NULL;
 
@@ -669,54 +676,14 @@ crc_err:
 	return 0;
 }
 
-/* Write summary data to flash - helper function for jffs2_sum_write_sumnode() */
+/* Copy the collected summary records to wpage, freeing them; returns the end of the copy */
 
-static int jffs2_sum_write_data(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
-				uint32_t infosize, uint32_t datasize, int padsize)
+static void *jffs2_sum_copy_records(struct jffs2_summary *s, void *wpage)
 {
-	struct jffs2_raw_summary isum;
 	union jffs2_sum_mem *temp;
-	struct jffs2_sum_marker *sm;
-	struct kvec vecs[2];
-	uint32_t sum_ofs;
-	void *wpage;
-	int ret;
-	size_t retlen;
 
-	if (padsize + datasize > MAX_SUMMARY_SIZE) {
-		/* It won't fit in the buffer. Abort summary for this jeb */
-		jffs2_sum_disable_collecting(c->summary);
-
-		JFFS2_WARNING("Summary too big (%d data, %d pad) in eraseblock at %08x\n",
-			      datasize, padsize, jeb->offset);
-		/* Non-fatal */
-		return 0;
-	}
-	/* Is there enough space for summary? */
-	if (padsize < 0) {
-		/* don't try to write out summary for this jeb */
-		jffs2_sum_disable_collecting(c->summary);
-
-		JFFS2_WARNING("Not enough space for summary, padsize = %d\n",
-			      padsize);
-		/* Non-fatal */
-		return 0;
-	}
-
-	memset(c->summary->sum_buf, 0xff, datasize);
-	memset(&isum, 0, sizeof(isum));
-
-	isum.magic = cpu_to_je16(JFFS2_MAGIC_BITMASK);
-	isum.nodetype = cpu_to_je16(JFFS2_NODETYPE_SUMMARY);
-	isum.totlen = cpu_to_je32(infosize);
-	isum.hdr_crc = cpu_to_je32(crc32(0, &isum, sizeof(struct jffs2_unknown_node) - 4));
-	isum.padded = cpu_to_je32(c->summary->sum_padded);
-	isum.cln_mkr = cpu_to_je32(c->cleanmarker_size);
-	isum.sum_num = cpu_to_je32(c->summary->sum_num);
-	wpage = c->summary->sum_buf;
-
-	while (c->summary->sum_num) {
-		temp = c->summary->sum_list_head;
+	while (s->sum_num) {
+		temp = s->sum_list_head;
 
 		switch (je16_to_cpu(temp->u.nodetype)) {
 			case JFFS2_NODETYPE_INODE: {
@@ -756,7 +723,7 @@ static int jffs2_sum_write_data(struct jffs2_sb_info *c, struct jffs2_eraseblock
 			case JFFS2_NODETYPE_XATTR: {
 				struct jffs2_sum_xattr_flash *sxattr_ptr = wpage;
 
-				temp = c->summary->sum_list_head;
+				temp = s->sum_list_head;
 				sxattr_ptr->nodetype = temp->x.nodetype;
 				sxattr_ptr->xid = temp->x.xid;
 				sxattr_ptr->version = temp->x.version;
@@ -769,7 +736,7 @@ static int jffs2_sum_write_data(struct jffs2_sb_info *c, struct jffs2_eraseblock
 			case JFFS2_NODETYPE_XREF: {
 				struct jffs2_sum_xref_flash *sxref_ptr = wpage;
 
-				temp = c->summary->sum_list_head;
+				temp = s->sum_list_head;
 				sxref_ptr->nodetype = temp->r.nodetype;
 				sxref_ptr->offset = temp->r.offset;
 
@@ -782,19 +749,67 @@ static int jffs2_sum_write_data(struct jffs2_sb_info *c, struct jffs2_eraseblock
 				    == JFFS2_FEATURE_RWCOMPAT_COPY) {
 					dbg_summary("Writing unknown RWCOMPAT_COPY node type %x\n",
 						    je16_to_cpu(temp->u.nodetype));
-					jffs2_sum_disable_collecting(c->summary);
+					jffs2_sum_disable_collecting(s);
 				} else {
 					BUG();	/* unknown node in summary information */
 				}
 			}
 		}
 
-		c->summary->sum_list_head = temp->u.next;
+		s->sum_list_head = temp->u.next;
 		kfree(temp);
 
-		c->summary->sum_num--;
+		s->sum_num--;
 	}
 
+	return wpage;
+}
+
+/* Write summary data to flash - helper function for jffs2_sum_write_sumnode() */
+
+static int jffs2_sum_write_data(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
+				uint32_t infosize, uint32_t datasize, int padsize)
+{
+	struct jffs2_raw_summary isum;
+	struct jffs2_sum_marker *sm;
+	struct kvec vecs[2];
+	uint32_t sum_ofs;
+	void *wpage;
+	int ret;
+	size_t retlen;
+
+	if (padsize + datasize > MAX_SUMMARY_SIZE) {
+		/* It won't fit in the buffer. Abort summary for this jeb */
+		jffs2_sum_disable_collecting(c->summary);
+
+		JFFS2_WARNING("Summary too big (%d data, %d pad) in eraseblock at %08x\n",
+			      datasize, padsize, jeb->offset);
+		/* Non-fatal */
+		return 0;
+	}
+	/* Is there enough space for summary? */
+	if (padsize < 0) {
+		/* don't try to write out summary for this jeb */
+		jffs2_sum_disable_collecting(c->summary);
+
+		JFFS2_WARNING("Not enough space for summary, padsize = %d\n",
+			      padsize);
+		/* Non-fatal */
+		return 0;
+	}
+
+	memset(c->summary->sum_buf, 0xff, datasize);
+	memset(&isum, 0, sizeof(isum));
+
+	isum.magic = cpu_to_je16(JFFS2_MAGIC_BITMASK);
+	isum.nodetype = cpu_to_je16(JFFS2_NODETYPE_SUMMARY);
+	isum.totlen = cpu_to_je32(infosize);
+	isum.hdr_crc = cpu_to_je32(crc32(0, &isum, sizeof(struct jffs2_unknown_node) - 4));
+	isum.padded = cpu_to_je32(c->summary->sum_padded);
+	isum.cln_mkr = cpu_to_je32(c->cleanmarker_size);
+	isum.sum_num = cpu_to_je32(c->summary->sum_num);
+	wpage = jffs2_sum_copy_records(c->summary, c->summary->sum_buf);
+
 	jffs2_sum_reset_collected(c->summary);
 
 	wpage += padsize;
@@ -871,3 +886,171 @@ int jffs2_sum_write_sumnode(struct jffs2_sb_info *c)
 	spin_lock(&c->erase_completion_lock);
 	return ret;
 }
+
+/*
+ * Blocks written without summary (e.g. by an older kernel or from an image
+ * made without sumtool) have to be scanned in full at every mount. When such
+ * a block ends up on the dirty list, its free space is never written to
+ * again until it is erased, so the summary collected while scanning it can be
+ * written into that space later on. This is done when the filesystem is
+ * unmounted or remounted read-only, and the next mount reads the summary
+ * instead of the whole block. Only done on flash without a write buffer,
+ * where the tail of a block can be programmed on its own.
+ */
+
+/* Keep the summary collected by the scan of a dirty block - called from scan.c */
+
+void jffs2_sum_save_collected(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
+			      struct jffs2_summary *s, uint32_t free_ofs)
+{
+	struct jffs2_raw_node_ref *ref;
+	struct jffs2_sum_pending *p;
+	uint32_t nodes = 0, cln_mkr = 0;
+
+	if (jffs2_is_writebuffered(c) || jffs2_sum_is_disabled(s) || !s->sum_num)
+		goto out;
+
+	/* The summary has to fit in the free space behind the last node */
+	if (free_ofs + PAD(JFFS2_SUMMARY_FRAME_SIZE + s->sum_size) > c->sector_size)
+		goto out;
+
+	/* Any node the scan failed to record (-ENOMEM) would be lost */
+	for (ref = jeb->first_node; ref; ref = ref_next(ref)) {
+		if (ref_obsolete(ref))
+			continue;
+		if (ref->next_in_ino)
+			nodes++;
+		else if (ref == jeb->first_node && ref_offset(ref) == jeb->offset)
+			cln_mkr = c->cleanmarker_size;
+	}
+	if (nodes != s->sum_num) {
+		dbg_summary("%u nodes but %u summary entries in jeb at 0x%08x\n",
+			    nodes, s->sum_num, jeb->offset);
+		goto out;
+	}
+
+	p = kmalloc(sizeof(*p) + s->sum_size, GFP_KERNEL);
+	if (!p)
+		goto out;
+
+	p->jeb = jeb;
+	p->sum_num = s->sum_num;
+	p->sum_padded = s->sum_padded;
+	p->cln_mkr = cln_mkr;
+	p->free_ofs = free_ofs;
+	p->size = jffs2_sum_copy_records(s, p->data) - (void *)p->data;
+
+	spin_lock(&c->erase_completion_lock);
+	list_add_tail(&p->list, &c->summary->pending);
+	spin_unlock(&c->erase_completion_lock);
+
+	dbg_summary("summary of jeb at 0x%08x (%u bytes) kept\n",
+		    jeb->offset, p->size);
+out:
+	jffs2_sum_reset_collected(s);
+}
+
+/* Forget the kept summary of a block which is about to be erased - called from erase.c */
+
+void jffs2_sum_drop_pending(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb)
+{
+	struct jffs2_sum_pending *p, *next;
+
+	spin_lock(&c->erase_completion_lock);
+	list_for_each_entry_safe(p, next, &c->summary->pending, list) {
+		if (p->jeb == jeb) {
+			list_del(&p->list);
+			kfree(p);
+			break;
+		}
+	}
+	spin_unlock(&c->erase_completion_lock);
+}
+
+static int jffs2_sum_write_pending_jeb(struct jffs2_sb_info *c, struct jffs2_sum_pending *p)
+{
+	struct jffs2_raw_summary *isum;
+	struct jffs2_sum_marker *sm;
+	uint32_t sumsize, sum_ofs;
+	size_t retlen;
+	int ret;
+
+	/* Like jffs2_sum_write_data(), but at the very end of the block */
+	sumsize = PAD(JFFS2_SUMMARY_FRAME_SIZE + p->size);
+	sum_ofs = c->sector_size - sumsize;
+
+	/*
+	 * Node data may legitimately end in 0xff bytes, so the check below
+	 * alone could overwrite the last node: stay behind the free offset.
+	 */
+	if (sum_ofs < p->free_ofs) {
+		dbg_summary("summary would overlap nodes in jeb at 0x%08x\n",
+			    p->jeb->offset);
+		return -ENOSPC;
+	}
+
+	isum = kmalloc(sumsize, GFP_KERNEL);
+	if (!isum)
+		return -ENOMEM;
+
+	/* Make sure nothing was written there since the scan */
+	ret = jffs2_flash_read(c, p->jeb->offset + sum_ofs, sumsize, &retlen,
+			       (unsigned char *)isum);
+	if (ret || retlen != sumsize || memchr_inv(isum, 0xff, sumsize)) {
+		dbg_summary("no room for summary in jeb at 0x%08x\n", p->jeb->offset);
+		ret = -EIO;
+		goto out;
+	}
+
+	isum->magic = cpu_to_je16(JFFS2_MAGIC_BITMASK);
+	isum->nodetype = cpu_to_je16(JFFS2_NODETYPE_SUMMARY);
+	isum->totlen = cpu_to_je32(sumsize);
+	isum->hdr_crc = cpu_to_je32(crc32(0, isum, sizeof(struct jffs2_unknown_node) - 4));
+	isum->sum_num = cpu_to_je32(p->sum_num);
+	isum->cln_mkr = cpu_to_je32(p->cln_mkr);
+	isum->padded = cpu_to_je32(p->sum_padded);
+	memcpy(isum->sum, p->data, p->size);
+
+	sm = (void *)isum + sumsize - sizeof(*sm);
+	sm->offset = cpu_to_je32(sum_ofs);
+	sm->magic = cpu_to_je32(JFFS2_SUM_MAGIC);
+
+	isum->sum_crc = cpu_to_je32(crc32(0, isum->sum, sumsize - sizeof(*isum)));
+	isum->node_crc = cpu_to_je32(crc32(0, isum, sizeof(*isum) - 8));
+
+	ret = jffs2_flash_write(c, p->jeb->offset + sum_ofs, sumsize, &retlen,
+				(unsigned char *)isum);
+	if (!ret && retlen != sumsize)
+		ret = -EIO;
+	if (ret)
+		JFFS2_WARNING("Write of %u bytes at 0x%08x failed. returned %d, retlen %zd\n",
+			      sumsize, p->jeb->offset + sum_ofs, ret, retlen);
+out:
+	kfree(isum);
+	return ret;
+}
+
+/* Write out the kept summaries - called on unmount and read-only remount */
+
+void jffs2_sum_write_pending(struct jffs2_sb_info *c)
+{
+	struct jffs2_sum_pending *p, *next;
+	LIST_HEAD(pending);
+	int written = 0, failed = 0;
+
+	spin_lock(&c->erase_completion_lock);
+	list_splice_init(&c->summary->pending, &pending);
+	spin_unlock(&c->erase_completion_lock);
+
+	list_for_each_entry_safe(p, next, &pending, list) {
+		if (jffs2_sum_write_pending_jeb(c, p))
+			failed++;
+		else
+			written++;
+		kfree(p);
+	}
+
+	if (written || failed)
+		pr_info("wrote summary to %d eraseblocks (%d failed)\n",
+			written, failed);
+}
@@ -157,6 +157,22 @@ struct jffs2_summary
 	union jffs2_sum_mem *sum_list_tail;
 
 	jint32_t *sum_buf;	/* buffer for writing out summary */
+
+	struct list_head pending;	/* summaries to write to blocks without one */
+};
+
+/* Summary of a block scanned in full, to be written to its end on unmount */
+
+struct jffs2_sum_pending
+{
+	struct list_head list;
+	struct jffs2_eraseblock *jeb;
+	uint32_t sum_num;
+	uint32_t sum_padded;
+	uint32_t cln_mkr;
+	uint32_t free_ofs;	/* start of the free space found by the scan */
+	uint32_t size;		/* of the records in data[] */
+	unsigned char data[0];
 };
 
 /* Summary marker is stored at the end of every sumarized erase block */
@@ -186,6 +202,10 @@ int jffs2_sum_add_inode_mem(struct jffs2_summary *s, struct jffs2_raw_inode *ri,
 int jffs2_sum_add_dirent_mem(struct jffs2_summary *s, struct jffs2_raw_dirent *rd, uint32_t ofs);
 int jffs2_sum_add_xattr_mem(struct jffs2_summary *s, struct jffs2_raw_xattr *rx, uint32_t ofs);
 int jffs2_sum_add_xref_mem(struct jffs2_summary *s, struct jffs2_raw_xref *rr, uint32_t ofs);
+void jffs2_sum_save_collected(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
+			      struct jffs2_summary *s, uint32_t free_ofs);
+void jffs2_sum_drop_pending(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb);
+void jffs2_sum_write_pending(struct jffs2_sb_info *c);
 int jffs2_sum_scan_sumnode(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
 			   struct jffs2_raw_summary *summary, uint32_t sumlen,
 			   uint32_t *pseudo_random);
@@ -206,6 +226,9 @@ int jffs2_sum_scan_sumnode(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb
 #define jffs2_sum_add_dirent_mem(a,b,c)
 #define jffs2_sum_add_xattr_mem(a,b,c)
 #define jffs2_sum_add_xref_mem(a,b,c)
+#define jffs2_sum_save_collected(a,b,c,d)
+#define jffs2_sum_drop_pending(a,b)
+#define jffs2_sum_write_pending(a)
 #define jffs2_sum_scan_sumnode(a,b,c,d,e) (0)
 
 #endif /* CONFIG_JFFS2_SUMMARY */
@@ -327,6 +327,8 @@ static void jffs2_put_super (struct super_block *sb)
 	jffs2_flush_wbuf_pad(c);
 	mutex_unlock(&c->alloc_sem);
 
+	if (!(sb->s_flags & MS_RDONLY))
+		jffs2_sum_write_pending(c);
 	jffs2_sum_exit(c);
 
 	jffs2_free_ino_caches(c);
@@ -24,6 +24,9 @@
 #include <linux/debugfs.h>
 #include <linux/err.h>
 #include <linux/cache.h>
+#include <linux/sched.h>
+#include <linux/syscore_ops.h>
+#include <linux/workqueue.h>
 #include <asm/barrier.h>
 #include "internal.h"
 
@@ -42,6 +45,7 @@ static void notrace pstore_ftrace_call(unsigned long ip,
 
 	rec.ip = ip;
 	rec.parent_ip = parent_ip;
+	rec.ts = local_clock();
 	pstore_ftrace_encode_cpu(&rec, raw_smp_processor_id());
 	psinfo->write_buf(PSTORE_TYPE_FTRACE, 0, NULL, 0, (void *)&rec,
 			  0, sizeof(rec), psinfo);
@@ -56,6 +60,66 @@ static struct ftrace_ops pstore_ftrace_ops __read_mostly = {
 static DEFINE_MUTEX(pstore_ftrace_lock);
 static bool pstore_ftrace_enabled;
 
+/*
+ * Seconds of trace kept on each side of a suspend: recording stops this
+ * long after the following launch, so that the launch is not overwritten,
+ * and the pstore file starts this long before the suspend.
+ */
+unsigned int pstore_ftrace_launch_secs = 5;
+
+static void pstore_ftrace_stop(struct work_struct *work)
+{
+	mutex_lock(&pstore_ftrace_lock);
+	if (pstore_ftrace_enabled &&
+	    !unregister_ftrace_function(&pstore_ftrace_ops)) {
+		pstore_ftrace_enabled = false;
+		pr_info("pstore: ftrace recording stopped %u s after launch\n",
+			pstore_ftrace_launch_secs);
+	}
+	mutex_unlock(&pstore_ftrace_lock);
+}
+
+static DECLARE_DELAYED_WORK(pstore_ftrace_stop_work, pstore_ftrace_stop);
+
+static void pstore_ftrace_mark(unsigned long marker)
+{
+	struct pstore_ftrace_record rec = {};
+
+	rec.parent_ip = marker;
+	rec.ts = local_clock();
+	pstore_ftrace_encode_cpu(&rec, raw_smp_processor_id());
+	psinfo->write_buf(PSTORE_TYPE_FTRACE, 0, NULL, 0, (void *)&rec,
+			  0, sizeof(rec), psinfo);
+}
+
+/*
+ * Syscore callbacks run on the last CPU up with interrupts off, right
+ * before the system powers down into suspend and right after it comes
+ * back, so the markers bracket the time the trace was not running.
+ */
+static int pstore_ftrace_suspend(void)
+{
+	if (pstore_ftrace_enabled)
+		pstore_ftrace_mark(PSTORE_FTRACE_SUSPEND);
+	return 0;
+}
+
+static void pstore_ftrace_resume(void)
+{
+	if (!pstore_ftrace_enabled)
+		return;
+
+	pstore_ftrace_mark(PSTORE_FTRACE_LAUNCH);
+	if (pstore_ftrace_launch_secs)
+		schedule_delayed_work(&pstore_ftrace_stop_work,
+				      pstore_ftrace_launch_secs * HZ);
+}
+
+static struct syscore_ops pstore_ftrace_syscore_ops = {
+	.suspend	= pstore_ftrace_suspend,
+	.resume		= pstore_ftrace_resume,
+};
+
 static ssize_t pstore_ftrace_knob_write(struct file *f, const char __user *buf,
 					size_t count, loff_t *ppos)
 {
@@ -66,6 +130,10 @@ static ssize_t pstore_ftrace_knob_write(struct file *f, const char __user *buf,
 	if (ret)
 		return ret;
 
+	/* turning recording on again cancels a pending launch stop */
+	if (on)
+		cancel_delayed_work_sync(&pstore_ftrace_stop_work);
+
 	mutex_lock(&pstore_ftrace_lock);
 
 	if (!on ^ pstore_ftrace_enabled)
@@ -125,6 +193,10 @@ void pstore_register_ftrace(void)
 		goto err_file;
 	}
 
+	debugfs_create_u32("launch_secs", 0600, dir,
+			   &pstore_ftrace_launch_secs);
+	register_syscore_ops(&pstore_ftrace_syscore_ops);
+
 	return;
 err_file:
 	debugfs_remove(dir);
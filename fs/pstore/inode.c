@@ -36,6 +36,7 @@
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/uaccess.h>
+#include <linux/math64.h>
 
 #include "internal.h"
 
@@ -51,6 +52,7 @@ struct pstore_private {
 	u64	id;
 	int	count;
 	ssize_t	size;
+	size_t	start;		/* first ftrace record shown */
 	char	data[];
 };
 
@@ -71,7 +73,7 @@ static void *pstore_ftrace_seq_start(struct seq_file *s, loff_t *pos)
 	if (!data)
 		return NULL;
 
-	data->off = ps->size % REC_SIZE;
+	data->off = ps->start;
 	data->off += *pos * REC_SIZE;
 	if (data->off + REC_SIZE > ps->size) {
 		kfree(data);
@@ -104,15 +106,65 @@ static int pstore_ftrace_seq_show(struct seq_file *s, void *v)
 {
 	struct pstore_private *ps = s->private;
 	struct pstore_ftrace_seq_data *data = v;
-	struct pstore_ftrace_record *rec = (void *)(ps->data + data->off);
+	struct pstore_ftrace_record rec;
+	unsigned long rem_nsec;
+	u64 ts;
+
+	/* records need not be aligned */
+	memcpy(&rec, ps->data + data->off, REC_SIZE);
+	ts = rec.ts;
+	rem_nsec = do_div(ts, NSEC_PER_SEC);
+
+	if (!pstore_ftrace_decode_ip(&rec)) {
+		seq_printf(s, "%d [%5lu.%06lu] ---- %s ----\n",
+			pstore_ftrace_decode_cpu(&rec), (unsigned long)ts,
+			rem_nsec / 1000,
+			rec.parent_ip == PSTORE_FTRACE_SUSPEND ?
+				"suspend" : "launch");
+		return 0;
+	}
 
-	seq_printf(s, "%d %08lx  %08lx  %pf <- %pF\n",
-		pstore_ftrace_decode_cpu(rec), rec->ip, rec->parent_ip,
-		(void *)rec->ip, (void *)rec->parent_ip);
+	seq_printf(s, "%d [%5lu.%06lu] %08lx  %08lx  %pf <- %pF\n",
+		pstore_ftrace_decode_cpu(&rec), (unsigned long)ts,
+		rem_nsec / 1000, rec.ip, rec.parent_ip,
+		(void *)rec.ip, (void *)rec.parent_ip);
 
 	return 0;
 }
 
+/*
+ * Records are in time order. If the trace holds a suspend, it is shown
+ * from pstore_ftrace_launch_secs before the last one on, which together
+ * with recording stopping as long after the launch gives the window
+ * around it.
+ */
+static size_t pstore_ftrace_first(const char *data, size_t size)
+{
+	u64 window = (u64)pstore_ftrace_launch_secs * NSEC_PER_SEC;
+	size_t first = size % REC_SIZE, off;
+	struct pstore_ftrace_record rec;
+	bool found = false;
+	u64 suspend = 0;
+
+	if (!window)
+		return first;
+
+	for (off = size - REC_SIZE; off >= first && off < size;
+	     off -= REC_SIZE) {
+		memcpy(&rec, data + off, REC_SIZE);
+		if (!found) {
+			found = !pstore_ftrace_decode_ip(&rec) &&
+				rec.parent_ip == PSTORE_FTRACE_SUSPEND;
+			suspend = rec.ts;
+			continue;
+		}
+		if (rec.ts + window < suspend)
+			return off + REC_SIZE;
+	}
+
+	return first;
+}
+
 static const struct seq_operations pstore_ftrace_seq_ops = {
 	.start	= pstore_ftrace_seq_start,
 	.next	= pstore_ftrace_seq_next,
@@ -313,6 +365,9 @@ int pstore_mkfile(enum pstore_type_id type, char *psname, u64 id, int count,
 	private->id = id;
 	private->count = count;
 	private->psi = psi;
+	private->start = 0;
+	if (type == PSTORE_TYPE_FTRACE)
+		private->start = pstore_ftrace_first(data, size);
 
 	switch (type) {
 	case PSTORE_TYPE_DMESG:
@@ -17,8 +17,16 @@ struct pstore_ftrace_record {
 #ifndef PSTORE_CPU_IN_IP
 	unsigned int cpu;
 #endif
+	u64 ts;			/* local_clock() */
 };
 
+/*
+ * Records with a zero ip mark a system sleep transition, the parent_ip
+ * says which one.
+ */
+#define PSTORE_FTRACE_SUSPEND	1
+#define PSTORE_FTRACE_LAUNCH	2
+
 static inline void
 pstore_ftrace_encode_cpu(struct pstore_ftrace_record *rec, unsigned int cpu)
 {
@@ -39,9 +47,21 @@ pstore_ftrace_decode_cpu(struct pstore_ftrace_record *rec)
 #endif
 }
 
+static inline unsigned long
+pstore_ftrace_decode_ip(struct pstore_ftrace_record *rec)
+{
+#ifndef PSTORE_CPU_IN_IP
+	return rec->ip;
+#else
+	return rec->ip & ~(unsigned long)PSTORE_CPU_IN_IP;
+#endif
+}
+
 #ifdef CONFIG_PSTORE_FTRACE
+extern unsigned int pstore_ftrace_launch_secs;
 extern void pstore_register_ftrace(void);
 #else
+#define pstore_ftrace_launch_secs 0
 static inline void pstore_register_ftrace(void) {}
 #endif
 
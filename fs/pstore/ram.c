@@ -34,6 +34,8 @@
 #include <linux/slab.h>
 #include <linux/compiler.h>
 #include <linux/pstore_ram.h>
+#include <asm/unaligned.h>
+#include "internal.h"
 
 #define RAMOOPS_KERNMSG_HDR "===="
 #define MIN_MEM_SIZE 4096UL
@@ -76,7 +78,7 @@ MODULE_PARM_DESC(ramoops_ecc,
 struct ramoops_context {
 	struct persistent_ram_zone **przs;
 	struct persistent_ram_zone *cprz;
-	struct persistent_ram_zone *fprz;
+	struct persistent_ram_zone **fprzs;	/* one per CPU */
 	phys_addr_t phys_addr;
 	unsigned long size;
 	size_t record_size;
@@ -85,6 +87,7 @@ struct ramoops_context {
 	int dump_oops;
 	struct persistent_ram_ecc_info ecc_info;
 	unsigned int max_dump_cnt;
+	unsigned int max_ftrace_cnt;
 	unsigned int dump_write_cnt;
 	/* _read_cnt need clear on ramoops_pstore_open */
 	unsigned int dump_read_cnt;
@@ -156,6 +159,61 @@ static void ramoops_read_kmsg_hdr(char *buffer, struct timespec *time,
 	}
 }
 
+#define FTRACE_REC_SIZE	sizeof(struct pstore_ftrace_record)
+
+/*
+ * Merge the records of the per-CPU ftrace zones into a single trace in
+ * time order. Each zone starts with a partial record if it wrapped.
+ */
+static ssize_t ramoops_ftrace_combine(struct ramoops_context *cxt, char **buf)
+{
+	struct persistent_ram_zone *prz;
+	struct pstore_ftrace_record *rec;
+	size_t *off, total = 0, len;
+	int i, best;
+	u64 ts = 0;
+
+	off = kcalloc(cxt->max_ftrace_cnt, sizeof(*off), GFP_KERNEL);
+	if (!off)
+		return -ENOMEM;
+
+	for (i = 0; i < cxt->max_ftrace_cnt; i++) {
+		prz = cxt->fprzs[i];
+		if (!prz)
+			continue;
+		off[i] = persistent_ram_old_size(prz) % FTRACE_REC_SIZE;
+		total += persistent_ram_old_size(prz) - off[i];
+	}
+
+	*buf = NULL;
+	if (total)
+		*buf = kmalloc(total, GFP_KERNEL);
+	if (!*buf) {
+		kfree(off);
+		return total ? -ENOMEM : 0;
+	}
+
+	for (len = 0; len < total; len += FTRACE_REC_SIZE) {
+		best = -1;
+		for (i = 0; i < cxt->max_ftrace_cnt; i++) {
+			prz = cxt->fprzs[i];
+			if (!prz || off[i] >= persistent_ram_old_size(prz))
+				continue;
+			rec = persistent_ram_old(prz) + off[i];
+			if (best < 0 || get_unaligned(&rec->ts) < ts) {
+				ts = get_unaligned(&rec->ts);
+				best = i;
+			}
+		}
+		memcpy(*buf + len, persistent_ram_old(cxt->fprzs[best]) +
+		       off[best], FTRACE_REC_SIZE);
+		off[best] += FTRACE_REC_SIZE;
+	}
+
+	kfree(off);
+	return total;
+}
+
 static ssize_t ramoops_pstore_read(u64 *id, enum pstore_type_id *type,
 				   int *count, struct timespec *time,
 				   char **buf, bool *compressed,
@@ -172,9 +230,15 @@ static ssize_t ramoops_pstore_read(u64 *id, enum pstore_type_id *type,
 	if (!prz)
 		prz = ramoops_get_next_prz(&cxt->cprz, &cxt->console_read_cnt,
 					   1, id, type, PSTORE_TYPE_CONSOLE, 0);
-	if (!prz)
-		prz = ramoops_get_next_prz(&cxt->fprz, &cxt->ftrace_read_cnt,
-					   1, id, type, PSTORE_TYPE_FTRACE, 0);
+	if (!prz && cxt->fprzs && !cxt->ftrace_read_cnt++) {
+		size = ramoops_ftrace_combine(cxt, buf);
+		if (size) {
+			*type = PSTORE_TYPE_FTRACE;
+			*id = 0;
+			*compressed = false;
+			return size;
+		}
+	}
 	if (!prz)
 		return 0;
 
@@ -234,9 +298,16 @@ static int notrace ramoops_pstore_write_buf(enum pstore_type_id type,
 		persistent_ram_write(cxt->cprz, buf, size);
 		return 0;
 	} else if (type == PSTORE_TYPE_FTRACE) {
-		if (!cxt->fprz)
+		int zonenum;
+
+		if (!cxt->fprzs)
+			return -ENOMEM;
+		zonenum = pstore_ftrace_decode_cpu(
+				(struct pstore_ftrace_record *)buf);
+		prz = cxt->fprzs[zonenum % cxt->max_ftrace_cnt];
+		if (!prz)
 			return -ENOMEM;
-		persistent_ram_write(cxt->fprz, buf, size);
+		persistent_ram_write(prz, buf, size);
 		return 0;
 	}
 
@@ -282,6 +353,7 @@ static int ramoops_pstore_erase(enum pstore_type_id type, u64 id, int count,
 {
 	struct ramoops_context *cxt = psi->data;
 	struct persistent_ram_zone *prz;
+	int i;
 
 	switch (type) {
 	case PSTORE_TYPE_DMESG:
@@ -293,8 +365,13 @@ static int ramoops_pstore_erase(enum pstore_type_id type, u64 id, int count,
 		prz = cxt->cprz;
 		break;
 	case PSTORE_TYPE_FTRACE:
-		prz = cxt->fprz;
-		break;
+		for (i = 0; i < cxt->max_ftrace_cnt; i++) {
+			if (!cxt->fprzs[i])
+				continue;
+			persistent_ram_free_old(cxt->fprzs[i]);
+			persistent_ram_zap(cxt->fprzs[i]);
+		}
+		return 0;
 	default:
 		return -EINVAL;
 	}
@@ -404,6 +481,63 @@ static int ramoops_init_prz(struct device *dev, struct ramoops_context *cxt,
 	return 0;
 }
 
+static void ramoops_free_ftrace_przs(struct ramoops_context *cxt)
+{
+	int i;
+
+	if (!cxt->fprzs)
+		return;
+
+	for (i = 0; i < cxt->max_ftrace_cnt; i++)
+		if (!IS_ERR_OR_NULL(cxt->fprzs[i]))
+			persistent_ram_free(cxt->fprzs[i]);
+	kfree(cxt->fprzs);
+	cxt->fprzs = NULL;
+	cxt->max_ftrace_cnt = 0;
+}
+
+/*
+ * The ftrace area is split into one zone per CPU, so that a busy CPU does
+ * not push the others' history out and the CPUs do not interleave their
+ * records.  An area too small to split is used as a single zone.
+ */
+static int ramoops_init_ftrace_przs(struct device *dev,
+				    struct ramoops_context *cxt,
+				    phys_addr_t *paddr)
+{
+	size_t sz;
+	int i, err;
+
+	if (!cxt->ftrace_size)
+		return 0;
+
+	cxt->max_ftrace_cnt = nr_cpu_ids;
+	sz = cxt->ftrace_size / cxt->max_ftrace_cnt;
+	if (!sz) {
+		cxt->max_ftrace_cnt = 1;
+		sz = cxt->ftrace_size;
+	}
+
+	cxt->fprzs = kcalloc(cxt->max_ftrace_cnt, sizeof(*cxt->fprzs),
+			     GFP_KERNEL);
+	if (!cxt->fprzs)
+		return -ENOMEM;
+
+	for (i = 0; i < cxt->max_ftrace_cnt; i++) {
+		err = ramoops_init_prz(dev, cxt, &cxt->fprzs[i], paddr, sz,
+				       LINUX_VERSION_CODE);
+		if (err) {
+			ramoops_free_ftrace_przs(cxt);
+			return err;
+		}
+	}
+
+	/* account for the rounding */
+	*paddr += cxt->ftrace_size - sz * cxt->max_ftrace_cnt;
+
+	return 0;
+}
+
 static int ramoops_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
@@ -453,12 +587,11 @@ static int ramoops_probe(struct platform_device *pdev)
 	if (err)
 		goto fail_init_cprz;
 
-	err = ramoops_init_prz(dev, cxt, &cxt->fprz, &paddr, cxt->ftrace_size,
-			       LINUX_VERSION_CODE);
+	err = ramoops_init_ftrace_przs(dev, cxt, &paddr);
 	if (err)
 		goto fail_init_fprz;
 
-	if (!cxt->przs && !cxt->cprz && !cxt->fprz) {
+	if (!cxt->przs && !cxt->cprz && !cxt->fprzs) {
 		pr_err("memory size too small, minimum is %zu\n",
 			cxt->console_size + cxt->record_size +
 			cxt->ftrace_size);
@@ -510,7 +643,7 @@ fail_buf:
 fail_clear:
 	cxt->pstore.bufsize = 0;
 fail_cnt:
-	kfree(cxt->fprz);
+	ramoops_free_ftrace_przs(cxt);
 fail_init_fprz:
 	kfree(cxt->cprz);
 fail_init_cprz:
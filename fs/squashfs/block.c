@@ -31,6 +31,7 @@
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/buffer_head.h>
+#include <linux/ktime.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -94,7 +95,8 @@ int squashfs_read_data(struct super_block *sb, u64 index, int length,
 	struct buffer_head **bh;
 	int offset = index & ((1 << msblk->devblksize_log2) - 1);
 	u64 cur_index = index >> msblk->devblksize_log2;
-	int bytes, compressed, b = 0, k = 0, avail, i;
+	int bytes, compressed, b = 0, k = 0, avail, i, read_bytes;
+	ktime_t start = ktime_get(), decompress_start, end;
 
 	bh = kcalloc(((output->length + msblk->devblksize - 1)
 		>> msblk->devblksize_log2) + 1, sizeof(*bh), GFP_KERNEL);
@@ -165,6 +167,9 @@ int squashfs_read_data(struct super_block *sb, u64 index, int length,
 			goto block_release;
 	}
 
+	read_bytes = length;
+	decompress_start = ktime_get();
+
 	if (compressed) {
 		length = squashfs_decompress(msblk, bh, b, offset, length,
 			output);
@@ -199,6 +204,11 @@ int squashfs_read_data(struct super_block *sb, u64 index, int length,
 		squashfs_finish_page(output);
 	}
 
+	end = ktime_get();
+	squashfs_stats_read(msblk, read_bytes,
+		ktime_to_ns(ktime_sub(end, start)),
+		ktime_to_ns(ktime_sub(end, decompress_start)));
+
 	kfree(bh);
 	return length;
 
@@ -32,10 +32,16 @@
  * To avoid out of memory and fragmentation issues with vmalloc the cache
  * uses sequences of kmalloced PAGE_CACHE_SIZE buffers.
  *
- * It should be noted that the cache is not used for file datablocks, these
- * are decompressed and cached in the page-cache in the normal way.  The
- * cache is only used to temporarily cache fragment and metadata blocks
- * which have been read as as a result of a metadata (i.e. inode or
+ * File datablocks are normally decompressed and cached in the page-cache,
+ * the datablock ("data") cache only holding as many blocks as there are
+ * decompressors.  It can however be enlarged (CONFIG_SQUASHFS_DATA_CACHE_SIZE
+ * or /sys/fs/squashfs/<dev>/data_cache_entries), in which case decompressed
+ * datablocks are kept for as long as the filesystem is mounted, and a block
+ * dropped from the page-cache is re-read by a copy rather than a decompress.
+ * Eviction favours frequently hit entries, see squashfs_cache_get().
+ *
+ * Otherwise the cache is used to temporarily cache fragment and metadata
+ * blocks which have been read as as a result of a metadata (i.e. inode or
  * directory) or fragment access.  Because metadata and fragments are packed
  * together into blocks (to gain greater compression) the read of a particular
  * piece of metadata or fragment will retrieve other metadata/fragments which
@@ -50,6 +56,7 @@
 #include <linux/vmalloc.h>
 #include <linux/sched.h>
 #include <linux/spinlock.h>
+#include <linux/mutex.h>
 #include <linux/wait.h>
 #include <linux/pagemap.h>
 
@@ -58,6 +65,9 @@
 #include "squashfs.h"
 #include "page_actor.h"
 
+/* saturation point of the per-entry hit count used for eviction */
+#define SQUASHFS_CACHE_HOT_MAX	3
+
 /*
  * Look-up block in cache, and increment usage count.  If not in cache, read
  * and decompress it from disk.
@@ -72,7 +82,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 
 	while (1) {
 		for (i = cache->curr_blk, n = 0; n < cache->entries; n++) {
-			if (cache->entry[i].block == block) {
+			if (cache->entry[i]->block == block) {
 				cache->curr_blk = i;
 				break;
 			}
@@ -94,19 +104,29 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			}
 
 			/*
-			 * At least one unused cache entry.  A simple
-			 * round-robin strategy is used to choose the entry to
-			 * be evicted from the cache.
+			 * At least one unused cache entry.  The entry to be
+			 * evicted is chosen by a clock sweep from next_blk:
+			 * an unused entry which has been hit since it was
+			 * last passed over has its hotness decremented and is
+			 * skipped, the first unused entry found cold is
+			 * taken.  Blocks read once are therefore evicted
+			 * before blocks which are repeatedly accessed, and
+			 * the sweep ends within SQUASHFS_CACHE_HOT_MAX + 1
+			 * passes.
 			 */
 			i = cache->next_blk;
-			for (n = 0; n < cache->entries; n++) {
-				if (cache->entry[i].refcount == 0)
-					break;
+			while (1) {
+				entry = cache->entry[i];
+				if (entry->refcount == 0) {
+					if (entry->hot == 0)
+						break;
+					entry->hot--;
+				}
 				i = (i + 1) % cache->entries;
 			}
 
 			cache->next_blk = (i + 1) % cache->entries;
-			entry = &cache->entry[i];
+			cache->misses++;
 
 			/*
 			 * Initialise chosen cache entry, and fill it in from
@@ -125,8 +145,15 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 
 			spin_lock(&cache->lock);
 
-			if (entry->length < 0)
+			/*
+			 * Don't keep a failed read in the cache, the next
+			 * look-up should retry it rather than return the
+			 * error for as long as the entry survives.
+			 */
+			if (entry->length < 0) {
 				entry->error = entry->length;
+				entry->block = SQUASHFS_INVALID_BLK;
+			}
 
 			entry->pending = 0;
 
@@ -150,10 +177,13 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		 * previously unused there's one less cache entry available
 		 * for reuse.
 		 */
-		entry = &cache->entry[i];
+		entry = cache->entry[i];
 		if (entry->refcount == 0)
 			cache->unused--;
 		entry->refcount++;
+		if (entry->hot < SQUASHFS_CACHE_HOT_MAX)
+			entry->hot++;
+		cache->hits++;
 
 		/*
 		 * If the entry is currently being filled in by another process
@@ -204,24 +234,85 @@ void squashfs_cache_put(struct squashfs_cache_entry *entry)
 	spin_unlock(&cache->lock);
 }
 
+
+static void squashfs_cache_entry_free(struct squashfs_cache *cache,
+	struct squashfs_cache_entry *entry)
+{
+	int j;
+
+	if (entry == NULL)
+		return;
+
+	if (entry->data) {
+		for (j = 0; j < cache->pages; j++)
+			kfree(entry->data[j]);
+		kfree(entry->data);
+	}
+	kfree(entry->actor);
+	kfree(entry);
+}
+
+
+/*
+ * Allocate a cache entry and its sequence of kmalloced PAGE_CACHE_SIZE
+ * buffers.
+ */
+static struct squashfs_cache_entry *squashfs_cache_entry_alloc(
+	struct squashfs_cache *cache)
+{
+	int j;
+	struct squashfs_cache_entry *entry = kzalloc(sizeof(*entry),
+		GFP_KERNEL);
+
+	if (entry == NULL) {
+		ERROR("Failed to allocate %s cache entry\n", cache->name);
+		return NULL;
+	}
+
+	init_waitqueue_head(&entry->wait_queue);
+	entry->cache = cache;
+	entry->block = SQUASHFS_INVALID_BLK;
+	entry->data = kcalloc(cache->pages, sizeof(void *), GFP_KERNEL);
+	if (entry->data == NULL) {
+		ERROR("Failed to allocate %s cache entry\n", cache->name);
+		goto cleanup;
+	}
+
+	for (j = 0; j < cache->pages; j++) {
+		entry->data[j] = kmalloc(PAGE_CACHE_SIZE, GFP_KERNEL);
+		if (entry->data[j] == NULL) {
+			ERROR("Failed to allocate %s buffer\n", cache->name);
+			goto cleanup;
+		}
+	}
+
+	entry->actor = squashfs_page_actor_init(entry->data, cache->pages, 0);
+	if (entry->actor == NULL) {
+		ERROR("Failed to allocate %s cache entry\n", cache->name);
+		goto cleanup;
+	}
+
+	return entry;
+
+cleanup:
+	squashfs_cache_entry_free(cache, entry);
+	return NULL;
+}
+
+
 /*
  * Delete cache reclaiming all kmalloced buffers.
  */
 void squashfs_cache_delete(struct squashfs_cache *cache)
 {
-	int i, j;
+	int i;
 
 	if (cache == NULL)
 		return;
 
-	for (i = 0; i < cache->entries; i++) {
-		if (cache->entry[i].data) {
-			for (j = 0; j < cache->pages; j++)
-				kfree(cache->entry[i].data[j]);
-			kfree(cache->entry[i].data);
-		}
-		kfree(cache->entry[i].actor);
-	}
+	if (cache->entry)
+		for (i = 0; i < cache->entries; i++)
+			squashfs_cache_entry_free(cache, cache->entry[i]);
 
 	kfree(cache->entry);
 	kfree(cache);
@@ -236,7 +327,7 @@ void squashfs_cache_delete(struct squashfs_cache *cache)
 struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 	int block_size)
 {
-	int i, j;
+	int i;
 	struct squashfs_cache *cache = kzalloc(sizeof(*cache), GFP_KERNEL);
 
 	if (cache == NULL) {
@@ -260,34 +351,13 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 	cache->name = name;
 	cache->num_waiters = 0;
 	spin_lock_init(&cache->lock);
+	mutex_init(&cache->resize_mutex);
 	init_waitqueue_head(&cache->wait_queue);
 
 	for (i = 0; i < entries; i++) {
-		struct squashfs_cache_entry *entry = &cache->entry[i];
-
-		init_waitqueue_head(&cache->entry[i].wait_queue);
-		entry->cache = cache;
-		entry->block = SQUASHFS_INVALID_BLK;
-		entry->data = kcalloc(cache->pages, sizeof(void *), GFP_KERNEL);
-		if (entry->data == NULL) {
-			ERROR("Failed to allocate %s cache entry\n", name);
-			goto cleanup;
-		}
-
-		for (j = 0; j < cache->pages; j++) {
-			entry->data[j] = kmalloc(PAGE_CACHE_SIZE, GFP_KERNEL);
-			if (entry->data[j] == NULL) {
-				ERROR("Failed to allocate %s buffer\n", name);
-				goto cleanup;
-			}
-		}
-
-		entry->actor = squashfs_page_actor_init(entry->data,
-						cache->pages, 0);
-		if (entry->actor == NULL) {
-			ERROR("Failed to allocate %s cache entry\n", name);
+		cache->entry[i] = squashfs_cache_entry_alloc(cache);
+		if (cache->entry[i] == NULL)
 			goto cleanup;
-		}
 	}
 
 	return cache;
@@ -298,6 +368,92 @@ cleanup:
 }
 
 
+/*
+ * Change the number of entries in the cache.  New entries are allocated
+ * before the cache is locked, the array of entry pointers is then swapped
+ * under the lock, so concurrent look-ups only ever see a consistent cache.
+ * When shrinking, only unused entries can be freed, the coldest going
+ * first.  If too many entries are in use the cache is shrunk as far as
+ * possible and -EBUSY returned.
+ */
+int squashfs_cache_resize(struct squashfs_cache *cache, int entries)
+{
+	struct squashfs_cache_entry **entry, **old, **victim = NULL;
+	int i, n, hot, drop = 0, excess, size, err = 0;
+
+	if (entries < 1)
+		return -EINVAL;
+
+	mutex_lock(&cache->resize_mutex);
+
+	excess = cache->entries - entries;
+	size = max(entries, cache->entries);
+	entry = kcalloc(size, sizeof(*entry), GFP_KERNEL);
+	if (excess > 0)
+		victim = kcalloc(excess, sizeof(*victim), GFP_KERNEL);
+	if (entry == NULL || (excess > 0 && victim == NULL)) {
+		err = -ENOMEM;
+		goto failed;
+	}
+
+	for (i = cache->entries; i < entries; i++) {
+		entry[i] = squashfs_cache_entry_alloc(cache);
+		if (entry[i] == NULL) {
+			err = -ENOMEM;
+			goto failed;
+		}
+	}
+
+	spin_lock(&cache->lock);
+	old = cache->entry;
+
+	for (hot = 0; hot <= SQUASHFS_CACHE_HOT_MAX && drop < excess; hot++)
+		for (i = 0; i < cache->entries && drop < excess; i++)
+			if (old[i] && old[i]->refcount == 0 &&
+						old[i]->hot <= hot) {
+				victim[drop++] = old[i];
+				old[i] = NULL;
+			}
+
+	for (i = 0, n = 0; i < cache->entries; i++)
+		if (old[i])
+			entry[n++] = old[i];
+	if (entries > cache->entries)
+		n = entries;
+
+	cache->unused += n - cache->entries;
+	cache->entries = n;
+	cache->entry = entry;
+	cache->curr_blk = 0;
+	cache->next_blk = 0;
+
+	if (cache->num_waiters && cache->unused) {
+		spin_unlock(&cache->lock);
+		wake_up_all(&cache->wait_queue);
+	} else
+		spin_unlock(&cache->lock);
+
+	if (n != entries)
+		err = -EBUSY;
+
+	for (i = 0; i < drop; i++)
+		squashfs_cache_entry_free(cache, victim[i]);
+	kfree(victim);
+	kfree(old);
+	mutex_unlock(&cache->resize_mutex);
+	return err;
+
+failed:
+	if (entry)
+		for (i = cache->entries; i < entries; i++)
+			squashfs_cache_entry_free(cache, entry[i]);
+	kfree(victim);
+	kfree(entry);
+	mutex_unlock(&cache->resize_mutex);
+	return err;
+}
+
+
 /*
  * Copy up to length bytes from cache entry to buffer starting at offset bytes
  * into the cache entry.  If there's not length bytes then copy the number of
@@ -47,6 +47,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -497,7 +498,115 @@ out:
 	return 0;
 }
 
+#ifdef CONFIG_SQUASHFS_READAHEAD
+/*
+ * Parallel readahead.  The pages of the readahead window are added to the
+ * page cache and handed to a worker one datablock at a time.  The worker
+ * fills them with squashfs_readpage() as usual: the first call reads the
+ * datablock into the cache, the others copy from it.  The workqueue is
+ * unbound, so datablocks are read and decompressed concurrently on all
+ * cores, each with its own decompressor.
+ */
+struct squashfs_readahead {
+	struct work_struct	work;
+	unsigned int		nr_pages;
+	struct page		*pages[0];
+};
+
+static struct workqueue_struct *squashfs_read_wq;
+
+static void squashfs_readahead_work(struct work_struct *work)
+{
+	struct squashfs_readahead *ra = container_of(work,
+		struct squashfs_readahead, work);
+	unsigned int i;
+
+	for (i = 0; i < ra->nr_pages; i++) {
+		squashfs_readpage(NULL, ra->pages[i]);
+		page_cache_release(ra->pages[i]);
+	}
+	kfree(ra);
+}
+
+static void squashfs_readahead_queue(struct squashfs_sb_info *msblk,
+	struct squashfs_readahead *ra)
+{
+	INIT_WORK(&ra->work, squashfs_readahead_work);
+	queue_work(squashfs_read_wq, &ra->work);
+	atomic64_inc(&msblk->stats.readahead_blocks);
+}
+
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	struct squashfs_readahead *ra = NULL;
+	pgoff_t last = ULONG_MAX;
+	struct page *page;
+	unsigned int i;
+
+	for (i = 0; i < nr_pages; i++) {
+		page = list_entry(pages->prev, struct page, lru);
+		list_del(&page->lru);
+
+		if (add_to_page_cache_lru(page, mapping, page->index,
+				GFP_KERNEL)) {
+			page_cache_release(page);
+			continue;
+		}
+
+		if ((page->index >> shift) != last) {
+			if (ra)
+				squashfs_readahead_queue(msblk, ra);
+			last = page->index >> shift;
+
+			ra = kmalloc(sizeof(*ra) +
+				     (sizeof(struct page *) << shift),
+				     GFP_KERNEL);
+			if (ra)
+				ra->nr_pages = 0;
+		}
+
+		/* no memory for the worker, read the page here */
+		if (ra == NULL) {
+			squashfs_readpage(file, page);
+			page_cache_release(page);
+			continue;
+		}
+
+		ra->pages[ra->nr_pages++] = page;
+	}
+
+	if (ra)
+		squashfs_readahead_queue(msblk, ra);
+
+	return 0;
+}
+
+int __init squashfs_readahead_init(void)
+{
+	squashfs_read_wq = alloc_workqueue("squashfs_read", WQ_UNBOUND, 0);
+
+	return squashfs_read_wq ? 0 : -ENOMEM;
+}
+
+void squashfs_readahead_flush(void)
+{
+	flush_workqueue(squashfs_read_wq);
+}
+
+void squashfs_readahead_destroy(void)
+{
+	destroy_workqueue(squashfs_read_wq);
+}
+#endif
+
 
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#ifdef CONFIG_SQUASHFS_READAHEAD
+	.readpages = squashfs_readpages,
+#endif
 };
@@ -90,6 +90,20 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 		goto out;
 	}
 
+	/*
+	 * If the datablock cache has been enlarged beyond what the
+	 * decompressors need, go through it so the decompressed block is
+	 * kept there once the page cache drops these pages.
+	 */
+	if (msblk->read_page->entries > squashfs_max_decompressors()) {
+		res = squashfs_read_cache(target_page, block, bsize, pages,
+								page);
+		if (res < 0)
+			goto mark_errored;
+
+		goto out;
+	}
+
 	/* Decompress directly into the page cache buffers */
 	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
 	if (res < 0)
@@ -34,6 +34,7 @@ extern int squashfs_read_data(struct super_block *, u64, int, u64 *,
 /* cache.c */
 extern struct squashfs_cache *squashfs_cache_init(char *, int, int);
 extern void squashfs_cache_delete(struct squashfs_cache *);
+extern int squashfs_cache_resize(struct squashfs_cache *, int);
 extern struct squashfs_cache_entry *squashfs_cache_get(struct super_block *,
 				struct squashfs_cache *, u64, int);
 extern void squashfs_cache_put(struct squashfs_cache_entry *);
@@ -69,6 +70,15 @@ extern __le64 *squashfs_read_fragment_index_table(struct super_block *,
 /* file.c */
 void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 				int);
+#ifdef CONFIG_SQUASHFS_READAHEAD
+extern int squashfs_readahead_init(void);
+extern void squashfs_readahead_flush(void);
+extern void squashfs_readahead_destroy(void);
+#else
+static inline int squashfs_readahead_init(void) { return 0; }
+static inline void squashfs_readahead_flush(void) { }
+static inline void squashfs_readahead_destroy(void) { }
+#endif
 
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int);
@@ -83,6 +93,13 @@ extern struct inode *squashfs_iget(struct super_block *, long long,
 				unsigned int);
 extern int squashfs_read_inode(struct inode *, long long);
 
+/* sysfs.c */
+extern void squashfs_stats_read(struct squashfs_sb_info *, int, s64, s64);
+extern int squashfs_sysfs_register(struct super_block *);
+extern void squashfs_sysfs_unregister(struct super_block *);
+extern int squashfs_sysfs_init(void);
+extern void squashfs_sysfs_exit(void);
+
 /* xattr.c */
 extern ssize_t squashfs_listxattr(struct dentry *, char *, size_t);
 
@@ -34,15 +34,19 @@ struct squashfs_cache {
 	int			unused;
 	int			block_size;
 	int			pages;
+	u64			hits;
+	u64			misses;
 	spinlock_t		lock;
+	struct mutex		resize_mutex;
 	wait_queue_head_t	wait_queue;
-	struct squashfs_cache_entry *entry;
+	struct squashfs_cache_entry **entry;
 };
 
 struct squashfs_cache_entry {
 	u64			block;
 	int			length;
 	int			refcount;
+	int			hot;
 	u64			next_index;
 	int			pending;
 	int			error;
@@ -53,6 +57,20 @@ struct squashfs_cache_entry {
 	struct squashfs_page_actor	*actor;
 };
 
+/* read latency histogram buckets: < 1us, < 2us, < 4us, ... >= 16ms */
+#define SQUASHFS_LATENCY_BUCKETS	16
+
+struct squashfs_stats {
+	s64			mount_ns;
+	atomic64_t		reads;
+	atomic64_t		read_bytes;
+	atomic64_t		read_ns;
+	atomic64_t		read_max_ns;
+	atomic64_t		decompress_ns;
+	atomic64_t		readahead_blocks;
+	atomic_t		read_latency[SQUASHFS_LATENCY_BUCKETS];
+};
+
 struct squashfs_sb_info {
 	const struct squashfs_decompressor	*decompressor;
 	int					devblksize;
@@ -76,5 +94,7 @@ struct squashfs_sb_info {
 	long long				bytes_used;
 	unsigned int				inodes;
 	int					xattr_ids;
+	struct squashfs_stats			stats;
+	struct squashfs_sysfs			*sysfs;
 };
 #endif
@@ -36,6 +36,7 @@
 #include <linux/module.h>
 #include <linux/magic.h>
 #include <linux/xattr.h>
+#include <linux/ktime.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -84,6 +85,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	unsigned short flags;
 	unsigned int fragments;
 	u64 lookup_table_start, xattr_id_table_start, next_table;
+	ktime_t start = ktime_get();
 	int err;
 
 	TRACE("Entered squashfs_fill_superblock\n");
@@ -206,7 +208,8 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 
 	/* Allocate read_page block */
 	msblk->read_page = squashfs_cache_init("data",
-		squashfs_max_decompressors(), msblk->block_size);
+		max(squashfs_max_decompressors(), SQUASHFS_CACHED_DATABLOCKS),
+		msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
@@ -328,6 +331,10 @@ check_directory_table:
 		goto failed_mount;
 	}
 
+	msblk->stats.mount_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (squashfs_sysfs_register(sb))
+		WARNING("Failed to register %s in sysfs\n", sb->s_id);
+
 	TRACE("Leaving squashfs_fill_super\n");
 	kfree(sblk);
 	return 0;
@@ -381,6 +388,9 @@ static void squashfs_put_super(struct super_block *sb)
 {
 	if (sb->s_fs_info) {
 		struct squashfs_sb_info *sbi = sb->s_fs_info;
+		squashfs_sysfs_unregister(sb);
+		/* readahead work may still be using the caches below */
+		squashfs_readahead_flush();
 		squashfs_cache_delete(sbi->block_cache);
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
@@ -442,22 +452,38 @@ static int __init init_squashfs_fs(void)
 	if (err)
 		return err;
 
+	err = squashfs_sysfs_init();
+	if (err)
+		goto out_inodecache;
+
+	err = squashfs_readahead_init();
+	if (err)
+		goto out_sysfs;
+
 	err = register_filesystem(&squashfs_fs_type);
-	if (err) {
-		destroy_inodecache();
-		return err;
-	}
+	if (err)
+		goto out_readahead;
 
 	printk(KERN_INFO "squashfs: version 4.0 (2009/01/31) "
 		"Phillip Lougher\n");
 
 	return 0;
+
+out_readahead:
+	squashfs_readahead_destroy();
+out_sysfs:
+	squashfs_sysfs_exit();
+out_inodecache:
+	destroy_inodecache();
+	return err;
 }
 
 
 static void __exit exit_squashfs_fs(void)
 {
 	unregister_filesystem(&squashfs_fs_type);
+	squashfs_readahead_destroy();
+	squashfs_sysfs_exit();
 	destroy_inodecache();
 }
 
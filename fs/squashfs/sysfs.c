@@ -0,0 +1,277 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2. See
+ * the COPYING file in the top-level directory.
+ *
+ * sysfs.c
+ */
+
+/*
+ * This file implements per filesystem statistics, exported in
+ * /sys/fs/squashfs/<device>/.  The time taken to mount is recorded once,
+ * and every block read by squashfs_read_data() is accounted with its
+ * compressed size, its latency (I/O and decompression), the part of that
+ * spent decompressing, and in a log2 latency histogram.
+ *
+ * The hits and misses of the metadata, fragment and datablock caches are
+ * exported as well, and the number of datablock cache entries can be
+ * changed through data_cache_entries.
+ */
+
+#include <linux/fs.h>
+#include <linux/kobject.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+#include <linux/time.h>
+#include <linux/mm.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs.h"
+
+struct squashfs_sysfs {
+	struct kobject		kobj;
+	struct super_block	*sb;
+};
+
+struct squashfs_attr {
+	struct attribute	attr;
+	ssize_t			(*show)(struct squashfs_sb_info *, char *);
+	ssize_t			(*store)(struct squashfs_sb_info *, const char *,
+					 size_t);
+};
+
+static struct kset *squashfs_kset;
+
+
+void squashfs_stats_read(struct squashfs_sb_info *msblk, int length,
+	s64 read_ns, s64 decompress_ns)
+{
+	struct squashfs_stats *stats = &msblk->stats;
+	s64 old, max = atomic64_read(&stats->read_max_ns);
+	int bucket = fls64(div_u64(read_ns, NSEC_PER_USEC));
+
+	atomic64_inc(&stats->reads);
+	atomic64_add(length, &stats->read_bytes);
+	atomic64_add(read_ns, &stats->read_ns);
+	atomic64_add(decompress_ns, &stats->decompress_ns);
+	atomic_inc(&stats->read_latency[min(bucket,
+					SQUASHFS_LATENCY_BUCKETS - 1)]);
+
+	while (read_ns > max) {
+		old = atomic64_cmpxchg(&stats->read_max_ns, max, read_ns);
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
+
+#define SQUASHFS_STAT(_name, _field, _div)				\
+static ssize_t _name##_show(struct squashfs_sb_info *msblk, char *buf)	\
+{									\
+	return sprintf(buf, "%llu\n", div_u64(				\
+		atomic64_read(&msblk->stats._field), _div));		\
+}									\
+static struct squashfs_attr squashfs_attr_##_name = __ATTR_RO(_name)
+
+SQUASHFS_STAT(reads, reads, 1);
+SQUASHFS_STAT(read_bytes, read_bytes, 1);
+SQUASHFS_STAT(read_time_us, read_ns, NSEC_PER_USEC);
+SQUASHFS_STAT(read_max_us, read_max_ns, NSEC_PER_USEC);
+SQUASHFS_STAT(decompress_time_us, decompress_ns, NSEC_PER_USEC);
+SQUASHFS_STAT(readahead_blocks, readahead_blocks, 1);
+
+static ssize_t mount_time_us_show(struct squashfs_sb_info *msblk, char *buf)
+{
+	return sprintf(buf, "%llu\n", div_u64(msblk->stats.mount_ns,
+		NSEC_PER_USEC));
+}
+static struct squashfs_attr squashfs_attr_mount_time_us =
+	__ATTR_RO(mount_time_us);
+
+/* one line per bucket: upper latency bound in microseconds, block reads */
+static ssize_t read_latency_show(struct squashfs_sb_info *msblk, char *buf)
+{
+	int i, len = 0;
+
+	for (i = 0; i < SQUASHFS_LATENCY_BUCKETS - 1; i++)
+		len += sprintf(buf + len, "<%u %u\n", 1 << i,
+			atomic_read(&msblk->stats.read_latency[i]));
+	len += sprintf(buf + len, ">=%u %u\n", 1 << (i - 1),
+		atomic_read(&msblk->stats.read_latency[i]));
+
+	return len;
+}
+static struct squashfs_attr squashfs_attr_read_latency =
+	__ATTR_RO(read_latency);
+
+
+/* there is no fragment cache if the filesystem has no fragments */
+#define SQUASHFS_CACHE_STAT(_name, _cache, _field)			\
+static ssize_t _name##_show(struct squashfs_sb_info *msblk, char *buf)	\
+{									\
+	struct squashfs_cache *cache = msblk->_cache;			\
+	u64 val = 0;							\
+									\
+	if (cache) {							\
+		spin_lock(&cache->lock);				\
+		val = cache->_field;					\
+		spin_unlock(&cache->lock);				\
+	}								\
+	return sprintf(buf, "%llu\n", val);				\
+}									\
+static struct squashfs_attr squashfs_attr_##_name = __ATTR_RO(_name)
+
+SQUASHFS_CACHE_STAT(metadata_cache_hits, block_cache, hits);
+SQUASHFS_CACHE_STAT(metadata_cache_misses, block_cache, misses);
+SQUASHFS_CACHE_STAT(fragment_cache_hits, fragment_cache, hits);
+SQUASHFS_CACHE_STAT(fragment_cache_misses, fragment_cache, misses);
+SQUASHFS_CACHE_STAT(data_cache_hits, read_page, hits);
+SQUASHFS_CACHE_STAT(data_cache_misses, read_page, misses);
+
+static ssize_t data_cache_entries_show(struct squashfs_sb_info *msblk,
+	char *buf)
+{
+	return sprintf(buf, "%d\n", msblk->read_page->entries);
+}
+
+/*
+ * The datablock cache can't be smaller than the number of decompressors,
+ * nor take more than a quarter of RAM.
+ */
+static ssize_t data_cache_entries_store(struct squashfs_sb_info *msblk,
+	const char *buf, size_t count)
+{
+	struct squashfs_cache *cache = msblk->read_page;
+	unsigned int entries;
+	int err;
+
+	err = kstrtouint(buf, 0, &entries);
+	if (err)
+		return err;
+
+	if (entries < squashfs_max_decompressors() ||
+			(u64) entries * cache->pages > totalram_pages / 4)
+		return -EINVAL;
+
+	err = squashfs_cache_resize(cache, entries);
+
+	return err ? err : count;
+}
+static struct squashfs_attr squashfs_attr_data_cache_entries =
+	__ATTR(data_cache_entries, 0644, data_cache_entries_show,
+		data_cache_entries_store);
+
+static struct attribute *squashfs_attrs[] = {
+	&squashfs_attr_mount_time_us.attr,
+	&squashfs_attr_reads.attr,
+	&squashfs_attr_read_bytes.attr,
+	&squashfs_attr_read_time_us.attr,
+	&squashfs_attr_read_max_us.attr,
+	&squashfs_attr_decompress_time_us.attr,
+	&squashfs_attr_readahead_blocks.attr,
+	&squashfs_attr_read_latency.attr,
+	&squashfs_attr_metadata_cache_hits.attr,
+	&squashfs_attr_metadata_cache_misses.attr,
+	&squashfs_attr_fragment_cache_hits.attr,
+	&squashfs_attr_fragment_cache_misses.attr,
+	&squashfs_attr_data_cache_hits.attr,
+	&squashfs_attr_data_cache_misses.attr,
+	&squashfs_attr_data_cache_entries.attr,
+	NULL
+};
+
+
+static ssize_t squashfs_attr_show(struct kobject *kobj, struct attribute *attr,
+	char *buf)
+{
+	struct squashfs_sysfs *sysfs = container_of(kobj, struct squashfs_sysfs,
+		kobj);
+	struct squashfs_attr *a = container_of(attr, struct squashfs_attr,
+		attr);
+
+	return a->show(sysfs->sb->s_fs_info, buf);
+}
+
+static ssize_t squashfs_attr_store(struct kobject *kobj, struct attribute *attr,
+	const char *buf, size_t count)
+{
+	struct squashfs_sysfs *sysfs = container_of(kobj, struct squashfs_sysfs,
+		kobj);
+	struct squashfs_attr *a = container_of(attr, struct squashfs_attr,
+		attr);
+
+	return a->store ? a->store(sysfs->sb->s_fs_info, buf, count) : -EIO;
+}
+
+static void squashfs_sysfs_release(struct kobject *kobj)
+{
+	kfree(container_of(kobj, struct squashfs_sysfs, kobj));
+}
+
+static const struct sysfs_ops squashfs_sysfs_ops = {
+	.show	= squashfs_attr_show,
+	.store	= squashfs_attr_store,
+};
+
+static struct kobj_type squashfs_ktype = {
+	.default_attrs	= squashfs_attrs,
+	.sysfs_ops	= &squashfs_sysfs_ops,
+	.release	= squashfs_sysfs_release,
+};
+
+
+int squashfs_sysfs_register(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	struct squashfs_sysfs *sysfs;
+	int err;
+
+	sysfs = kzalloc(sizeof(*sysfs), GFP_KERNEL);
+	if (sysfs == NULL)
+		return -ENOMEM;
+
+	sysfs->sb = sb;
+	sysfs->kobj.kset = squashfs_kset;
+	err = kobject_init_and_add(&sysfs->kobj, &squashfs_ktype, NULL, "%s",
+		sb->s_id);
+	if (err) {
+		kobject_put(&sysfs->kobj);
+		return err;
+	}
+
+	msblk->sysfs = sysfs;
+	return 0;
+}
+
+
+/*
+ * Once kobject_del() returns no attribute method is running or will run,
+ * so the squashfs_sb_info can be freed even if the kobject lives on.
+ */
+void squashfs_sysfs_unregister(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+
+	if (msblk->sysfs) {
+		kobject_del(&msblk->sysfs->kobj);
+		kobject_put(&msblk->sysfs->kobj);
+		msblk->sysfs = NULL;
+	}
+}
+
+
+int __init squashfs_sysfs_init(void)
+{
+	squashfs_kset = kset_create_and_add("squashfs", NULL, fs_kobj);
+
+	return squashfs_kset ? 0 : -ENOMEM;
+}
+
+
+void squashfs_sysfs_exit(void)
+{
+	kset_unregister(squashfs_kset);
+}
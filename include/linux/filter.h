@@ -110,6 +110,11 @@ u32 sk_run_filter_int_skb(const struct sk_buff *ctx,
 int sk_convert_filter(struct sock_filter *prog, int len,
 		      struct sock_filter_int *new_prog, int *new_len);
 
+/* BPF_CALL targets are at __bpf_call_base + imm */
+u64 __bpf_call_base(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5);
+void *bpf_internal_load_pointer_neg_helper(const struct sk_buff *skb,
+					   int k, unsigned int size);
+
 int sk_unattached_filter_create(struct sk_filter **pfp,
 				struct sock_fprog *fprog);
 void sk_unattached_filter_destroy(struct sk_filter *fp);
@@ -133,6 +138,15 @@ void sk_filter_uncharge(struct sock *sk, struct sk_filter *fp);
 void bpf_jit_compile(struct sk_filter *fp);
 void bpf_jit_free(struct sk_filter *fp);
 
+/*
+ * JIT for the internal instruction set, tried on what the classic JIT
+ * leaves alone and on seccomp filters.  The image is called like
+ * sk_run_filter_int_skb() and, in a socket filter, freed by bpf_jit_free().
+ */
+void *bpf_int_jit_compile(const struct sock_filter_int *insnsi,
+			  unsigned int len);
+void bpf_int_jit_free(void *image);
+
 static inline void bpf_jit_dump(unsigned int flen, unsigned int proglen,
 				u32 pass, void *image)
 {
@@ -151,6 +165,14 @@ static inline void bpf_jit_free(struct sk_filter *fp)
 {
 	kfree(fp);
 }
+static inline void *bpf_int_jit_compile(const struct sock_filter_int *insnsi,
+					unsigned int len)
+{
+	return NULL;
+}
+static inline void bpf_int_jit_free(void *image)
+{
+}
 #endif
 
 static inline int bpf_tell_extensions(void)
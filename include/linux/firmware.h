@@ -19,6 +19,7 @@ struct firmware {
 
 struct module;
 struct device;
+struct scatterlist;
 
 struct builtin_fw {
 	char *name;
@@ -45,6 +46,10 @@ int request_firmware_nowait(
 	struct module *module, bool uevent,
 	const char *name, struct device *device, gfp_t gfp, void *context,
 	void (*cont)(const struct firmware *fw, void *context));
+ssize_t request_firmware_into_sg(const char *name, struct device *device,
+				 struct scatterlist *sgl, unsigned int nents);
+ssize_t request_firmware_into_buf(const char *name, struct device *device,
+				  void *buf, size_t size);
 
 void release_firmware(const struct firmware *fw);
 #else
@@ -62,6 +67,21 @@ static inline int request_firmware_nowait(
 	return -EINVAL;
 }
 
+static inline ssize_t request_firmware_into_sg(const char *name,
+					       struct device *device,
+					       struct scatterlist *sgl,
+					       unsigned int nents)
+{
+	return -EINVAL;
+}
+
+static inline ssize_t request_firmware_into_buf(const char *name,
+						struct device *device,
+						void *buf, size_t size)
+{
+	return -EINVAL;
+}
+
 static inline void release_firmware(const struct firmware *fw)
 {
 }
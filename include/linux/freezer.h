@@ -69,6 +69,12 @@ static inline bool try_to_freeze(void)
 extern bool freeze_task(struct task_struct *p);
 extern bool set_freezable(void);
 
+extern void freezer_track_begin(void);
+extern void freezer_track_end(void);
+extern unsigned int freezer_frozen_count(void);
+extern void freezer_wait_frozen(unsigned int since, unsigned int todo,
+				unsigned int usecs);
+
 #ifdef CONFIG_CGROUP_FREEZER
 extern bool cgroup_freezing(struct task_struct *task);
 #else /* !CONFIG_CGROUP_FREEZER */
@@ -59,6 +59,9 @@ struct gen_pool {
 
 	genpool_algo_t algo;		/* allocation function */
 	void *data;
+
+	struct gen_pool_cache __percpu *cache;	/* per-CPU size bins */
+	struct dentry *debugfs;
 };
 
 /*
@@ -103,6 +106,9 @@ extern void gen_pool_for_each_chunk(struct gen_pool *,
 	void (*)(struct gen_pool *, struct gen_pool_chunk *, void *), void *);
 extern size_t gen_pool_avail(struct gen_pool *);
 extern size_t gen_pool_size(struct gen_pool *);
+extern int gen_pool_enable_cache(struct gen_pool *);
+extern void gen_pool_drain_cache(struct gen_pool *);
+extern void gen_pool_debugfs_create(struct gen_pool *, const char *);
 
 extern void gen_pool_set_algo(struct gen_pool *pool, genpool_algo_t algo,
 		void *data);
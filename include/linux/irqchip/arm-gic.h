@@ -84,6 +84,7 @@ void gic_cpu_if_down(void);
 void gic_raise_softirq(const struct cpumask *mask, unsigned int irq);
 
 void gic_set_cpu(unsigned int cpu, unsigned int irq);
+int gic_set_irq_priority(unsigned int irq, u8 priority);
 
 static inline void gic_init(unsigned int nr, int start,
 			    void __iomem *dist , void __iomem *cpu)
@@ -117,6 +117,35 @@ out:
 	return rc;
 }
 
+/*
+ * One busy poll of the NAPI context with this id, for loops that wait on
+ * more than one socket, like epoll.  Returns the number of packets it got.
+ */
+static inline int napi_id_busy_poll(unsigned int napi_id)
+{
+	const struct net_device_ops *ops;
+	struct napi_struct *napi;
+	int rc = 0;
+
+	rcu_read_lock_bh();
+
+	napi = napi_by_id(napi_id);
+	if (!napi)
+		goto out;
+
+	ops = napi->dev->netdev_ops;
+	if (!ops->ndo_busy_poll)
+		goto out;
+
+	rc = ops->ndo_busy_poll(napi);
+	if (rc > 0)
+		NET_ADD_STATS_BH(dev_net(napi->dev),
+				 LINUX_MIB_BUSYPOLLRXPACKETS, rc);
+out:
+	rcu_read_unlock_bh();
+	return rc;
+}
+
 /* used in the NIC receive handler to mark the skb */
 static inline void skb_mark_napi_id(struct sk_buff *skb,
 				    struct napi_struct *napi)
@@ -165,5 +194,10 @@ static inline bool sk_busy_loop(struct sock *sk, int nonblock)
 	return false;
 }
 
+static inline int napi_id_busy_poll(unsigned int napi_id)
+{
+	return 0;
+}
+
 #endif /* CONFIG_NET_RX_BUSY_POLL */
 #endif /* _LINUX_NET_BUSY_POLL_H */
@@ -16,6 +16,7 @@
 
 /* For O_CLOEXEC */
 #include <linux/fcntl.h>
+#include <linux/ioctl.h>
 #include <linux/types.h>
 
 /* Flags for epoll_create1.  */
@@ -61,6 +62,20 @@ struct epoll_event {
 	__u64 data;
 } EPOLL_PACKED;
 
+/*
+ * Busy polling of an epoll instance, set and read with ioctl() on the
+ * epoll file descriptor.  Until it is set, an instance uses the
+ * net.core.busy_poll sysctl; a busy_poll_usecs of 0 turns busy polling off.
+ */
+struct epoll_params {
+	__u32 busy_poll_usecs;
+	__u32 __pad;		/* must be zero */
+};
+
+#define EPOLL_IOC_TYPE	0x8A
+#define EPIOCSPARAMS	_IOW(EPOLL_IOC_TYPE, 0x01, struct epoll_params)
+#define EPIOCGPARAMS	_IOR(EPOLL_IOC_TYPE, 0x02, struct epoll_params)
+
 #ifdef CONFIG_PM_SLEEP
 static inline void ep_take_care_of_epollwakeup(struct epoll_event *epev)
 {
@@ -10,6 +10,7 @@
 #include <linux/syscalls.h>
 #include <linux/freezer.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 
 /* total number of freezing conditions in effect */
 atomic_t system_freezing_cnt = ATOMIC_INIT(0);
@@ -28,6 +29,26 @@ EXPORT_SYMBOL_GPL(pm_freezing);
 /* protects freezing and frozen transitions */
 static DEFINE_SPINLOCK(freezer_lock);
 
+/*
+ * Tasks entering the refrigerator bump freezer_frozen and wake up
+ * try_to_freeze_tasks(), so that it does not have to poll.  While PM
+ * freezing is tracked, the tasks that took the longest to freeze are
+ * recorded in freezer_stragglers[], slowest first, under freezer_lock.
+ */
+#define FREEZER_STRAGGLERS	3
+
+struct freezer_straggler {
+	char comm[TASK_COMM_LEN];
+	pid_t pid;
+	s64 latency_ns;
+};
+
+static DECLARE_WAIT_QUEUE_HEAD(freezer_wait);
+static atomic_t freezer_frozen = ATOMIC_INIT(0);
+static bool freezer_tracking;
+static ktime_t freezer_start;
+static struct freezer_straggler freezer_stragglers[FREEZER_STRAGGLERS];
+
 /**
  * freezing_slow_path - slow path for testing whether a task needs to be frozen
  * @p: task to be tested
@@ -52,6 +73,33 @@ bool freezing_slow_path(struct task_struct *p)
 }
 EXPORT_SYMBOL(freezing_slow_path);
 
+/* Called with freezer_lock held when %current gets frozen */
+static void freezer_note_frozen(void)
+{
+	struct freezer_straggler *s = freezer_stragglers;
+	s64 latency_ns;
+	int i;
+
+	atomic_inc(&freezer_frozen);
+	if (!freezer_tracking)
+		return;
+
+	latency_ns = ktime_to_ns(ktime_sub(ktime_get(), freezer_start));
+	pr_debug("%s[%d] frozen after %lld us\n", current->comm,
+		 task_pid_nr(current), div_s64(latency_ns, NSEC_PER_USEC));
+
+	for (i = 0; i < FREEZER_STRAGGLERS; i++)
+		if (latency_ns > s[i].latency_ns)
+			break;
+	if (i == FREEZER_STRAGGLERS)
+		return;
+
+	memmove(&s[i + 1], &s[i], (FREEZER_STRAGGLERS - 1 - i) * sizeof(*s));
+	strlcpy(s[i].comm, current->comm, TASK_COMM_LEN);
+	s[i].pid = task_pid_nr(current);
+	s[i].latency_ns = latency_ns;
+}
+
 /* Refrigerator is place where frozen processes are stored :-). */
 bool __refrigerator(bool check_kthr_stop)
 {
@@ -70,10 +118,14 @@ bool __refrigerator(bool check_kthr_stop)
 		if (!freezing(current) ||
 		    (check_kthr_stop && kthread_should_stop()))
 			current->flags &= ~PF_FROZEN;
+		else if (!was_frozen)
+			freezer_note_frozen();
 		spin_unlock_irq(&freezer_lock);
 
 		if (!(current->flags & PF_FROZEN))
 			break;
+		if (!was_frozen)
+			wake_up(&freezer_wait);
 		was_frozen = true;
 		schedule();
 	}
@@ -101,6 +153,76 @@ static void fake_signal_wake_up(struct task_struct *p)
 	}
 }
 
+/**
+ * freezer_track_begin - start tracking PM freezing
+ *
+ * Clears the stragglers recorded by the previous freezing and takes the
+ * time freeze latencies are measured from.
+ */
+void freezer_track_begin(void)
+{
+	spin_lock_irq(&freezer_lock);
+	memset(freezer_stragglers, 0, sizeof(freezer_stragglers));
+	freezer_start = ktime_get();
+	freezer_tracking = true;
+	spin_unlock_irq(&freezer_lock);
+}
+
+/**
+ * freezer_track_end - stop tracking PM freezing and report the stragglers
+ *
+ * Continues the line try_to_freeze_tasks() is printing with the tasks that
+ * took the longest to enter the refrigerator.
+ */
+void freezer_track_end(void)
+{
+	struct freezer_straggler s[FREEZER_STRAGGLERS];
+	int i;
+
+	spin_lock_irq(&freezer_lock);
+	freezer_tracking = false;
+	memcpy(s, freezer_stragglers, sizeof(s));
+	spin_unlock_irq(&freezer_lock);
+
+	if (!s[0].latency_ns)
+		return;
+
+	printk("(slowest:");
+	for (i = 0; i < FREEZER_STRAGGLERS && s[i].latency_ns; i++)
+		printk(" %s[%d] %lld us", s[i].comm, s[i].pid,
+		       div_s64(s[i].latency_ns, NSEC_PER_USEC));
+	printk(") ");
+}
+
+/**
+ * freezer_frozen_count - number of times tasks got frozen so far
+ *
+ * To be passed to freezer_wait_frozen() as @since, read before counting the
+ * tasks still to be frozen.
+ */
+unsigned int freezer_frozen_count(void)
+{
+	return atomic_read(&freezer_frozen);
+}
+
+/**
+ * freezer_wait_frozen - wait for tasks to enter the refrigerator
+ * @since: freezer_frozen_count() taken before @todo was counted
+ * @todo: number of tasks still to be frozen
+ * @usecs: maximum time to wait
+ *
+ * Returns as soon as @todo tasks were frozen after @since, or after @usecs
+ * microseconds.  Tasks which froze while @todo was being counted may make
+ * this return early, in which case the caller simply counts again.
+ */
+void freezer_wait_frozen(unsigned int since, unsigned int todo,
+			 unsigned int usecs)
+{
+	wait_event_hrtimeout(freezer_wait,
+		(unsigned int)atomic_read(&freezer_frozen) - since >= todo,
+		ns_to_ktime((u64)usecs * NSEC_PER_USEC));
+}
+
 /**
  * freeze_task - send a freeze request to given task
  * @p: task to send the request to
@@ -14,6 +14,7 @@
 #include <linux/kernel_stat.h>
 #include <linux/radix-tree.h>
 #include <linux/bitmap.h>
+#include <linux/tick.h>
 
 #include "internals.h"
 
@@ -27,6 +28,11 @@ static void __init init_irq_default_affinity(void)
 {
 	alloc_cpumask_var(&irq_default_affinity, GFP_NOWAIT);
 	cpumask_setall(irq_default_affinity);
+#ifdef CONFIG_NO_HZ_FULL
+	/* device interrupts go to the housekeeping CPUs unless asked otherwise */
+	if (tick_nohz_full_enabled())
+		cpumask_copy(irq_default_affinity, housekeeping_mask);
+#endif
 }
 #else
 static void __init init_irq_default_affinity(void)
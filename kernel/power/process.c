@@ -27,7 +27,7 @@ static int try_to_freeze_tasks(bool user_only)
 {
 	struct task_struct *g, *p;
 	unsigned long end_time;
-	unsigned int todo;
+	unsigned int todo, frozen_cnt;
 	bool wq_busy = false;
 	struct timeval start, end;
 	u64 elapsed_msecs64;
@@ -42,8 +42,11 @@ static int try_to_freeze_tasks(bool user_only)
 	if (!user_only)
 		freeze_workqueues_begin();
 
+	freezer_track_begin();
+
 	while (true) {
 		todo = 0;
+		frozen_cnt = freezer_frozen_count();
 		read_lock(&tasklist_lock);
 		do_each_thread(g, p) {
 			if (p == current || !freeze_task(p))
@@ -69,10 +72,17 @@ static int try_to_freeze_tasks(bool user_only)
 
 		/*
 		 * We need to retry, but first give the freezing tasks some
-		 * time to enter the refrigerator.  Start with an initial
-		 * 1 ms sleep followed by exponential backoff until 8 ms.
+		 * time to enter the refrigerator.  Tasks entering it wake us
+		 * up, so we only sleep through the whole interval if some
+		 * task is slow to freeze or a workqueue is busy, the latter
+		 * not being signalled.  Start with an initial 1 ms interval
+		 * followed by exponential backoff until 8 ms.
 		 */
-		usleep_range(sleep_usecs / 2, sleep_usecs);
+		if (todo > wq_busy)
+			freezer_wait_frozen(frozen_cnt, todo - wq_busy,
+					    sleep_usecs);
+		else
+			usleep_range(sleep_usecs / 2, sleep_usecs);
 		if (sleep_usecs < 8 * USEC_PER_MSEC)
 			sleep_usecs *= 2;
 	}
@@ -103,6 +113,7 @@ static int try_to_freeze_tasks(bool user_only)
 		printk("(elapsed %d.%03d seconds) ", elapsed_msecs / 1000,
 			elapsed_msecs % 1000);
 	}
+	freezer_track_end();
 
 	return todo ? -EBUSY : 0;
 }
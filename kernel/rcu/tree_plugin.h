@@ -99,6 +99,16 @@ static void __init rcu_bootup_announce_oddness(void)
 	cpumask_copy(rcu_nocb_mask, cpu_possible_mask);
 #endif /* #ifdef CONFIG_RCU_NOCB_CPU_ALL */
 #endif /* #ifndef CONFIG_RCU_NOCB_CPU_NONE */
+#ifdef CONFIG_NO_HZ_FULL
+	if (tick_nohz_full_running) {
+		if (!have_rcu_nocb_mask) {
+			zalloc_cpumask_var(&rcu_nocb_mask, GFP_KERNEL);
+			have_rcu_nocb_mask = true;
+		}
+		pr_info("\tOffload RCU callbacks from full dynticks CPUs\n");
+		cpumask_or(rcu_nocb_mask, rcu_nocb_mask, tick_nohz_full_mask);
+	}
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
 	if (have_rcu_nocb_mask) {
 		if (!cpumask_subset(rcu_nocb_mask, cpu_possible_mask)) {
 			pr_info("\tNote: kernel parameter 'rcu_nocbs=' contains nonexistent CPUs.\n");
@@ -2386,6 +2396,7 @@ static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp)
 		t = kthread_run(rcu_nocb_kthread, rdp,
 				"rcuo%c/%d", rsp->abbr, cpu);
 		BUG_ON(IS_ERR(t));
+		housekeeping_affine(t);
 		ACCESS_ONCE(rdp->nocb_kthread) = t;
 	}
 }
@@ -2880,8 +2891,13 @@ static bool is_sysidle_rcu_state(struct rcu_state *rsp)
 	return false;
 }
 
+/*
+ * Without sysidle detection the grace-period kthread need not stay on the
+ * timekeeping CPU, but it still must not run on a full dynticks CPU.
+ */
 static void rcu_bind_gp_kthread(void)
 {
+	housekeeping_affine(current);
 }
 
 static void rcu_sysidle_report_gp(struct rcu_state *rsp, int isidle,
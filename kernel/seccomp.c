@@ -39,6 +39,7 @@
  *         is only needed for handling filters shared across tasks.
  * @prev: points to a previously installed, or inherited, filter
  * @len: the number of instructions in the program
+ * @bpf_func: runs the program, the interpreter or JIT'ed code
  * @insns: the BPF program instructions to evaluate
  *
  * seccomp_filter objects are organized in a tree linked via the @prev
@@ -55,6 +56,8 @@ struct seccomp_filter {
 	atomic_t usage;
 	struct seccomp_filter *prev;
 	unsigned short len;  /* Instruction count */
+	u32 (*bpf_func)(const struct seccomp_data *sd,
+			const struct sock_filter_int *insnsi);
 	struct sock_filter_int insnsi[];
 };
 
@@ -189,7 +192,7 @@ static u32 seccomp_run_filters(int syscall)
 	 * value always takes priority (ignoring the DATA).
 	 */
 	for (f = current->seccomp.filter; f; f = f->prev) {
-		u32 cur_ret = sk_run_filter_int_seccomp(&sd, f->insnsi);
+		u32 cur_ret = f->bpf_func(&sd, f->insnsi);
 		if ((cur_ret & SECCOMP_RET_ACTION) < (ret & SECCOMP_RET_ACTION))
 			ret = cur_ret;
 	}
@@ -270,6 +273,10 @@ static long seccomp_attach_filter(struct sock_fprog *fprog)
 	atomic_set(&filter->usage, 1);
 	filter->len = new_len;
 
+	filter->bpf_func = bpf_int_jit_compile(filter->insnsi, new_len);
+	if (!filter->bpf_func)
+		filter->bpf_func = sk_run_filter_int_seccomp;
+
 	/*
 	 * If there is an existing filter, make it the prev and don't drop its
 	 * task reference.
@@ -330,6 +337,8 @@ void put_seccomp_filter(struct task_struct *tsk)
 	while (orig && atomic_dec_and_test(&orig->usage)) {
 		struct seccomp_filter *freeme = orig;
 		orig = orig->prev;
+		if (freeme->bpf_func != sk_run_filter_int_seccomp)
+			bpf_int_jit_free(freeme->bpf_func);
 		kfree(freeme);
 	}
 }
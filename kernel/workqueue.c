@@ -48,6 +48,7 @@
 #include <linux/nodemask.h>
 #include <linux/moduleparam.h>
 #include <linux/uaccess.h>
+#include <linux/tick.h>
 
 #include "workqueue_internal.h"
 
@@ -1342,8 +1343,12 @@ static void __queue_work(int cpu, struct workqueue_struct *wq,
 	    WARN_ON_ONCE(!is_chained_work(wq)))
 		return;
 retry:
-	if (req_cpu == WORK_CPU_UNBOUND)
+	if (req_cpu == WORK_CPU_UNBOUND) {
 		cpu = raw_smp_processor_id();
+		/* don't let the local cpu choice pull work onto a nohz_full cpu */
+		if (tick_nohz_full_cpu(cpu))
+			cpu = housekeeping_any_cpu();
+	}
 
 	/* pwq which will be used unless @work is executing elsewhere */
 	if (!(wq->flags & WQ_UNBOUND))
@@ -1487,6 +1492,8 @@ static void __queue_delayed_work(int cpu, struct workqueue_struct *wq,
 
 	if (unlikely(cpu != WORK_CPU_UNBOUND))
 		add_timer_on(timer, cpu);
+	else if (tick_nohz_full_cpu(smp_processor_id()))
+		add_timer_on(timer, housekeeping_any_cpu());
 	else
 		add_timer(timer);
 }
@@ -5050,6 +5057,18 @@ static void __init wq_numa_init(void)
 	wq_numa_enabled = true;
 }
 
+/*
+ * Keep the default unbound worker pools off full dynticks CPUs.  Workqueues
+ * exposed through sysfs can still be given any cpumask.
+ */
+static void __init wq_housekeeping_attrs(struct workqueue_attrs *attrs)
+{
+#ifdef CONFIG_NO_HZ_FULL
+	if (tick_nohz_full_enabled())
+		cpumask_copy(attrs->cpumask, housekeeping_mask);
+#endif
+}
+
 static int __init init_workqueues(void)
 {
 	int std_nice[NR_STD_WORKER_POOLS] = { 0, HIGHPRI_NICE_LEVEL };
@@ -5099,6 +5118,7 @@ static int __init init_workqueues(void)
 
 		BUG_ON(!(attrs = alloc_workqueue_attrs(GFP_KERNEL)));
 		attrs->nice = std_nice[i];
+		wq_housekeeping_attrs(attrs);
 		unbound_std_wq_attrs[i] = attrs;
 
 		/*
@@ -5109,6 +5129,7 @@ static int __init init_workqueues(void)
 		BUG_ON(!(attrs = alloc_workqueue_attrs(GFP_KERNEL)));
 		attrs->nice = std_nice[i];
 		attrs->no_numa = true;
+		wq_housekeeping_attrs(attrs);
 		ordered_wq_attrs[i] = attrs;
 	}
 
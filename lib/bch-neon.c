@@ -0,0 +1,113 @@
+/*
+ * linux/lib/bch-neon.c - BCH encoding and syndrome computation using ARM NEON
+ * intrinsics
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+/*
+ * The encoder follows encode_bch(): every 32-bit data word selects four
+ * precomputed remainders, which are XORed into the ecc register shifted by
+ * one word. Here the remainder rows are zero padded to 4 or 8 words, so that
+ * the register and each row are handled as one or two q registers instead
+ * of word by word.
+ *
+ * The syndrome calculator uses one table per 4-bit nibble of the ecc
+ * polynomial, holding the t odd syndrome contributions of each of the 16
+ * nibble values; the syndromes are then the XOR of one row per nibble.
+ *
+ * This file is compiled with -mfpu=neon and must only be called from within
+ * a kernel_neon_begin()/kernel_neon_end() pair. As arm_neon.h is not type
+ * compatible with the kernel headers, only C99 types are used here.
+ */
+
+#include <arm_neon.h>
+
+static inline uint32x4_t load_row(const uint32_t *tab, unsigned int idx,
+				  unsigned int stride, unsigned int half)
+{
+	return vld1q_u32(tab + idx * stride + 4 * half);
+}
+
+static inline void bch_encode_loop(uint32_t *ecc, const uint32_t *data,
+				   unsigned int nwords, const uint32_t *tab,
+				   const unsigned int stride)
+{
+	const uint32x4_t zero = vdupq_n_u32(0);
+	uint32x4_t r0, r1, p0, p1;
+	uint32_t w;
+
+	r0 = vld1q_u32(ecc);
+	r1 = stride == 8 ? vld1q_u32(ecc + 4) : zero;
+
+	while (nwords--) {
+		/* input data is read in big-endian format */
+		w = vgetq_lane_u32(r0, 0) ^ __builtin_bswap32(*data++);
+
+		p0 = veorq_u32(load_row(tab, w & 0xff, stride, 0),
+			       load_row(tab, 256 + ((w >> 8) & 0xff), stride, 0));
+		p0 = veorq_u32(p0,
+			       load_row(tab, 512 + ((w >> 16) & 0xff), stride, 0));
+		p0 = veorq_u32(p0, load_row(tab, 768 + (w >> 24), stride, 0));
+
+		if (stride == 8) {
+			p1 = veorq_u32(load_row(tab, w & 0xff, stride, 1),
+				load_row(tab, 256 + ((w >> 8) & 0xff), stride, 1));
+			p1 = veorq_u32(p1,
+				load_row(tab, 512 + ((w >> 16) & 0xff), stride, 1));
+			p1 = veorq_u32(p1,
+				load_row(tab, 768 + (w >> 24), stride, 1));
+
+			r0 = veorq_u32(vextq_u32(r0, r1, 1), p0);
+			r1 = veorq_u32(vextq_u32(r1, zero, 1), p1);
+		} else {
+			r0 = veorq_u32(vextq_u32(r0, zero, 1), p0);
+		}
+	}
+
+	vst1q_u32(ecc, r0);
+	if (stride == 8)
+		vst1q_u32(ecc + 4, r1);
+}
+
+/*
+ * ecc[] holds the ecc register padded with zero words to @stride (4 or 8)
+ * words, tab[] the four remainder tables with rows of @stride words.
+ * @data must be 32-bit aligned.
+ */
+void bch_encode_neon(uint32_t *ecc, const uint32_t *data, unsigned int nwords,
+		     const uint32_t *tab, unsigned int stride)
+{
+	if (stride == 8)
+		bch_encode_loop(ecc, data, nwords, tab, 8);
+	else
+		bch_encode_loop(ecc, data, nwords, tab, 4);
+}
+
+/*
+ * Compute the t odd syndromes of the @nnib nibble ecc polynomial held in
+ * ecc[], most significant nibble first. Each of the 16 rows per nibble in
+ * tab[] holds @tpad (8 or 16) syndrome contributions, as does syn[].
+ */
+void bch_syndromes_neon(uint16_t *syn, const uint32_t *ecc, unsigned int nnib,
+			const uint16_t *tab, unsigned int tpad)
+{
+	uint16x8_t s0 = vdupq_n_u16(0), s1 = vdupq_n_u16(0);
+	const uint16_t *row;
+	unsigned int q, v;
+
+	for (q = 0; q < nnib; q++) {
+		v = (ecc[q / 8] >> (28 - 4 * (q % 8))) & 15;
+		row = tab + (q * 16 + v) * tpad;
+
+		s0 = veorq_u16(s0, vld1q_u16(row));
+		if (tpad == 16)
+			s1 = veorq_u16(s1, vld1q_u16(row + 8));
+	}
+
+	vst1q_u16(syn, s0);
+	if (tpad == 16)
+		vst1q_u16(syn + 8, s1);
+}
@@ -74,6 +74,11 @@
 #include <asm/byteorder.h>
 #include <linux/bch.h>
 
+#ifdef CONFIG_BCH_NEON
+#include <asm/neon.h>
+#include <asm/simd.h>
+#endif
+
 #if defined(CONFIG_BCH_CONST_PARAMS)
 #define GF_M(_p)               (CONFIG_BCH_CONST_M)
 #define GF_T(_p)               (CONFIG_BCH_CONST_T)
@@ -108,6 +113,97 @@ struct gf_poly_deg1 {
 	unsigned int   c[2];
 };
 
+#ifdef CONFIG_BCH_NEON
+/*
+ * NEON encoding and syndrome computation is used for codes of up to 8 ecc
+ * words and t <= 16, which covers the usual NAND strengths, and for inputs
+ * of at least BCH_NEON_MIN_WORDS aligned words
+ */
+#define BCH_NEON_MAX_WORDS	8
+#define BCH_NEON_MAX_T		16
+#define BCH_NEON_MIN_WORDS	16
+
+void bch_encode_neon(uint32_t *ecc, const uint32_t *data, unsigned int nwords,
+		     const uint32_t *tab, unsigned int stride);
+void bch_syndromes_neon(uint16_t *syn, const uint32_t *ecc, unsigned int nnib,
+			const uint16_t *tab, unsigned int tpad);
+
+/* NEON table row lengths, in 32-bit ecc words and 16-bit syndromes */
+static inline unsigned int neon_stride(struct bch_control *bch)
+{
+	return (BCH_ECC_WORDS(bch) > 4) ? 8 : 4;
+}
+
+static inline unsigned int neon_tpad(struct bch_control *bch)
+{
+	return (GF_T(bch) > 8) ? 16 : 8;
+}
+
+/*
+ * encode 32-bit aligned data words into ecc register r using NEON; returns
+ * false if the caller should use the scalar code instead
+ */
+static bool encode_bch_neon(struct bch_control *bch, const uint32_t *data,
+			    unsigned int nwords, uint32_t *r)
+{
+	uint32_t ecc[BCH_NEON_MAX_WORDS] __aligned(16);
+	const size_t size = BCH_ECC_WORDS(bch)*sizeof(*r);
+
+	if (!bch->mod8_neon_tab || (nwords < BCH_NEON_MIN_WORDS) ||
+	    !may_use_simd())
+		return false;
+
+	memset(ecc, 0, sizeof(ecc));
+	memcpy(ecc, r, size);
+
+	kernel_neon_begin();
+	bch_encode_neon(ecc, data, nwords, bch->mod8_neon_tab,
+			neon_stride(bch));
+	kernel_neon_end();
+
+	memcpy(r, ecc, size);
+	return true;
+}
+
+/*
+ * compute the t odd syndromes v(a^(2j+1)) into syn[2j] using NEON; returns
+ * false if the caller should use the scalar code instead
+ */
+static bool compute_syndromes_neon(struct bch_control *bch,
+				   const uint32_t *ecc, unsigned int *syn)
+{
+	uint16_t s[BCH_NEON_MAX_T] __aligned(16);
+	int j;
+
+	if (!bch->syn_neon_tab || !may_use_simd())
+		return false;
+
+	kernel_neon_begin();
+	bch_syndromes_neon(s, ecc, DIV_ROUND_UP(bch->ecc_bits, 4),
+			   bch->syn_neon_tab, neon_tpad(bch));
+	kernel_neon_end();
+
+	for (j = 0; j < GF_T(bch); j++)
+		syn[2*j] = s[j];
+
+	return true;
+}
+#else
+static inline bool encode_bch_neon(struct bch_control *bch,
+				   const uint32_t *data, unsigned int nwords,
+				   uint32_t *r)
+{
+	return false;
+}
+
+static inline bool compute_syndromes_neon(struct bch_control *bch,
+					  const uint32_t *ecc,
+					  unsigned int *syn)
+{
+	return false;
+}
+#endif
+
 /*
  * same as encode_bch(), but process input data one byte at a time
  */
@@ -217,6 +313,9 @@ void encode_bch(struct bch_control *bch, const uint8_t *data,
 	len  -= 4*mlen;
 	memcpy(r, bch->ecc_buf, sizeof(r));
 
+	if (encode_bch_neon(bch, pdata, mlen, r))
+		mlen = 0;
+
 	/*
 	 * split each 32-bit word into 4 polynomials of weight 8 as follows:
 	 *
@@ -348,20 +447,22 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 	m = ((unsigned int)s) & 31;
 	if (m)
 		ecc[s/32] &= ~((1u << (32-m))-1);
-	memset(syn, 0, 2*t*sizeof(*syn));
 
 	/* compute v(a^j) for j=1 .. 2t-1 */
-	do {
-		poly = *ecc++;
-		s -= 32;
-		while (poly) {
-			i = deg(poly);
-			for (j = 0; j < 2*t; j += 2)
-				syn[j] ^= a_pow(bch, (j+1)*(i+s));
-
-			poly ^= (1 << i);
-		}
-	} while (s > 0);
+	if (!compute_syndromes_neon(bch, ecc, syn)) {
+		memset(syn, 0, 2*t*sizeof(*syn));
+		do {
+			poly = *ecc++;
+			s -= 32;
+			while (poly) {
+				i = deg(poly);
+				for (j = 0; j < 2*t; j += 2)
+					syn[j] ^= a_pow(bch, (j+1)*(i+s));
+
+				poly ^= (1 << i);
+			}
+		} while (s > 0);
+	}
 
 	/* v(a^(2j)) = v(a^j)^2 */
 	for (j = 0; j < t; j++)
@@ -1158,6 +1259,69 @@ static void *bch_alloc(size_t size, int *err)
 	return ptr;
 }
 
+#ifdef CONFIG_BCH_NEON
+/*
+ * build the padded NEON encoding tables and the per-nibble syndrome tables,
+ * if the cpu has NEON and the code is small enough; otherwise, or if memory
+ * is short, the scalar code is used
+ */
+static void build_neon_tables(struct bch_control *bch)
+{
+	const unsigned int l = BCH_ECC_WORDS(bch);
+	const unsigned int stride = neon_stride(bch);
+	const unsigned int tpad = neon_tpad(bch);
+	const unsigned int nnib = DIV_ROUND_UP(bch->ecc_bits, 4);
+	unsigned int i, j, q, b, v;
+	uint16_t *row;
+	int e, err = 0;
+
+	if (!cpu_has_neon() || (l > BCH_NEON_MAX_WORDS) ||
+	    (GF_T(bch) > BCH_NEON_MAX_T))
+		return;
+
+	bch->mod8_neon_tab = bch_alloc(1024*stride*sizeof(uint32_t), &err);
+	bch->syn_neon_tab = bch_alloc(nnib*16*tpad*sizeof(uint16_t), &err);
+	if (err) {
+		kfree(bch->mod8_neon_tab);
+		kfree(bch->syn_neon_tab);
+		bch->mod8_neon_tab = NULL;
+		bch->syn_neon_tab = NULL;
+		return;
+	}
+
+	memset(bch->mod8_neon_tab, 0, 1024*stride*sizeof(uint32_t));
+	for (i = 0; i < 1024; i++)
+		memcpy(bch->mod8_neon_tab+i*stride, bch->mod8_tab+i*l,
+		       l*sizeof(uint32_t));
+
+	memset(bch->syn_neon_tab, 0, nnib*16*tpad*sizeof(uint16_t));
+	for (q = 0; q < nnib; q++) {
+		row = bch->syn_neon_tab+q*16*tpad;
+		/* single bit nibbles: bit b of nibble q is term X^e of ecc */
+		for (b = 0; b < 4; b++) {
+			e = 28-4*(q % 8)+b+bch->ecc_bits-32*(q/8+1);
+			if (e < 0)
+				/* padding bit, always cleared */
+				continue;
+			for (j = 0; j < GF_T(bch); j++)
+				row[(1 << b)*tpad+j] = a_pow(bch, (2*j+1)*e);
+		}
+		/* other nibbles are sums of single bit ones */
+		for (v = 3; v < 16; v++) {
+			if (!(v & (v-1)))
+				continue;
+			for (j = 0; j < GF_T(bch); j++)
+				row[v*tpad+j] = row[(v & (v-1))*tpad+j]^
+					row[(v & -v)*tpad+j];
+		}
+	}
+}
+#else
+static inline void build_neon_tables(struct bch_control *bch)
+{
+}
+#endif
+
 /*
  * compute generator polynomial for given (m,t) parameters.
  */
@@ -1324,6 +1488,8 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	build_mod8_tables(bch, genpoly);
 	kfree(genpoly);
 
+	build_neon_tables(bch);
+
 	err = build_deg2_base(bch);
 	if (err)
 		goto fail;
@@ -1348,6 +1514,8 @@ void free_bch(struct bch_control *bch)
 		kfree(bch->a_pow_tab);
 		kfree(bch->a_log_tab);
 		kfree(bch->mod8_tab);
+		kfree(bch->mod8_neon_tab);
+		kfree(bch->syn_neon_tab);
 		kfree(bch->ecc_buf);
 		kfree(bch->ecc_buf2);
 		kfree(bch->xi_tab);
@@ -0,0 +1,132 @@
+/*
+ * linux/lib/crc32-neon.c - CRC32 and CRC32c folding using ARM NEON intrinsics
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+/*
+ * The input is folded four 128 bit lanes (64 bytes) at a time, using
+ * carry-less multiplication by x^n mod P to move each lane forward over the
+ * following 512 bits, as described in "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" (Gopal et al). The four lanes are
+ * then folded into one, and the remaining 16 bytes are handed back to the
+ * caller, whose CRC over them (with a zero seed) is the CRC of the input.
+ *
+ * ARMv7 NEON has no 64x64 bit carry-less multiply, so each product is
+ * assembled from vmull.p8 multiplies of byte-rotated operands (Camara,
+ * Gouvea, Lopez, Dahab). The multiply is polynomial agnostic: the folding
+ * constants passed in k[] select CRC32 or CRC32c.
+ *
+ * This file is compiled with -mfpu=neon and must only be called from within
+ * a kernel_neon_begin()/kernel_neon_end() pair. As arm_neon.h is not type
+ * compatible with the kernel headers, only C99 types are used here.
+ */
+
+#include <arm_neon.h>
+
+static inline uint64x2_t pmull_p8(uint64x1_t ad, uint64x1_t bd)
+{
+	const uint64x2_t k48_32 = { 0x0000ffffffffffffULL, 0x00000000ffffffffULL };
+	const uint64x2_t k16_0 = { 0x000000000000ffffULL, 0 };
+	uint8x8_t a = vreinterpret_u8_u64(ad);
+	uint8x8_t b = vreinterpret_u8_u64(bd);
+	uint64x2_t t0, t1, t2, t3, d;
+	uint64x1_t lo, hi;
+
+	/* L = A1*B + A*B1, M = A2*B + A*B2, N = A3*B + A*B3, K = A*B4 */
+	t0 = vreinterpretq_u64_p16(veorq_u16(
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(vext_u8(a, a, 1)),
+					       vreinterpret_p8_u8(b))),
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(a),
+					       vreinterpret_p8_u8(vext_u8(b, b, 1))))));
+	t1 = vreinterpretq_u64_p16(veorq_u16(
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(vext_u8(a, a, 2)),
+					       vreinterpret_p8_u8(b))),
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(a),
+					       vreinterpret_p8_u8(vext_u8(b, b, 2))))));
+	t2 = vreinterpretq_u64_p16(veorq_u16(
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(vext_u8(a, a, 3)),
+					       vreinterpret_p8_u8(b))),
+		vreinterpretq_u16_p16(vmull_p8(vreinterpret_p8_u8(a),
+					       vreinterpret_p8_u8(vext_u8(b, b, 3))))));
+	t3 = vreinterpretq_u64_p16(vmull_p8(vreinterpret_p8_u8(a),
+				   vreinterpret_p8_u8(vext_u8(b, b, 4))));
+	d = vreinterpretq_u64_p16(vmull_p8(vreinterpret_p8_u8(a),
+					   vreinterpret_p8_u8(b)));
+
+	lo = veor_u64(vget_low_u64(t0), vget_high_u64(t0));
+	hi = vand_u64(vget_high_u64(t0), vget_low_u64(k48_32));
+	t0 = vcombine_u64(veor_u64(lo, hi), hi);
+
+	lo = veor_u64(vget_low_u64(t1), vget_high_u64(t1));
+	hi = vand_u64(vget_high_u64(t1), vget_high_u64(k48_32));
+	t1 = vcombine_u64(veor_u64(lo, hi), hi);
+
+	lo = veor_u64(vget_low_u64(t2), vget_high_u64(t2));
+	hi = vand_u64(vget_high_u64(t2), vget_low_u64(k16_0));
+	t2 = vcombine_u64(veor_u64(lo, hi), hi);
+
+	lo = veor_u64(vget_low_u64(t3), vget_high_u64(t3));
+	t3 = vcombine_u64(lo, vget_high_u64(k16_0));
+
+	t0 = vreinterpretq_u64_u8(vextq_u8(vreinterpretq_u8_u64(t0),
+					   vreinterpretq_u8_u64(t0), 15));
+	t1 = vreinterpretq_u64_u8(vextq_u8(vreinterpretq_u8_u64(t1),
+					   vreinterpretq_u8_u64(t1), 14));
+	t2 = vreinterpretq_u64_u8(vextq_u8(vreinterpretq_u8_u64(t2),
+					   vreinterpretq_u8_u64(t2), 13));
+	t3 = vreinterpretq_u64_u8(vextq_u8(vreinterpretq_u8_u64(t3),
+					   vreinterpretq_u8_u64(t3), 12));
+
+	return veorq_u64(veorq_u64(d, t0), veorq_u64(t1, veorq_u64(t2, t3)));
+}
+
+/*
+ * Bytes 0-7 of a lane (the low word) hold the higher order coefficients of
+ * the bit reflected polynomial, so they are multiplied by the larger power.
+ */
+static inline uint64x2_t fold(uint64x2_t x, uint64x1_t khi, uint64x1_t klo)
+{
+	return veorq_u64(pmull_p8(vget_low_u64(x), khi),
+			 pmull_p8(vget_high_u64(x), klo));
+}
+
+static inline uint64x2_t load_lane(const uint8_t *p)
+{
+	return vreinterpretq_u64_u8(vld1q_u8(p));
+}
+
+/*
+ * k[] holds x^575, x^511, x^191 and x^127 mod P, bit reflected: the extra
+ * factor of x that the reflected multiply introduces is accounted for by
+ * using powers one below the fold distance.
+ */
+void crc32_neon_fold(uint8_t out[16], uint32_t crc, const uint8_t *p,
+		     unsigned int blocks, const uint64_t k[4])
+{
+	uint64x1_t k575 = vcreate_u64(k[0]), k511 = vcreate_u64(k[1]);
+	uint64x1_t k191 = vcreate_u64(k[2]), k127 = vcreate_u64(k[3]);
+	uint64x2_t x0, x1, x2, x3;
+
+	x0 = veorq_u64(load_lane(p),
+		       vcombine_u64(vcreate_u64(crc), vcreate_u64(0)));
+	x1 = load_lane(p + 16);
+	x2 = load_lane(p + 32);
+	x3 = load_lane(p + 48);
+
+	while (--blocks) {
+		p += 64;
+		x0 = veorq_u64(fold(x0, k575, k511), load_lane(p));
+		x1 = veorq_u64(fold(x1, k575, k511), load_lane(p + 16));
+		x2 = veorq_u64(fold(x2, k575, k511), load_lane(p + 32));
+		x3 = veorq_u64(fold(x3, k575, k511), load_lane(p + 48));
+	}
+
+	x1 = veorq_u64(fold(x0, k191, k127), x1);
+	x2 = veorq_u64(fold(x1, k191, k127), x2);
+	x3 = veorq_u64(fold(x2, k191, k127), x3);
+
+	vst1q_u8(out, vreinterpretq_u8_u64(x3));
+}
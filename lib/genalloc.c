@@ -22,6 +22,17 @@
  * allocator in NMI handler should depend on
  * CONFIG_ARCH_HAVE_NMI_SAFE_CMPXCHG.
  *
+ * A pool can put per-CPU bins for the smallest sizes in front of the
+ * bitmap with gen_pool_enable_cache(). Each bin is a stack of free blocks
+ * of one exact size, so allocating or freeing such a block is a push or a
+ * pop under a per-CPU lock that is only contended when another CPU
+ * drains the bins. Bins are refilled with one bitmap allocation carved
+ * into several blocks, hold at most GEN_POOL_BIN_UNITS allocation units,
+ * and give half their blocks back to the bitmap when full. An allocation
+ * that fails drains the bins of all CPUs and retries. As blocks keep their
+ * exact size, bins may be enabled on a pool that is in use. Pools with
+ * bins can not be used in NMI handlers.
+ *
  * Copyright 2005 (C) Jes Sorensen <jes@trained-monkey.org>
  *
  * This source code is licensed under the GNU General Public License,
@@ -36,6 +47,23 @@
 #include <linux/genalloc.h>
 #include <linux/of_address.h>
 #include <linux/of_device.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/mutex.h>
+#include <linux/math64.h>
+
+#define GEN_POOL_BINS		16	/* one per size of 1..16 units */
+#define GEN_POOL_BIN_DEPTH	16
+#define GEN_POOL_BIN_UNITS	32	/* most units one bin may hold */
+
+struct gen_pool_cache {
+	spinlock_t lock;
+	unsigned int nr[GEN_POOL_BINS];
+	unsigned long addr[GEN_POOL_BINS][GEN_POOL_BIN_DEPTH];
+	unsigned long hits;
+	unsigned long misses;
+};
 
 static inline size_t chunk_size(const struct gen_pool_chunk *chunk)
 {
@@ -161,6 +189,8 @@ struct gen_pool *gen_pool_create(int min_alloc_order, int nid)
 		pool->min_alloc_order = min_alloc_order;
 		pool->algo = gen_pool_first_fit;
 		pool->data = NULL;
+		pool->cache = NULL;
+		pool->debugfs = NULL;
 	}
 	return pool;
 }
@@ -243,6 +273,12 @@ void gen_pool_destroy(struct gen_pool *pool)
 	int order = pool->min_alloc_order;
 	int bit, end_bit;
 
+	debugfs_remove(pool->debugfs);
+	if (pool->cache) {
+		gen_pool_drain_cache(pool);
+		free_percpu(pool->cache);
+	}
+
 	list_for_each_safe(_chunk, _next_chunk, &pool->chunks) {
 		chunk = list_entry(_chunk, struct gen_pool_chunk, next_chunk);
 		list_del(&chunk->next_chunk);
@@ -258,31 +294,14 @@ void gen_pool_destroy(struct gen_pool *pool)
 }
 EXPORT_SYMBOL(gen_pool_destroy);
 
-/**
- * gen_pool_alloc - allocate special memory from the pool
- * @pool: pool to allocate from
- * @size: number of bytes to allocate from the pool
- *
- * Allocate the requested number of bytes from the specified pool.
- * Uses the pool allocation function (with first-fit algorithm by default).
- * Can not be used in NMI handler on architectures without
- * NMI-safe cmpxchg implementation.
- */
-unsigned long gen_pool_alloc(struct gen_pool *pool, size_t size)
+static unsigned long gen_pool_alloc_bits(struct gen_pool *pool, int nbits)
 {
 	struct gen_pool_chunk *chunk;
 	unsigned long addr = 0;
 	int order = pool->min_alloc_order;
-	int nbits, start_bit = 0, end_bit, remain;
+	int start_bit = 0, end_bit, remain;
+	size_t size = (size_t)nbits << order;
 
-#ifndef CONFIG_ARCH_HAVE_NMI_SAFE_CMPXCHG
-	BUG_ON(in_nmi());
-#endif
-
-	if (size == 0)
-		return 0;
-
-	nbits = (size + (1UL << order) - 1) >> order;
 	rcu_read_lock();
 	list_for_each_entry_rcu(chunk, &pool->chunks, next_chunk) {
 		if (size > atomic_read(&chunk->avail))
@@ -303,13 +322,173 @@ retry:
 		}
 
 		addr = chunk->start_addr + ((unsigned long)start_bit << order);
-		size = nbits << order;
 		atomic_sub(size, &chunk->avail);
 		break;
 	}
 	rcu_read_unlock();
 	return addr;
 }
+
+static void gen_pool_free_bits(struct gen_pool *pool, unsigned long addr,
+			       int nbits)
+{
+	struct gen_pool_chunk *chunk;
+	int order = pool->min_alloc_order;
+	int start_bit, remain;
+	size_t size = (size_t)nbits << order;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(chunk, &pool->chunks, next_chunk) {
+		if (addr >= chunk->start_addr && addr <= chunk->end_addr) {
+			BUG_ON(addr + size - 1 > chunk->end_addr);
+			start_bit = (addr - chunk->start_addr) >> order;
+			remain = bitmap_clear_ll(chunk->bits, start_bit, nbits);
+			BUG_ON(remain);
+			atomic_add(size, &chunk->avail);
+			rcu_read_unlock();
+			return;
+		}
+	}
+	rcu_read_unlock();
+	BUG();
+}
+
+/* blocks a bin may hold, so that it stays within GEN_POOL_BIN_UNITS */
+static inline unsigned int gen_pool_bin_depth(int bin)
+{
+	return clamp_t(unsigned int, GEN_POOL_BIN_UNITS / (bin + 1), 2,
+		       GEN_POOL_BIN_DEPTH);
+}
+
+/* whether @nbits units at @addr are allocated in the bitmap */
+static bool gen_pool_bits_allocated(struct gen_pool *pool, unsigned long addr,
+				    int nbits)
+{
+	struct gen_pool_chunk *chunk;
+	int order = pool->min_alloc_order;
+	unsigned long start_bit;
+	bool ret = false;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(chunk, &pool->chunks, next_chunk) {
+		if (addr >= chunk->start_addr && addr <= chunk->end_addr) {
+			if (addr + ((size_t)nbits << order) - 1 >
+			    chunk->end_addr)
+				break;
+			start_bit = (addr - chunk->start_addr) >> order;
+			ret = find_next_zero_bit(chunk->bits, start_bit + nbits,
+						 start_bit) >= start_bit + nbits;
+			break;
+		}
+	}
+	rcu_read_unlock();
+	return ret;
+}
+
+/* give the oldest @nr blocks of a bin back to the bitmap */
+static void gen_pool_bin_flush(struct gen_pool *pool,
+			       struct gen_pool_cache *cache, int bin,
+			       unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		gen_pool_free_bits(pool, cache->addr[bin][i], bin + 1);
+	cache->nr[bin] -= nr;
+	memmove(cache->addr[bin], cache->addr[bin] + nr,
+		cache->nr[bin] * sizeof(cache->addr[bin][0]));
+}
+
+static unsigned long gen_pool_cache_alloc(struct gen_pool *pool, int nbits)
+{
+	struct gen_pool_cache *cache;
+	unsigned long flags, run, addr;
+	int order = pool->min_alloc_order;
+	int bin = nbits - 1, i, n;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(pool->cache);
+	spin_lock(&cache->lock);
+	if (cache->nr[bin]) {
+		cache->hits++;
+	} else {
+		/* one run carved into blocks, fewer if the pool is tight */
+		cache->misses++;
+		for (n = gen_pool_bin_depth(bin) / 2; n; n /= 2) {
+			run = gen_pool_alloc_bits(pool, n * nbits);
+			if (run)
+				break;
+		}
+		if (!n) {
+			spin_unlock_irqrestore(&cache->lock, flags);
+			return 0;
+		}
+		for (i = n - 1; i >= 0; i--)
+			cache->addr[bin][cache->nr[bin]++] =
+				run + ((unsigned long)(i * nbits) << order);
+	}
+	addr = cache->addr[bin][--cache->nr[bin]];
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	return addr;
+}
+
+static void gen_pool_cache_free(struct gen_pool *pool, unsigned long addr,
+				int nbits)
+{
+	struct gen_pool_cache *cache;
+	unsigned long flags;
+	unsigned int depth = gen_pool_bin_depth(nbits - 1);
+	int bin = nbits - 1;
+
+	/* don't let a bad free hide in a bin until it is flushed */
+	BUG_ON(!gen_pool_bits_allocated(pool, addr, nbits));
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(pool->cache);
+	spin_lock(&cache->lock);
+	if (cache->nr[bin] >= depth)
+		gen_pool_bin_flush(pool, cache, bin, depth / 2);
+	cache->addr[bin][cache->nr[bin]++] = addr;
+	spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+/**
+ * gen_pool_alloc - allocate special memory from the pool
+ * @pool: pool to allocate from
+ * @size: number of bytes to allocate from the pool
+ *
+ * Allocate the requested number of bytes from the specified pool.
+ * Uses the pool allocation function (with first-fit algorithm by default).
+ * Can not be used in NMI handler on architectures without
+ * NMI-safe cmpxchg implementation.
+ */
+unsigned long gen_pool_alloc(struct gen_pool *pool, size_t size)
+{
+	unsigned long addr;
+	int order = pool->min_alloc_order;
+	int nbits;
+
+#ifndef CONFIG_ARCH_HAVE_NMI_SAFE_CMPXCHG
+	BUG_ON(in_nmi());
+#endif
+
+	if (size == 0)
+		return 0;
+
+	nbits = (size + (1UL << order) - 1) >> order;
+	if (pool->cache && nbits <= GEN_POOL_BINS)
+		addr = gen_pool_cache_alloc(pool, nbits);
+	else
+		addr = gen_pool_alloc_bits(pool, nbits);
+
+	if (!addr && pool->cache) {
+		/* the space may be sitting in the bins of any CPU */
+		gen_pool_drain_cache(pool);
+		addr = gen_pool_alloc_bits(pool, nbits);
+	}
+	return addr;
+}
 EXPORT_SYMBOL(gen_pool_alloc);
 
 /**
@@ -353,33 +532,77 @@ EXPORT_SYMBOL(gen_pool_dma_alloc);
  */
 void gen_pool_free(struct gen_pool *pool, unsigned long addr, size_t size)
 {
-	struct gen_pool_chunk *chunk;
 	int order = pool->min_alloc_order;
-	int start_bit, nbits, remain;
+	int nbits;
 
 #ifndef CONFIG_ARCH_HAVE_NMI_SAFE_CMPXCHG
 	BUG_ON(in_nmi());
 #endif
 
 	nbits = (size + (1UL << order) - 1) >> order;
-	rcu_read_lock();
-	list_for_each_entry_rcu(chunk, &pool->chunks, next_chunk) {
-		if (addr >= chunk->start_addr && addr <= chunk->end_addr) {
-			BUG_ON(addr + size - 1 > chunk->end_addr);
-			start_bit = (addr - chunk->start_addr) >> order;
-			remain = bitmap_clear_ll(chunk->bits, start_bit, nbits);
-			BUG_ON(remain);
-			size = nbits << order;
-			atomic_add(size, &chunk->avail);
-			rcu_read_unlock();
-			return;
-		}
-	}
-	rcu_read_unlock();
-	BUG();
+	if (pool->cache && nbits && nbits <= GEN_POOL_BINS)
+		gen_pool_cache_free(pool, addr, nbits);
+	else
+		gen_pool_free_bits(pool, addr, nbits);
 }
 EXPORT_SYMBOL(gen_pool_free);
 
+/**
+ * gen_pool_enable_cache - put per-CPU size bins in front of a pool
+ * @pool: pool to enable the bins for
+ *
+ * Serve allocations of up to 16 allocation units from per-CPU bins of
+ * free blocks. Blocks sitting in the bins are accounted as allocated by
+ * gen_pool_avail(). Must not race with gen_pool_alloc() and
+ * gen_pool_free() on @pool.
+ *
+ * Returns 0 on success or -ENOMEM.
+ */
+int gen_pool_enable_cache(struct gen_pool *pool)
+{
+	struct gen_pool_cache __percpu *cache;
+	int cpu;
+
+	if (pool->cache)
+		return 0;
+
+	cache = alloc_percpu(struct gen_pool_cache);
+	if (!cache)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(cache, cpu)->lock);
+	pool->cache = cache;
+
+	return 0;
+}
+EXPORT_SYMBOL(gen_pool_enable_cache);
+
+/**
+ * gen_pool_drain_cache - return all binned blocks to the pool
+ * @pool: pool to drain
+ *
+ * Empties the bins of every CPU. May be called while other CPUs allocate
+ * from and free to @pool.
+ */
+void gen_pool_drain_cache(struct gen_pool *pool)
+{
+	struct gen_pool_cache *cache;
+	unsigned long flags;
+	int cpu, bin;
+
+	if (!pool->cache)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		cache = per_cpu_ptr(pool->cache, cpu);
+		spin_lock_irqsave(&cache->lock, flags);
+		for (bin = 0; bin < GEN_POOL_BINS; bin++)
+			gen_pool_bin_flush(pool, cache, bin, cache->nr[bin]);
+		spin_unlock_irqrestore(&cache->lock, flags);
+	}
+}
+EXPORT_SYMBOL(gen_pool_drain_cache);
+
 /**
  * gen_pool_for_each_chunk - call func for every chunk of generic memory pool
  * @pool:	the generic memory pool
@@ -440,6 +663,114 @@ size_t gen_pool_size(struct gen_pool *pool)
 }
 EXPORT_SYMBOL_GPL(gen_pool_size);
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *gen_pool_debugfs_root;
+static DEFINE_MUTEX(gen_pool_debugfs_lock);
+
+/*
+ * Free space is reported as the number of free extents and the largest of
+ * them; fragmentation is the share of free space outside the largest
+ * extent, i.e. 0% when all free space is in one piece.
+ */
+static int gen_pool_debugfs_show(struct seq_file *s, void *v)
+{
+	struct gen_pool *pool = s->private;
+	struct gen_pool_chunk *chunk;
+	struct gen_pool_cache *cache;
+	int order = pool->min_alloc_order;
+	unsigned long nbits, start, end, extents = 0, largest = 0;
+	unsigned long hits = 0, misses = 0, binned[GEN_POOL_BINS] = { 0 };
+	size_t size = 0, avail = 0, cached = 0;
+	int cpu, bin;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(chunk, &pool->chunks, next_chunk) {
+		size += chunk_size(chunk);
+		avail += atomic_read(&chunk->avail);
+		nbits = chunk_size(chunk) >> order;
+		for (start = find_first_zero_bit(chunk->bits, nbits);
+		     start < nbits;
+		     start = find_next_zero_bit(chunk->bits, nbits, end)) {
+			end = find_next_bit(chunk->bits, nbits, start);
+			largest = max(largest, end - start);
+			extents++;
+		}
+	}
+	rcu_read_unlock();
+
+	if (pool->cache) {
+		for_each_possible_cpu(cpu) {
+			cache = per_cpu_ptr(pool->cache, cpu);
+			for (bin = 0; bin < GEN_POOL_BINS; bin++)
+				binned[bin] += ACCESS_ONCE(cache->nr[bin]);
+			hits += ACCESS_ONCE(cache->hits);
+			misses += ACCESS_ONCE(cache->misses);
+		}
+		for (bin = 0; bin < GEN_POOL_BINS; bin++)
+			cached += (size_t)binned[bin] * (bin + 1) << order;
+	}
+
+	seq_printf(s, "size:          %zu\n", size);
+	seq_printf(s, "avail:         %zu\n", avail);
+	seq_printf(s, "cached:        %zu\n", cached);
+	seq_printf(s, "free extents:  %lu\n", extents);
+	seq_printf(s, "largest free:  %lu\n", largest << order);
+	seq_printf(s, "fragmentation: %lu%%\n", avail ?
+		   100 - (unsigned long)div_u64((u64)(largest << order) * 100,
+						avail) : 0);
+
+	if (!pool->cache)
+		return 0;
+
+	seq_printf(s, "cache hits:    %lu\n", hits);
+	seq_printf(s, "cache misses:  %lu\n", misses);
+	seq_puts(s, "bins:         ");
+	for (bin = 0; bin < GEN_POOL_BINS; bin++)
+		seq_printf(s, " %lu", binned[bin]);
+	seq_putc(s, '\n');
+
+	return 0;
+}
+
+static int gen_pool_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, gen_pool_debugfs_show, inode->i_private);
+}
+
+static const struct file_operations gen_pool_debugfs_fops = {
+	.open		= gen_pool_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/**
+ * gen_pool_debugfs_create - export pool statistics in debugfs
+ * @pool: pool to export
+ * @name: file name under <debugfs>/genalloc/
+ *
+ * The file is removed by gen_pool_destroy(). Failures are not reported,
+ * the pool works the same without its statistics.
+ */
+void gen_pool_debugfs_create(struct gen_pool *pool, const char *name)
+{
+	mutex_lock(&gen_pool_debugfs_lock);
+	if (!gen_pool_debugfs_root)
+		gen_pool_debugfs_root = debugfs_create_dir("genalloc", NULL);
+	if (!IS_ERR_OR_NULL(gen_pool_debugfs_root))
+		pool->debugfs = debugfs_create_file(name, S_IRUGO,
+						    gen_pool_debugfs_root,
+						    pool,
+						    &gen_pool_debugfs_fops);
+	mutex_unlock(&gen_pool_debugfs_lock);
+}
+#else
+void gen_pool_debugfs_create(struct gen_pool *pool, const char *name)
+{
+}
+#endif
+EXPORT_SYMBOL(gen_pool_debugfs_create);
+
 /**
  * gen_pool_set_algo - set the allocation algorithm
  * @pool: pool to change allocation algorithm
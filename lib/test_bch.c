@@ -0,0 +1,140 @@
+/*
+ * Kernel module for measuring BCH encoder/decoder throughput.
+ *
+ * Each code of m = 13 and t = 4, 8 and 16 bits is used to encode a set of
+ * random 512 byte sectors, the layout NAND soft ECC uses, and to correct
+ * them after t random bit flips.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/bch.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+
+#define BCH_TEST_M		13
+#define BCH_TEST_SECTOR		512
+#define BCH_TEST_SECTORS	16
+#define BCH_TEST_LOOPS		4096
+
+static int __init test_bch_code(int t, u8 *data, u8 *buf)
+{
+	struct bch_control *bch;
+	unsigned int *errloc;
+	u8 *ecc, *calc;
+	ktime_t start;
+	s64 enc_ns, dec_ns;
+	int i, j, n, bit, errors = 0;
+
+	bch = init_bch(BCH_TEST_M, t, 0);
+	if (!bch)
+		return -ENOMEM;
+
+	ecc = kzalloc(BCH_TEST_SECTORS * bch->ecc_bytes, GFP_KERNEL);
+	calc = kzalloc(bch->ecc_bytes, GFP_KERNEL);
+	errloc = kcalloc(t, sizeof(*errloc), GFP_KERNEL);
+	if (!ecc || !calc || !errloc) {
+		errors = -ENOMEM;
+		goto out;
+	}
+
+	start = ktime_get();
+	for (i = 0; i < BCH_TEST_LOOPS; i++) {
+		j = i % BCH_TEST_SECTORS;
+		memset(ecc + j * bch->ecc_bytes, 0, bch->ecc_bytes);
+		encode_bch(bch, data + j * BCH_TEST_SECTOR, BCH_TEST_SECTOR,
+			   ecc + j * bch->ecc_bytes);
+	}
+	enc_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	dec_ns = 0;
+	for (i = 0; i < BCH_TEST_SECTORS; i++) {
+		memcpy(buf, data + i * BCH_TEST_SECTOR, BCH_TEST_SECTOR);
+		for (j = 0; j < t; j++) {
+			/* flip t distinct bits */
+			do {
+				bit = prandom_u32() % (8 * BCH_TEST_SECTOR);
+			} while ((buf[bit / 8] ^ data[i * BCH_TEST_SECTOR +
+						      bit / 8]) & BIT(bit % 8));
+			buf[bit / 8] ^= BIT(bit % 8);
+		}
+
+		start = ktime_get();
+		memset(calc, 0, bch->ecc_bytes);
+		encode_bch(bch, buf, BCH_TEST_SECTOR, calc);
+		n = decode_bch(bch, NULL, BCH_TEST_SECTOR,
+			       ecc + i * bch->ecc_bytes, calc, NULL, errloc);
+		for (j = 0; j < n; j++)
+			if (errloc[j] < 8 * BCH_TEST_SECTOR)
+				buf[errloc[j] / 8] ^= BIT(errloc[j] % 8);
+		dec_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		if (n != t || memcmp(buf, data + i * BCH_TEST_SECTOR,
+				     BCH_TEST_SECTOR))
+			errors++;
+	}
+
+	/* bytes per usec is MB/s */
+	pr_info("t=%2d: encode %llu MB/s, correct %d bit errors in %llu ns/sector%s\n",
+		t, div64_s64((s64)BCH_TEST_LOOPS * BCH_TEST_SECTOR * 1000,
+			     enc_ns ?: 1),
+		t, div64_s64(dec_ns, BCH_TEST_SECTORS),
+		errors ? " (FAILED)" : "");
+out:
+	kfree(errloc);
+	kfree(calc);
+	kfree(ecc);
+	free_bch(bch);
+	return errors;
+}
+
+static int __init test_bch_init(void)
+{
+	static const int strengths[] = { 4, 8, 16 };
+	int i, err, failed = 0, ret = 0;
+	u8 *data, *buf;
+
+	data = kmalloc(BCH_TEST_SECTORS * BCH_TEST_SECTOR, GFP_KERNEL);
+	buf = kmalloc(BCH_TEST_SECTOR, GFP_KERNEL);
+	if (!data || !buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	prandom_bytes(data, BCH_TEST_SECTORS * BCH_TEST_SECTOR);
+
+	for (i = 0; i < ARRAY_SIZE(strengths); i++) {
+		err = test_bch_code(strengths[i], data, buf);
+		if (err < 0) {
+			ret = err;
+			goto out;
+		}
+		failed += err;
+	}
+
+	if (failed == 0)
+		pr_info("tests passed.\n");
+	else
+		ret = -EINVAL;
+out:
+	kfree(buf);
+	kfree(data);
+	return ret;
+}
+
+module_init(test_bch_init);
+
+static void __exit test_bch_exit(void)
+{
+	pr_info("unloaded.\n");
+}
+
+module_exit(test_bch_exit);
+
+MODULE_LICENSE("GPL");
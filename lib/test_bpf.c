@@ -0,0 +1,539 @@
+/*
+ * Kernel module for testing and timing BPF filters.
+ *
+ * Internal BPF programs covering the 64-bit ALU operations, division,
+ * jumps, the stack, atomic adds and packet loads are run through the
+ * interpreter and, where the architecture has one, the internal BPF JIT,
+ * and both results are checked. Classic filters go the same way after
+ * sk_convert_filter(). A port filter of the kind packet capture runs is
+ * then timed in the interpreter, the internal BPF JIT and whatever
+ * sk_unattached_filter_create() picks, and a seccomp whitelist in the
+ * interpreter and the JIT.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/in.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/seccomp.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+
+#define BPF_TEST_MAX_INSNS	16
+#define BPF_TEST_RUNS		100000
+#define BPF_TEST_SYSCALLS	32
+
+/* expected result of a filter returning the CPU it runs on */
+#define BPF_TEST_CPU		~0U
+
+#define I(CODE, A, X, OFF, IMM)						\
+	{ .code = (CODE), .a_reg = (A), .x_reg = (X), .off = (OFF),	\
+	  .imm = (IMM) }
+
+#define ALU64_K(OP, A, K)	I(BPF_ALU64 | BPF_##OP | BPF_K, A, 0, 0, K)
+#define ALU64_X(OP, A, X)	I(BPF_ALU64 | BPF_##OP | BPF_X, A, X, 0, 0)
+#define ALU32_K(OP, A, K)	I(BPF_ALU | BPF_##OP | BPF_K, A, 0, 0, K)
+#define ALU32_X(OP, A, X)	I(BPF_ALU | BPF_##OP | BPF_X, A, X, 0, 0)
+#define JMP_K(OP, A, K, OFF)	I(BPF_JMP | BPF_##OP | BPF_K, A, 0, OFF, K)
+#define JMP_X(OP, A, X, OFF)	I(BPF_JMP | BPF_##OP | BPF_X, A, X, OFF, 0)
+#define EXIT			I(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+
+typedef unsigned int (*bpf_skb_func_t)(const struct sk_buff *skb,
+				       const struct sock_filter_int *insnsi);
+typedef u32 (*bpf_seccomp_func_t)(const struct seccomp_data *sd,
+				  const struct sock_filter_int *insnsi);
+
+struct bpf_test {
+	const char *name;
+	struct sock_filter_int insns[BPF_TEST_MAX_INSNS];
+	u32 result;
+};
+
+/* an IPv4 DNS query from 10.0.0.1 to 10.0.0.2, padded to 60 bytes */
+static const u8 test_bpf_pkt[60] __initconst = {
+	0x00, 0x0a, 0x35, 0x00, 0x00, 0x01, 0x00, 0x0a, 0x35, 0x00, 0x00, 0x02,
+	0x08, 0x00, 0x45, 0x00, 0x00, 0x2e, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11,
+	0x00, 0x00, 0x0a, 0x00, 0x00, 0x01, 0x0a, 0x00, 0x00, 0x02, 0x12, 0x34,
+	0x00, 0x35, 0x00, 0x1a, 0x00, 0x00,
+};
+
+static struct bpf_test tests[] __initdata = {
+	{
+		"add carry",
+		{
+			ALU32_K(MOV, 0, 0xffffffff),
+			ALU64_K(ADD, 0, 1),
+			ALU64_K(RSH, 0, 32),
+			EXIT,
+		},
+		1,
+	}, {
+		"sub borrow",
+		{
+			ALU64_K(SUB, 0, 1),
+			ALU64_K(RSH, 0, 32),
+			EXIT,
+		},
+		0xffffffff,
+	}, {
+		"mul",
+		{
+			ALU32_K(MOV, 0, 0x12345678),
+			ALU64_K(MUL, 0, 0x10000),
+			ALU64_K(RSH, 0, 24),
+			EXIT,
+		},
+		0x123456,
+	}, {
+		"shift by register",
+		{
+			ALU64_K(MOV, 0, 1),
+			ALU32_K(MOV, 2, 40),
+			ALU64_X(LSH, 0, 2),
+			ALU32_K(MOV, 2, 39),
+			ALU64_X(RSH, 0, 2),
+			EXIT,
+		},
+		2,
+	}, {
+		"arsh",
+		{
+			ALU64_K(MOV, 0, 0x80),
+			ALU64_K(LSH, 0, 56),
+			ALU32_K(MOV, 3, 60),
+			ALU64_X(ARSH, 0, 3),
+			EXIT,
+		},
+		0xfffffff8,
+	}, {
+		"alu32 zero extends",
+		{
+			ALU64_K(MOV, 0, -1),
+			ALU32_K(ADD, 0, 0),
+			ALU64_K(ADD, 0, 1),
+			ALU64_K(RSH, 0, 32),
+			EXIT,
+		},
+		1,
+	}, {
+		"div and mod",
+		{
+			ALU32_K(MOV, 0, 1000003),
+			ALU32_K(MOV, 2, 7),
+			ALU32_X(DIV, 0, 2),
+			ALU32_K(MOD, 0, 1000),
+			EXIT,
+		},
+		857,
+	}, {
+		"div64",
+		{
+			ALU64_K(MOV, 0, 1),
+			ALU64_K(LSH, 0, 40),
+			ALU64_K(DIV, 0, 3),
+			ALU64_K(RSH, 0, 8),
+			EXIT,
+		},
+		0x55555555,
+	}, {
+		"div by zero",
+		{
+			ALU32_K(MOV, 0, 5),
+			ALU64_K(MOV, 8, 0),
+			ALU64_X(DIV, 0, 8),
+			EXIT,
+		},
+		0,
+	}, {
+		"signed and unsigned jumps",
+		{
+			ALU64_K(MOV, 0, -1),
+			ALU64_K(MOV, 2, 1),
+			ALU64_K(MOV, 3, 0),
+			JMP_X(JSGT, 0, 2, 1),
+			ALU64_K(ADD, 3, 1),
+			JMP_X(JGT, 0, 2, 1),
+			ALU64_K(ADD, 3, 2),
+			ALU64_X(MOV, 0, 3),
+			EXIT,
+		},
+		1,
+	}, {
+		"jeq high word",
+		{
+			ALU64_K(MOV, 0, 1),
+			ALU64_K(LSH, 0, 32),
+			JMP_K(JEQ, 0, 0, 2),
+			ALU32_K(MOV, 0, 1),
+			EXIT,
+			ALU32_K(MOV, 0, 2),
+			EXIT,
+		},
+		1,
+	}, {
+		"stack and xadd",
+		{
+			ALU32_K(MOV, 2, 0xffffffff),
+			I(BPF_STX | BPF_MEM | BPF_DW, FP_REG, 2, -512, 0),
+			ALU64_K(MOV, 3, 1),
+			I(BPF_STX | BPF_XADD | BPF_DW, FP_REG, 3, -512, 0),
+			I(BPF_ST | BPF_MEM | BPF_W, FP_REG, 0, -4, 7),
+			I(BPF_STX | BPF_XADD | BPF_W, FP_REG, 3, -4, 0),
+			I(BPF_LDX | BPF_MEM | BPF_DW, 0, FP_REG, -512, 0),
+			ALU64_K(RSH, 0, 32),
+			I(BPF_LDX | BPF_MEM | BPF_W, 4, FP_REG, -4, 0),
+			ALU64_X(ADD, 0, 4),
+			EXIT,
+		},
+		9,
+	}, {
+		"bswap",
+		{
+			ALU32_K(MOV, 0, 0x12345678),
+			I(BPF_ALU | BPF_END | BPF_TO_BE, 0, 0, 0, 64),
+			ALU64_K(RSH, 0, 32),
+			EXIT,
+		},
+		0x78563412,
+	}, {
+		"ld abs and ind",
+		{
+			ALU64_X(MOV, CTX_REG, ARG1_REG),
+			I(BPF_LD | BPF_ABS | BPF_H, 0, 0, 0, 12),
+			ALU64_X(MOV, 3, 0),
+			I(BPF_LD | BPF_ABS | BPF_B, 0, 0, 0, 23),
+			ALU64_X(ADD, 3, 0),
+			ALU32_K(MOV, 7, ETH_HLEN),
+			I(BPF_LD | BPF_IND | BPF_W, 0, 7, 0, 16),
+			ALU64_X(ADD, 0, 3),
+			EXIT,
+		},
+		0x0a000813,
+	}, {
+		"ld beyond the packet",
+		{
+			ALU64_X(MOV, CTX_REG, ARG1_REG),
+			ALU32_K(MOV, 0, 7),
+			I(BPF_LD | BPF_ABS | BPF_W, 0, 0, 0, 1000),
+			EXIT,
+		},
+		0,
+	}, {
+		"ld network header",
+		{
+			ALU64_X(MOV, CTX_REG, ARG1_REG),
+			I(BPF_LD | BPF_ABS | BPF_B, 0, 0, 0, SKF_NET_OFF + 9),
+			EXIT,
+		},
+		IPPROTO_UDP,
+	},
+};
+
+struct bpf_classic_test {
+	const char *name;
+	struct sock_filter insns[BPF_TEST_MAX_INSNS];
+	unsigned int len;
+	u32 result;
+};
+
+/* ip and (udp or tcp) and not a fragment and dst port 53 or 80 */
+static struct sock_filter port_filter[] __initdata = {
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 9),
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 1, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, 0, 6),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 20),
+	BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 4, 0),
+	BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, ETH_HLEN),
+	BPF_STMT(BPF_LD | BPF_H | BPF_IND, ETH_HLEN + 2),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 53, 2, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 80, 1, 0),
+	BPF_STMT(BPF_RET | BPF_K, 0),
+	BPF_STMT(BPF_RET | BPF_K, 0xffff),
+};
+
+static struct bpf_classic_test classic_tests[] __initdata = {
+	{
+		"scratch memory",
+		{
+			BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+			BPF_STMT(BPF_ST, 3),
+			BPF_STMT(BPF_LDX | BPF_MEM, 3),
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		5,
+		2 * sizeof(test_bpf_pkt),
+	}, {
+		/* a call to a helper */
+		"cpu",
+		{
+			BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+				 SKF_AD_OFF + SKF_AD_CPU),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		},
+		2,
+		BPF_TEST_CPU,
+	},
+};
+
+static struct sock_filter_int * __init
+test_bpf_convert(struct sock_filter *prog, int len, int *new_len)
+{
+	struct sock_filter_int *insns;
+
+	if (sk_convert_filter(prog, len, NULL, new_len))
+		return NULL;
+
+	insns = kcalloc(*new_len, sizeof(*insns), GFP_KERNEL);
+	if (insns && sk_convert_filter(prog, len, insns, new_len)) {
+		kfree(insns);
+		insns = NULL;
+	}
+	return insns;
+}
+
+static int __init test_bpf_check(const char *name,
+				 const struct sock_filter_int *insns,
+				 unsigned int len, struct sk_buff *skb,
+				 u32 result)
+{
+	bpf_skb_func_t jited;
+	u32 ret, ret_jited;
+	int errors = 0;
+
+	jited = bpf_int_jit_compile(insns, len);
+
+	preempt_disable();
+	if (result == BPF_TEST_CPU)
+		result = smp_processor_id();
+	ret = sk_run_filter_int_skb(skb, insns);
+	ret_jited = jited ? jited(skb, insns) : result;
+	preempt_enable();
+
+	if (ret != result) {
+		pr_err("%s: interpreter returned %#x, expected %#x\n",
+		       name, ret, result);
+		errors++;
+	}
+	if (ret_jited != result) {
+		pr_err("%s: JIT returned %#x, expected %#x\n",
+		       name, ret_jited, result);
+		errors++;
+	}
+	if (jited)
+		bpf_int_jit_free((void *)jited);
+	return errors;
+}
+
+static int __init test_bpf_vectors(struct sk_buff *skb)
+{
+	struct bpf_classic_test *t;
+	struct sock_filter_int *insns;
+	unsigned int len;
+	int i, new_len, errors = 0;
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		/* no internal instruction has a zero opcode */
+		for (len = BPF_TEST_MAX_INSNS; len > 0; len--)
+			if (tests[i].insns[len - 1].code)
+				break;
+		errors += test_bpf_check(tests[i].name, tests[i].insns, len,
+					 skb, tests[i].result);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(classic_tests); i++) {
+		t = &classic_tests[i];
+		insns = test_bpf_convert(t->insns, t->len, &new_len);
+		if (!insns) {
+			pr_err("%s: conversion failed\n", t->name);
+			errors++;
+			continue;
+		}
+		errors += test_bpf_check(t->name, insns, new_len, skb,
+					 t->result);
+		kfree(insns);
+	}
+	return errors;
+}
+
+static void __init test_bpf_report(const char *what, ktime_t start)
+{
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	u64 per_run = div64_s64(ns, BPF_TEST_RUNS);
+
+	pr_info("%s: %llu ns per run, %llu kpps\n", what, per_run,
+		per_run ? div64_u64(1000000, per_run) : 0);
+}
+
+static int __init test_bpf_time_filter(struct sk_buff *skb)
+{
+	struct sock_fprog fprog = {
+		.len = ARRAY_SIZE(port_filter),
+		.filter = port_filter,
+	};
+	struct sock_filter_int *insns;
+	struct sk_filter *fp;
+	bpf_skb_func_t jited;
+	ktime_t start;
+	int i, new_len, ret;
+
+	insns = test_bpf_convert(port_filter, ARRAY_SIZE(port_filter),
+				 &new_len);
+	if (!insns)
+		return -EINVAL;
+	if (test_bpf_check("port filter", insns, new_len, skb, 0xffff)) {
+		kfree(insns);
+		return -EINVAL;
+	}
+
+	start = ktime_get();
+	for (i = 0; i < BPF_TEST_RUNS; i++)
+		sk_run_filter_int_skb(skb, insns);
+	test_bpf_report("port filter, interpreter", start);
+
+	jited = bpf_int_jit_compile(insns, new_len);
+	if (jited) {
+		start = ktime_get();
+		for (i = 0; i < BPF_TEST_RUNS; i++)
+			jited(skb, insns);
+		test_bpf_report("port filter, internal JIT", start);
+		bpf_int_jit_free((void *)jited);
+	}
+	kfree(insns);
+
+	/* what a socket gets: the classic JIT first */
+	ret = sk_unattached_filter_create(&fp, &fprog);
+	if (ret)
+		return ret;
+	start = ktime_get();
+	for (i = 0; i < BPF_TEST_RUNS; i++)
+		SK_RUN_FILTER(fp, skb);
+	test_bpf_report(fp->jited ? "port filter, attached, JIT" :
+			"port filter, attached, interpreter", start);
+	sk_unattached_filter_destroy(fp);
+	return 0;
+}
+
+/* the program seccomp makes of a classic whitelist of system calls */
+static struct sock_filter_int * __init test_bpf_whitelist(int *len)
+{
+	struct sock_filter_int *insns, *insn;
+	int i;
+
+	*len = BPF_TEST_SYSCALLS + 6;
+	insns = kcalloc(*len, sizeof(*insns), GFP_KERNEL);
+	if (!insns)
+		return NULL;
+
+	insn = insns;
+	*insn++ = (struct sock_filter_int)ALU64_X(MOV, CTX_REG, ARG1_REG);
+	*insn++ = (struct sock_filter_int)I(BPF_LDX | BPF_MEM | BPF_W, 0,
+		CTX_REG, offsetof(struct seccomp_data, nr), 0);
+	for (i = 0; i < BPF_TEST_SYSCALLS; i++)
+		*insn++ = (struct sock_filter_int)JMP_K(JEQ, 0, 3 * i + 1,
+			BPF_TEST_SYSCALLS + 1 - i);
+	*insn++ = (struct sock_filter_int)ALU32_K(MOV, 0, SECCOMP_RET_KILL);
+	*insn++ = (struct sock_filter_int)EXIT;
+	*insn++ = (struct sock_filter_int)ALU32_K(MOV, 0, SECCOMP_RET_ALLOW);
+	*insn++ = (struct sock_filter_int)EXIT;
+	return insns;
+}
+
+static int __init test_bpf_time_seccomp(void)
+{
+	struct seccomp_data sd = { };
+	struct sock_filter_int *insns;
+	bpf_seccomp_func_t jited;
+	ktime_t start;
+	int i, len, errors = 0;
+
+	insns = test_bpf_whitelist(&len);
+	if (!insns)
+		return -ENOMEM;
+
+	jited = bpf_int_jit_compile(insns, len);
+
+	/* the last entry of the whitelist, and one not on it */
+	sd.nr = 3 * (BPF_TEST_SYSCALLS - 1) + 1;
+	if (sk_run_filter_int_seccomp(&sd, insns) != SECCOMP_RET_ALLOW ||
+	    (jited && jited(&sd, insns) != SECCOMP_RET_ALLOW))
+		errors++;
+	sd.nr = 3 * BPF_TEST_SYSCALLS;
+	if (sk_run_filter_int_seccomp(&sd, insns) != SECCOMP_RET_KILL ||
+	    (jited && jited(&sd, insns) != SECCOMP_RET_KILL))
+		errors++;
+	if (errors) {
+		pr_err("seccomp whitelist: wrong verdict\n");
+		goto out;
+	}
+
+	sd.nr = 3 * (BPF_TEST_SYSCALLS - 1) + 1;
+	start = ktime_get();
+	for (i = 0; i < BPF_TEST_RUNS; i++)
+		sk_run_filter_int_seccomp(&sd, insns);
+	test_bpf_report("seccomp whitelist, interpreter", start);
+
+	if (jited) {
+		start = ktime_get();
+		for (i = 0; i < BPF_TEST_RUNS; i++)
+			jited(&sd, insns);
+		test_bpf_report("seccomp whitelist, JIT", start);
+	}
+out:
+	if (jited)
+		bpf_int_jit_free((void *)jited);
+	kfree(insns);
+	return errors ? -EINVAL : 0;
+}
+
+static int __init test_bpf_init(void)
+{
+	struct sk_buff *skb;
+	int errors, ret;
+
+	skb = alloc_skb(sizeof(test_bpf_pkt), GFP_KERNEL);
+	if (!skb)
+		return -ENOMEM;
+	memcpy(skb_put(skb, sizeof(test_bpf_pkt)), test_bpf_pkt,
+	       sizeof(test_bpf_pkt));
+	skb_reset_mac_header(skb);
+	skb_set_network_header(skb, ETH_HLEN);
+	skb->protocol = htons(ETH_P_IP);
+
+	errors = test_bpf_vectors(skb);
+	if (errors) {
+		pr_err("%d vectors failed\n", errors);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = test_bpf_time_filter(skb);
+	if (!ret)
+		ret = test_bpf_time_seccomp();
+	if (!ret)
+		pr_info("tests passed.\n");
+out:
+	kfree_skb(skb);
+	return ret;
+}
+
+module_init(test_bpf_init);
+
+static void __exit test_bpf_exit(void)
+{
+	pr_info("unloaded.\n");
+}
+
+module_exit(test_bpf_exit);
+
+MODULE_LICENSE("GPL");
@@ -0,0 +1,106 @@
+/*
+ * Kernel module for measuring the CPU cost of ARM streaming DMA mappings.
+ *
+ * A buffer of each size is mapped and unmapped for a device using the
+ * default non-coherent ops, as a PL master on a Zynq HP port would, and
+ * using arm_coherent_dma_ops, as a master on the ACP would. The difference
+ * is the cache maintenance the coherent path skips.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/dma-mapping.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+
+#define DMA_TEST_MAX_SIZE	SZ_64K
+#define DMA_TEST_LOOPS		1024
+
+static s64 __init test_dma_map_one(struct device *dev, void *buf, size_t size,
+				   enum dma_data_direction dir)
+{
+	dma_addr_t addr;
+	ktime_t start;
+	s64 ns = 0;
+	int i;
+
+	for (i = 0; i < DMA_TEST_LOOPS; i++) {
+		/* dirty the buffer so that a clean has work to do */
+		memset(buf, i, size);
+
+		start = ktime_get();
+		addr = dma_map_single(dev, buf, size, dir);
+		if (dma_mapping_error(dev, addr))
+			return -ENOMEM;
+		dma_unmap_single(dev, addr, size, dir);
+		ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	}
+
+	return div_s64(ns, DMA_TEST_LOOPS);
+}
+
+static int __init test_dma_map_init(void)
+{
+	static const char * const dirs[] = {
+		[DMA_TO_DEVICE] = "to device",
+		[DMA_FROM_DEVICE] = "from device",
+	};
+	struct platform_device *pdev;
+	struct device *dev;
+	s64 ncoh, coh;
+	size_t size;
+	void *buf;
+	int dir, ret = 0;
+
+	pdev = platform_device_register_simple(KBUILD_MODNAME, -1, NULL, 0);
+	if (IS_ERR(pdev))
+		return PTR_ERR(pdev);
+	dev = &pdev->dev;
+	dev->dma_mask = &dev->coherent_dma_mask;
+	dma_set_mask_and_coherent(dev, DMA_BIT_MASK(32));
+
+	buf = kmalloc(DMA_TEST_MAX_SIZE, GFP_KERNEL);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (dir = DMA_TO_DEVICE; dir <= DMA_FROM_DEVICE; dir++) {
+		for (size = 64; size <= DMA_TEST_MAX_SIZE; size *= 4) {
+			set_dma_ops(dev, &arm_dma_ops);
+			ncoh = test_dma_map_one(dev, buf, size, dir);
+			set_dma_ops(dev, &arm_coherent_dma_ops);
+			coh = test_dma_map_one(dev, buf, size, dir);
+			if (ncoh < 0 || coh < 0) {
+				ret = -ENOMEM;
+				goto out;
+			}
+
+			pr_info("%-11s %6zu bytes: non-coherent %lld ns, coherent %lld ns per map/unmap\n",
+				dirs[dir], size, ncoh, coh);
+		}
+	}
+out:
+	kfree(buf);
+	platform_device_unregister(pdev);
+	return ret;
+}
+
+module_init(test_dma_map_init);
+
+static void __exit test_dma_map_exit(void)
+{
+	pr_info("unloaded.\n");
+}
+
+module_exit(test_dma_map_exit);
+
+MODULE_LICENSE("GPL");
@@ -0,0 +1,210 @@
+/*
+ * Kernel module for measuring genalloc allocation cost.
+ *
+ * A 256KiB pool of 32 byte units, the granularity of the Zynq OCM pool,
+ * is fragmented with blocks of one to four units of which every other one
+ * is freed again. Small blocks are then allocated and freed, keeping up to
+ * 64 of them live, once on the bitmap alone and once through the per-CPU
+ * size bins. Every block is checked against a shadow bitmap for overlaps,
+ * and all memory must be back in the pool at the end.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/bitmap.h>
+#include <linux/genalloc.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+#define GENALLOC_TEST_ORDER	5
+#define GENALLOC_TEST_SIZE	(256 * 1024)
+#define GENALLOC_TEST_UNITS	(GENALLOC_TEST_SIZE >> GENALLOC_TEST_ORDER)
+#define GENALLOC_TEST_FRAG	2048
+#define GENALLOC_TEST_LIVE	64
+#define GENALLOC_TEST_LOOPS	65536
+
+struct test_genalloc {
+	struct gen_pool *pool;
+	unsigned long base;
+	unsigned long *shadow;
+	unsigned long frag[GENALLOC_TEST_FRAG];
+	size_t frag_size[GENALLOC_TEST_FRAG];
+	unsigned long live[GENALLOC_TEST_LIVE];
+	size_t live_size[GENALLOC_TEST_LIVE];
+};
+
+/* mark a block in the shadow bitmap, returns false if it overlaps */
+static bool __init test_genalloc_mark(struct test_genalloc *t,
+				      unsigned long addr, size_t size)
+{
+	unsigned long start = (addr - t->base) >> GENALLOC_TEST_ORDER;
+	unsigned long nr = size >> GENALLOC_TEST_ORDER;
+
+	if (addr < t->base || start + nr > GENALLOC_TEST_UNITS)
+		return false;
+	if (find_next_bit(t->shadow, start + nr, start) < start + nr)
+		return false;
+	bitmap_set(t->shadow, start, nr);
+	return true;
+}
+
+static void __init test_genalloc_unmark(struct test_genalloc *t,
+					unsigned long addr, size_t size)
+{
+	bitmap_clear(t->shadow, (addr - t->base) >> GENALLOC_TEST_ORDER,
+		     size >> GENALLOC_TEST_ORDER);
+}
+
+static void __init test_genalloc_largest(struct gen_pool *pool,
+					 struct gen_pool_chunk *chunk,
+					 void *data)
+{
+	unsigned long *largest = data, start, end = 0;
+	unsigned long nbits = (chunk->end_addr - chunk->start_addr + 1) >>
+			      pool->min_alloc_order;
+
+	while ((start = find_next_zero_bit(chunk->bits, nbits, end)) < nbits) {
+		end = find_next_bit(chunk->bits, nbits, start);
+		*largest = max(*largest, end - start);
+	}
+}
+
+static int __init test_genalloc_fragment(struct test_genalloc *t)
+{
+	int i;
+
+	for (i = 0; i < GENALLOC_TEST_FRAG; i++) {
+		t->frag_size[i] = (1 + prandom_u32() % 4) << GENALLOC_TEST_ORDER;
+		t->frag[i] = gen_pool_alloc(t->pool, t->frag_size[i]);
+		if (!t->frag[i] ||
+		    !test_genalloc_mark(t, t->frag[i], t->frag_size[i]))
+			return -EINVAL;
+	}
+	for (i = 0; i < GENALLOC_TEST_FRAG; i += 2) {
+		test_genalloc_unmark(t, t->frag[i], t->frag_size[i]);
+		gen_pool_free(t->pool, t->frag[i], t->frag_size[i]);
+		t->frag[i] = 0;
+	}
+	return 0;
+}
+
+static int __init test_genalloc_run(struct test_genalloc *t, const char *what)
+{
+	ktime_t start;
+	s64 ns;
+	int i, j, errors = 0;
+
+	memset(t->live, 0, sizeof(t->live));
+
+	start = ktime_get();
+	for (i = 0; i < GENALLOC_TEST_LOOPS; i++) {
+		j = i % GENALLOC_TEST_LIVE;
+		if (t->live[j]) {
+			test_genalloc_unmark(t, t->live[j], t->live_size[j]);
+			gen_pool_free(t->pool, t->live[j], t->live_size[j]);
+		}
+		/* 32 to 256 byte descriptors */
+		t->live_size[j] = (1 + i % 8) << GENALLOC_TEST_ORDER;
+		t->live[j] = gen_pool_alloc(t->pool, t->live_size[j]);
+		if (!t->live[j] ||
+		    !test_genalloc_mark(t, t->live[j], t->live_size[j])) {
+			t->live[j] = 0;
+			errors++;
+		}
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	for (j = 0; j < GENALLOC_TEST_LIVE; j++) {
+		if (!t->live[j])
+			continue;
+		test_genalloc_unmark(t, t->live[j], t->live_size[j]);
+		gen_pool_free(t->pool, t->live[j], t->live_size[j]);
+	}
+
+	pr_info("%s: %llu ns per alloc/free pair%s\n", what,
+		div64_s64(ns, GENALLOC_TEST_LOOPS), errors ? " (FAILED)" : "");
+	return errors;
+}
+
+static int __init test_genalloc_init(void)
+{
+	struct test_genalloc *t;
+	unsigned long largest = 0;
+	size_t avail;
+	int i, errors = 0, ret = 0;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+
+	t->shadow = kcalloc(BITS_TO_LONGS(GENALLOC_TEST_UNITS),
+			    sizeof(long), GFP_KERNEL);
+	t->base = (unsigned long)vmalloc(GENALLOC_TEST_SIZE);
+	t->pool = gen_pool_create(GENALLOC_TEST_ORDER, -1);
+	if (!t->shadow || !t->base || !t->pool) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	ret = gen_pool_add(t->pool, t->base, GENALLOC_TEST_SIZE, -1);
+	if (ret)
+		goto out;
+
+	ret = test_genalloc_fragment(t);
+	if (ret) {
+		pr_err("failed to fragment the pool\n");
+		goto out;
+	}
+	avail = gen_pool_avail(t->pool);
+	gen_pool_for_each_chunk(t->pool, test_genalloc_largest, &largest);
+	pr_info("fragmented: %zu bytes free, largest free block %lu bytes\n",
+		avail, largest << GENALLOC_TEST_ORDER);
+
+	errors += test_genalloc_run(t, "bitmap");
+
+	ret = gen_pool_enable_cache(t->pool);
+	if (ret)
+		goto out;
+	errors += test_genalloc_run(t, "bins  ");
+
+	gen_pool_drain_cache(t->pool);
+	if (gen_pool_avail(t->pool) != avail) {
+		pr_err("leaked %zu bytes\n", avail - gen_pool_avail(t->pool));
+		errors++;
+	}
+
+	if (errors == 0)
+		pr_info("tests passed.\n");
+	else
+		ret = -EINVAL;
+out:
+	if (t->pool) {
+		for (i = 0; i < GENALLOC_TEST_FRAG; i++)
+			if (t->frag[i])
+				gen_pool_free(t->pool, t->frag[i],
+					      t->frag_size[i]);
+		gen_pool_destroy(t->pool);
+	}
+	vfree((void *)t->base);
+	kfree(t->shadow);
+	kfree(t);
+	return ret;
+}
+
+module_init(test_genalloc_init);
+
+static void __exit test_genalloc_exit(void)
+{
+	pr_info("unloaded.\n");
+}
+
+module_exit(test_genalloc_exit);
+
+MODULE_LICENSE("GPL");
@@ -568,12 +568,28 @@ load_byte:
 u32 sk_run_filter_int_seccomp(const struct seccomp_data *ctx,
 			      const struct sock_filter_int *insni)
     __attribute__ ((alias ("__sk_run_filter")));
+EXPORT_SYMBOL_GPL(sk_run_filter_int_seccomp);
 
 u32 sk_run_filter_int_skb(const struct sk_buff *ctx,
 			  const struct sock_filter_int *insni)
     __attribute__ ((alias ("__sk_run_filter")));
 EXPORT_SYMBOL_GPL(sk_run_filter_int_skb);
 
+#ifdef CONFIG_BPF_JIT
+/* For architectures whose JIT only handles classic BPF. */
+void * __weak bpf_int_jit_compile(const struct sock_filter_int *insnsi,
+				  unsigned int len)
+{
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(bpf_int_jit_compile);
+
+void __weak bpf_int_jit_free(void *image)
+{
+}
+EXPORT_SYMBOL_GPL(bpf_int_jit_free);
+#endif
+
 /* Helper to find the offset of pkt_type in sk_buff structure. We want
  * to make sure its still a 3bit field starting at a byte boundary;
  * taken from arch/x86/net/bpf_jit_comp.c.
@@ -1154,6 +1170,7 @@ err:
 	kfree(addrs);
 	return -EINVAL;
 }
+EXPORT_SYMBOL_GPL(sk_convert_filter);
 
 /* Security:
  *
@@ -1479,6 +1496,7 @@ static struct sk_filter *__sk_migrate_filter(struct sk_filter *fp,
 	struct sock_filter *old_prog;
 	struct sk_filter *old_fp;
 	int i, err, new_len, old_len = fp->len;
+	void *image;
 
 	/* We are free to overwrite insns et al right here as it
 	 * won't be used at this point in time anymore internally
@@ -1537,6 +1555,13 @@ static struct sk_filter *__sk_migrate_filter(struct sk_filter *fp,
 		goto out_err_free;
 
 	kfree(old_prog);
+
+	/* The classic JIT declined the filter, try the internal BPF one. */
+	image = bpf_int_jit_compile(fp->insnsi, fp->len);
+	if (image) {
+		fp->bpf_func = image;
+		fp->jited = 1;
+	}
 	return fp;
 
 out_err_free:
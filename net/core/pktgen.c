@@ -150,6 +150,7 @@
 #include <linux/in.h>
 #include <linux/ip.h>
 #include <linux/ipv6.h>
+#include <linux/jhash.h>
 #include <linux/udp.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
@@ -159,6 +160,7 @@
 #include <linux/prefetch.h>
 #include <net/net_namespace.h>
 #include <net/checksum.h>
+#include <net/ip.h>
 #include <net/ipv6.h>
 #include <net/udp.h>
 #include <net/ip6_checksum.h>
@@ -176,7 +178,7 @@
 #include <asm/dma.h>
 #include <asm/div64.h>		/* do_div */
 
-#define VERSION	"2.74"
+#define VERSION	"2.75"
 #define IP_NAME_SZ 32
 #define MAX_MPLS_LABELS 16 /* This is the max label stack depth */
 #define MPLS_STACK_BOTTOM htonl(0x00000100)
@@ -411,6 +413,7 @@ struct pktgen_net {
 	struct proc_dir_entry	*proc_dir;
 	struct list_head	pktgen_threads;
 	bool			pktgen_exiting;
+	struct pktgen_rx	*rx;		/* receive side, if enabled */
 };
 
 struct pktgen_thread {
@@ -1866,6 +1869,403 @@ static const struct file_operations pktgen_thread_fops = {
 	.release = single_release,
 };
 
+/*
+ * Receive side.
+ *
+ * Writing "rx <ifname>" to /proc/net/pktgen/pgrx hooks the IPv4 and IPv6
+ * receive path of the device and picks out UDP packets that carry a
+ * pktgen header.  Each flow, told apart by its addresses and UDP ports,
+ * counts lost and reordered packets by the sequence number and keeps a
+ * histogram of the one-way latency.  The latency runs from the transmit
+ * timestamp to the receive timestamp that netif_receive_skb() takes when
+ * the driver hands the packet up.  It only means something if sender and
+ * receiver share a clock, as over loopback or a veth pair, or keep their
+ * clocks synchronized.  The sender stamps in microseconds.
+ *
+ * Sequence numbers are per pktgen device, so loss and reordering are exact
+ * for a device sending one flow with clone_skb 0.
+ *
+ * "rx_reset" clears the statistics, "rx_disable" unhooks the device.
+ */
+#define PGRX		"pgrx"
+#define RX_FLOWS	256
+#define RX_HASH_BITS	6
+#define RX_HIST		21	/* < 1us, then up to 2^i us, the last open */
+
+struct pktgen_rx_key {
+	__be32 saddr[4];
+	__be32 daddr[4];
+	__be16 sport;
+	__be16 dport;
+};
+
+struct pktgen_rx_flow {
+	struct hlist_node node;
+	struct pktgen_rx_key key;
+	int family;
+
+	u64 packets;
+	u64 bytes;
+	u64 lost;
+	u64 reordered;
+	u64 skew;		/* latency below 0, clocks not in sync */
+	u32 next_seq;
+
+	ktime_t first;
+	ktime_t last;
+	u64 lat_min;		/* nanoseconds */
+	u64 lat_max;
+	u64 lat_sum;
+	u64 hist[RX_HIST];
+};
+
+struct pktgen_rx {
+	struct net_device *dev;
+	struct packet_type pt_ip;
+	struct packet_type pt_ipv6;
+
+	spinlock_t lock;	/* flows and their statistics */
+	unsigned int nr_flows;
+	u64 untracked;		/* packets of flows beyond RX_FLOWS */
+	struct hlist_head hash[1 << RX_HASH_BITS];
+	struct pktgen_rx_flow flows[RX_FLOWS];
+};
+
+static struct pktgen_rx_flow *pktgen_rx_flow(struct pktgen_rx *rx,
+					     const struct pktgen_rx_key *key,
+					     int family)
+{
+	struct pktgen_rx_flow *flow;
+	struct hlist_head *head;
+
+	head = &rx->hash[jhash2((const u32 *)key, sizeof(*key) / 4, 0) &
+			 ((1 << RX_HASH_BITS) - 1)];
+	hlist_for_each_entry(flow, head, node)
+		if (!memcmp(&flow->key, key, sizeof(*key)))
+			return flow;
+
+	if (rx->nr_flows == RX_FLOWS)
+		return NULL;
+
+	flow = &rx->flows[rx->nr_flows++];
+	flow->key = *key;
+	flow->family = family;
+	hlist_add_head(&flow->node, head);
+	return flow;
+}
+
+static void pktgen_rx_account(struct pktgen_rx_flow *flow, u32 seq,
+			      unsigned int len, ktime_t now, s64 lat)
+{
+	unsigned int bucket;
+
+	if (!flow->packets) {
+		flow->first = now;
+		flow->lat_min = ULLONG_MAX;
+	} else if (seq != flow->next_seq) {
+		if ((s32)(seq - flow->next_seq) > 0) {
+			flow->lost += seq - flow->next_seq;
+		} else {
+			/* late, it was counted as lost */
+			flow->reordered++;
+			if (flow->lost)
+				flow->lost--;
+			seq = flow->next_seq - 1;
+		}
+	}
+	flow->next_seq = seq + 1;
+
+	flow->packets++;
+	flow->bytes += len;
+	flow->last = now;
+
+	if (lat < 0) {
+		flow->skew++;
+		lat = 0;
+	}
+	flow->lat_min = min_t(u64, flow->lat_min, lat);
+	flow->lat_max = max_t(u64, flow->lat_max, lat);
+	flow->lat_sum += lat;
+
+	if (lat < NSEC_PER_USEC)
+		bucket = 0;
+	else
+		bucket = min(ilog2(div_u64(lat, NSEC_PER_USEC)) + 1,
+			     RX_HIST - 1);
+	flow->hist[bucket]++;
+}
+
+static int pktgen_rcv(struct sk_buff *skb, struct net_device *dev,
+		      struct packet_type *pt, struct net_device *orig_dev)
+{
+	struct pktgen_rx_key key;
+	struct pktgen_rx_flow *flow;
+	struct pktgen_rx *rx;
+	struct pktgen_hdr _pgh;
+	const struct pktgen_hdr *pgh;
+	struct udphdr _uh;
+	const struct udphdr *uh;
+	unsigned int off;
+	ktime_t now, sent;
+	int family;
+
+	/* stamped by netif_receive_skb(), unless timestamps were off then */
+	now = skb->tstamp.tv64 ? skb->tstamp : ktime_get_real();
+
+	memset(&key, 0, sizeof(key));
+	if (pt->type == htons(ETH_P_IP)) {
+		struct iphdr _iph;
+		const struct iphdr *iph;
+
+		rx = container_of(pt, struct pktgen_rx, pt_ip);
+		iph = skb_header_pointer(skb, 0, sizeof(_iph), &_iph);
+		if (!iph || iph->protocol != IPPROTO_UDP || ip_is_fragment(iph))
+			goto out;
+		off = iph->ihl * 4;
+		key.saddr[0] = iph->saddr;
+		key.daddr[0] = iph->daddr;
+		family = AF_INET;
+	} else {
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6h;
+
+		rx = container_of(pt, struct pktgen_rx, pt_ipv6);
+		ip6h = skb_header_pointer(skb, 0, sizeof(_ip6h), &_ip6h);
+		if (!ip6h || ip6h->nexthdr != IPPROTO_UDP)
+			goto out;
+		off = sizeof(*ip6h);
+		memcpy(key.saddr, &ip6h->saddr, sizeof(key.saddr));
+		memcpy(key.daddr, &ip6h->daddr, sizeof(key.daddr));
+		family = AF_INET6;
+	}
+
+	uh = skb_header_pointer(skb, off, sizeof(_uh), &_uh);
+	pgh = skb_header_pointer(skb, off + sizeof(_uh), sizeof(_pgh), &_pgh);
+	if (!uh || !pgh || pgh->pgh_magic != htonl(PKTGEN_MAGIC))
+		goto out;
+	key.sport = uh->source;
+	key.dport = uh->dest;
+	sent = ktime_set(ntohl(pgh->tv_sec),
+			 ntohl(pgh->tv_usec) * NSEC_PER_USEC);
+
+	spin_lock(&rx->lock);
+	flow = pktgen_rx_flow(rx, &key, family);
+	if (flow)
+		pktgen_rx_account(flow, ntohl(pgh->seq_num), skb->len, now,
+				  ktime_to_ns(ktime_sub(now, sent)));
+	else
+		rx->untracked++;
+	spin_unlock(&rx->lock);
+out:
+	consume_skb(skb);
+	return NET_RX_SUCCESS;
+}
+
+/* Called with pktgen_thread_lock held */
+static void pktgen_rx_stop(struct pktgen_net *pn)
+{
+	struct pktgen_rx *rx = pn->rx;
+
+	if (!rx)
+		return;
+
+	pn->rx = NULL;
+	__dev_remove_pack(&rx->pt_ip);
+	__dev_remove_pack(&rx->pt_ipv6);
+	synchronize_net();
+	net_disable_timestamp();
+	dev_put(rx->dev);
+	vfree(rx);
+}
+
+/* Called with pktgen_thread_lock held */
+static int pktgen_rx_start(struct pktgen_net *pn, const char *ifname)
+{
+	struct net_device *dev;
+	struct pktgen_rx *rx;
+
+	dev = dev_get_by_name(pn->net, ifname);
+	if (!dev)
+		return -ENODEV;
+
+	rx = vzalloc(sizeof(*rx));
+	if (!rx) {
+		dev_put(dev);
+		return -ENOMEM;
+	}
+
+	pktgen_rx_stop(pn);
+
+	rx->dev = dev;
+	spin_lock_init(&rx->lock);
+	rx->pt_ip.type = htons(ETH_P_IP);
+	rx->pt_ip.dev = dev;
+	rx->pt_ip.func = pktgen_rcv;
+	rx->pt_ipv6.type = htons(ETH_P_IPV6);
+	rx->pt_ipv6.dev = dev;
+	rx->pt_ipv6.func = pktgen_rcv;
+
+	/* have netif_receive_skb() stamp every packet */
+	net_enable_timestamp();
+	dev_add_pack(&rx->pt_ip);
+	dev_add_pack(&rx->pt_ipv6);
+	pn->rx = rx;
+	return 0;
+}
+
+static void pktgen_rx_reset(struct pktgen_net *pn)
+{
+	struct pktgen_rx *rx = pn->rx;
+
+	if (!rx)
+		return;
+
+	spin_lock_bh(&rx->lock);
+	memset(rx->hash, 0, sizeof(rx->hash));
+	memset(rx->flows, 0, sizeof(rx->flows));
+	rx->nr_flows = 0;
+	rx->untracked = 0;
+	spin_unlock_bh(&rx->lock);
+}
+
+static void pktgen_rx_show_flow(struct seq_file *seq,
+				const struct pktgen_rx_flow *flow)
+{
+	u64 ns = ktime_to_ns(ktime_sub(flow->last, flow->first));
+	int i;
+
+	if (flow->family == AF_INET)
+		seq_printf(seq, "%pI4:%u -> %pI4:%u\n",
+			   &flow->key.saddr[0], ntohs(flow->key.sport),
+			   &flow->key.daddr[0], ntohs(flow->key.dport));
+	else
+		seq_printf(seq, "[%pI6c]:%u -> [%pI6c]:%u\n",
+			   flow->key.saddr, ntohs(flow->key.sport),
+			   flow->key.daddr, ntohs(flow->key.dport));
+
+	seq_printf(seq,
+		   "     packets: %llu  bytes: %llu  lost: %llu  reordered: %llu  skew: %llu\n",
+		   flow->packets, flow->bytes, flow->lost, flow->reordered,
+		   flow->skew);
+	/* the first packet starts the clock */
+	if (ns)
+		seq_printf(seq, "     %llupps over %lluus\n",
+			   div64_u64((flow->packets - 1) * NSEC_PER_SEC, ns),
+			   div_u64(ns, NSEC_PER_USEC));
+	seq_printf(seq, "     latency(ns): min %llu  avg %llu  max %llu\n",
+		   flow->lat_min, div64_u64(flow->lat_sum, flow->packets),
+		   flow->lat_max);
+
+	seq_puts(seq, "     hist(us):");
+	for (i = 0; i < RX_HIST; i++) {
+		if (!flow->hist[i])
+			continue;
+		if (i == 0)
+			seq_printf(seq, " <1:%llu", flow->hist[i]);
+		else if (i == RX_HIST - 1)
+			seq_printf(seq, " >=%u:%llu", 1U << (i - 1),
+				   flow->hist[i]);
+		else
+			seq_printf(seq, " %u-%u:%llu", 1U << (i - 1), 1U << i,
+				   flow->hist[i]);
+	}
+	seq_puts(seq, "\n");
+}
+
+static int pgrx_show(struct seq_file *seq, void *v)
+{
+	struct pktgen_net *pn = seq->private;
+	struct pktgen_rx_flow *flow;
+	struct pktgen_rx *rx;
+	unsigned int i, nr_flows;
+	u64 untracked;
+
+	flow = kmalloc(sizeof(*flow), GFP_KERNEL);
+	if (!flow)
+		return -ENOMEM;
+
+	mutex_lock(&pktgen_thread_lock);
+	rx = pn->rx;
+	if (!rx) {
+		seq_puts(seq, "Not receiving\n");
+		goto out;
+	}
+
+	spin_lock_bh(&rx->lock);
+	nr_flows = rx->nr_flows;
+	untracked = rx->untracked;
+	spin_unlock_bh(&rx->lock);
+
+	seq_printf(seq, "Receiving on %s, %u flows, %llu packets untracked\n",
+		   rx->dev->name, nr_flows, untracked);
+
+	for (i = 0; i < nr_flows; i++) {
+		spin_lock_bh(&rx->lock);
+		/* a reset since */
+		if (i >= rx->nr_flows) {
+			spin_unlock_bh(&rx->lock);
+			break;
+		}
+		*flow = rx->flows[i];
+		spin_unlock_bh(&rx->lock);
+		pktgen_rx_show_flow(seq, flow);
+	}
+out:
+	mutex_unlock(&pktgen_thread_lock);
+	kfree(flow);
+	return 0;
+}
+
+static ssize_t pgrx_write(struct file *file, const char __user *buf,
+			  size_t count, loff_t *ppos)
+{
+	struct seq_file *seq = file->private_data;
+	struct pktgen_net *pn = seq->private;
+	char data[32 + IFNAMSIZ];
+	int ret = 0;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (count == 0)
+		return -EINVAL;
+
+	if (count > sizeof(data))
+		count = sizeof(data);
+
+	if (copy_from_user(data, buf, count))
+		return -EFAULT;
+
+	data[count - 1] = 0;	/* Strip trailing '\n' and terminate string */
+
+	mutex_lock(&pktgen_thread_lock);
+	if (!strncmp(data, "rx ", 3))
+		ret = pktgen_rx_start(pn, strim(data + 3));
+	else if (!strcmp(data, "rx_reset"))
+		pktgen_rx_reset(pn);
+	else if (!strcmp(data, "rx_disable"))
+		pktgen_rx_stop(pn);
+	else
+		ret = -EINVAL;
+	mutex_unlock(&pktgen_thread_lock);
+
+	return ret ? ret : count;
+}
+
+static int pgrx_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pgrx_show, PDE_DATA(inode));
+}
+
+static const struct file_operations pktgen_rx_fops = {
+	.owner   = THIS_MODULE,
+	.open    = pgrx_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.write   = pgrx_write,
+	.release = single_release,
+};
+
 /* Think find or remove for NN */
 static struct pktgen_dev *__pktgen_NN_threads(const struct pktgen_net *pn,
 					      const char *ifname, int remove)
@@ -1969,6 +2369,10 @@ static int pktgen_device_event(struct notifier_block *unused,
 
 	case NETDEV_UNREGISTER:
 		pktgen_mark_device(pn, dev->name);
+		mutex_lock(&pktgen_thread_lock);
+		if (pn->rx && pn->rx->dev == dev)
+			pktgen_rx_stop(pn);
+		mutex_unlock(&pktgen_thread_lock);
 		break;
 	}
 
@@ -3736,6 +4140,12 @@ static int __net_init pg_net_init(struct net *net)
 		ret = -EINVAL;
 		goto remove;
 	}
+	pe = proc_create_data(PGRX, 0600, pn->proc_dir, &pktgen_rx_fops, pn);
+	if (pe == NULL) {
+		pr_err("cannot create %s procfs entry\n", PGRX);
+		ret = -EINVAL;
+		goto remove_entry;
+	}
 
 	for_each_online_cpu(cpu) {
 		int err;
@@ -3749,11 +4159,13 @@ static int __net_init pg_net_init(struct net *net)
 	if (list_empty(&pn->pktgen_threads)) {
 		pr_err("Initialization failed for all threads\n");
 		ret = -ENODEV;
-		goto remove_entry;
+		goto remove_rx_entry;
 	}
 
 	return 0;
 
+remove_rx_entry:
+	remove_proc_entry(PGRX, pn->proc_dir);
 remove_entry:
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 remove:
@@ -3773,6 +4185,7 @@ static void __net_exit pg_net_exit(struct net *net)
 
 	mutex_lock(&pktgen_thread_lock);
 	list_splice_init(&pn->pktgen_threads, &list);
+	pktgen_rx_stop(pn);
 	mutex_unlock(&pktgen_thread_lock);
 
 	list_for_each_safe(q, n, &list) {
@@ -3782,6 +4195,7 @@ static void __net_exit pg_net_exit(struct net *net)
 		kfree(t);
 	}
 
+	remove_proc_entry(PGRX, pn->proc_dir);
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 	remove_proc_entry(PG_PROC_DIR, pn->net->proc_net);
 }
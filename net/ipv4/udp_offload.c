@@ -47,6 +47,97 @@ static int udp4_ufo_send_check(struct sk_buff *skb)
 	return 0;
 }
 
+/* Cut a UDP_SEGMENT datagram into gso_size datagrams, each with a copy
+ * of the UDP header that has its length and checksum adjusted.
+ */
+static struct sk_buff *udp4_gso_segment(struct sk_buff *skb,
+					netdev_features_t features)
+{
+	struct sk_buff *segs = ERR_PTR(-EINVAL);
+	unsigned int sum_truesize = 0;
+	struct sk_buff *gso_skb = skb;
+	unsigned int oldlen;
+	unsigned int mss;
+	struct udphdr *uh;
+	__sum16 newcheck;
+	bool copy_destructor;
+	__be32 delta;
+
+	if (!pskb_may_pull(skb, sizeof(*uh)))
+		goto out;
+
+	oldlen = (u16)~skb->len;
+	__skb_pull(skb, sizeof(*uh));
+
+	mss = skb_shinfo(skb)->gso_size;
+	if (unlikely(skb->len <= mss))
+		goto out;
+
+	if (skb_gso_ok(skb, features | NETIF_F_GSO_ROBUST)) {
+		/* Packet is from an untrusted source, reset gso_segs. */
+		skb_shinfo(skb)->gso_segs = DIV_ROUND_UP(skb->len, mss);
+
+		segs = NULL;
+		goto out;
+	}
+
+	/* Keep the socket's send buffer charged until the last segment
+	 * has left, as tcp_gso_segment() does for TCP.
+	 */
+	copy_destructor = gso_skb->destructor == sock_wfree;
+
+	segs = skb_segment(skb, features);
+	if (IS_ERR(segs))
+		goto out;
+
+	delta = htonl(oldlen + (sizeof(*uh) + mss));
+
+	skb = segs;
+	uh = udp_hdr(skb);
+
+	newcheck = ~csum_fold((__force __wsum)((__force u32)uh->check +
+					       (__force u32)delta));
+
+	do {
+		uh->len = htons(sizeof(*uh) + mss);
+		uh->check = newcheck;
+
+		if (skb->ip_summed != CHECKSUM_PARTIAL)
+			uh->check = csum_fold(csum_partial(uh, sizeof(*uh),
+							   skb->csum)) ?:
+				    CSUM_MANGLED_0;
+
+		if (copy_destructor) {
+			skb->destructor = gso_skb->destructor;
+			skb->sk = gso_skb->sk;
+			sum_truesize += skb->truesize;
+		}
+		skb = skb->next;
+		uh = udp_hdr(skb);
+	} while (skb->next);
+
+	if (copy_destructor) {
+		swap(gso_skb->sk, skb->sk);
+		swap(gso_skb->destructor, skb->destructor);
+		sum_truesize += skb->truesize;
+		atomic_add(sum_truesize - gso_skb->truesize,
+			   &skb->sk->sk_wmem_alloc);
+	}
+
+	/* The last segment may be shorter than mss */
+	oldlen = skb_tail_pointer(skb) - skb_transport_header(skb) +
+		 skb->data_len;
+	delta = htonl((u16)~(sizeof(*uh) + mss) + oldlen);
+	uh->len = htons(oldlen);
+	uh->check = ~csum_fold((__force __wsum)((__force u32)newcheck +
+						(__force u32)delta));
+	if (skb->ip_summed != CHECKSUM_PARTIAL)
+		uh->check = csum_fold(csum_partial(uh, sizeof(*uh),
+						   skb->csum)) ?: CSUM_MANGLED_0;
+out:
+	return segs;
+}
+
 static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 					 netdev_features_t features)
 {
@@ -61,6 +152,11 @@ static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 		goto out;
 	}
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4) {
+		segs = udp4_gso_segment(skb, features);
+		goto out;
+	}
+
 	mss = skb_shinfo(skb)->gso_size;
 	if (unlikely(skb->len <= mss))
 		goto out;
@@ -177,6 +177,9 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 
 #define PGV_FROM_VMALLOC 1
 
+/* Tx-ring frames handed to the driver at once with PACKET_QDISC_BYPASS */
+#define PACKET_TX_BATCH	32
+
 #define BLOCK_STATUS(x)	((x)->hdr.bh1.block_status)
 #define BLOCK_NUM_PKTS(x)	((x)->hdr.bh1.num_pkts)
 #define BLOCK_O2FP(x)		((x)->hdr.bh1.offset_to_first_pkt)
@@ -262,6 +265,7 @@ static int packet_direct_xmit(struct sk_buff *skb)
 
 	HARD_TX_LOCK(dev, txq, smp_processor_id());
 	if (!netif_xmit_frozen_or_drv_stopped(txq)) {
+		skb->xmit_more = 0;
 		ret = ops->ndo_start_xmit(skb, dev);
 		if (ret == NETDEV_TX_OK)
 			txq_trans_update(txq);
@@ -280,6 +284,77 @@ drop:
 	return NET_XMIT_DROP;
 }
 
+/*
+ * Like packet_direct_xmit(), for a list of skbs chained through ->next.
+ * Each run of skbs for the same tx queue is sent under one lock, with
+ * xmit_more set on all but the last so that the driver can hold off the
+ * doorbell until the end of the run.  Sending stops at the first skb
+ * that can't be sent; it is returned with the rest still chained to it,
+ * or NULL if the driver took them all.
+ */
+static struct sk_buff *packet_direct_xmit_list(struct sk_buff *skb)
+{
+	struct net_device *dev = skb->dev;
+	const struct net_device_ops *ops = dev->netdev_ops;
+	netdev_features_t features;
+	struct sk_buff *end, *next;
+	struct netdev_queue *txq;
+	u16 queue_map;
+	int ret;
+
+	if (unlikely(!netif_running(dev) ||
+		     !netif_carrier_ok(dev)))
+		return skb;
+
+	/* linearize outside the lock, only send up to what failed */
+	for (end = skb; end; end = end->next) {
+		features = netif_skb_features(end);
+		if (skb_needs_linearize(end, features) &&
+		    __skb_linearize(end))
+			break;
+	}
+
+	local_bh_disable();
+
+	while (skb != end) {
+		queue_map = skb_get_queue_mapping(skb);
+		txq = netdev_get_tx_queue(dev, queue_map);
+
+		HARD_TX_LOCK(dev, txq, smp_processor_id());
+		do {
+			if (netif_xmit_frozen_or_drv_stopped(txq))
+				goto out_unlock;
+
+			next = skb->next;
+			skb->next = NULL;
+			skb->xmit_more = next != end &&
+					 skb_get_queue_mapping(next) == queue_map;
+
+			ret = ops->ndo_start_xmit(skb, dev);
+			if (!dev_xmit_complete(ret)) {
+				skb->xmit_more = 0;
+				skb->next = next;
+				goto out_unlock;
+			}
+			if (ret == NETDEV_TX_OK)
+				txq_trans_update(txq);
+
+			skb = next;
+		} while (skb != end && skb_get_queue_mapping(skb) == queue_map);
+		HARD_TX_UNLOCK(dev, txq);
+	}
+
+	local_bh_enable();
+
+	return skb;
+
+out_unlock:
+	HARD_TX_UNLOCK(dev, txq);
+	local_bh_enable();
+
+	return skb;
+}
+
 static struct net_device *packet_cached_dev_get(struct packet_sock *po)
 {
 	struct net_device *dev;
@@ -406,6 +481,9 @@ static void __packet_set_status(struct packet_sock *po, void *frame, int status)
 		flush_dcache_page(pgv_to_page(&h.h2->tp_status));
 		break;
 	case TPACKET_V3:
+		h.h3->tp_status = status;
+		flush_dcache_page(pgv_to_page(&h.h3->tp_status));
+		break;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -429,6 +507,8 @@ static int __packet_get_status(struct packet_sock *po, void *frame)
 		flush_dcache_page(pgv_to_page(&h.h2->tp_status));
 		return h.h2->tp_status;
 	case TPACKET_V3:
+		flush_dcache_page(pgv_to_page(&h.h3->tp_status));
+		return h.h3->tp_status;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -477,6 +557,9 @@ static __u32 __packet_set_timestamp(struct packet_sock *po, void *frame,
 		h.h2->tp_nsec = ts.tv_nsec;
 		break;
 	case TPACKET_V3:
+		h.h3->tp_sec = ts.tv_sec;
+		h.h3->tp_nsec = ts.tv_nsec;
+		break;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -1185,6 +1268,13 @@ static void packet_increment_head(struct packet_ring_buffer *buff)
 	buff->head = buff->head != buff->frame_max ? buff->head+1 : 0;
 }
 
+static void packet_rewind_head(struct packet_ring_buffer *buff,
+			       unsigned int nr)
+{
+	buff->head = (buff->head + buff->frame_max + 1 - nr) %
+		     (buff->frame_max + 1);
+}
+
 static void packet_inc_pending(struct packet_ring_buffer *rb)
 {
 	this_cpu_inc(*rb->pending_refcnt);
@@ -2113,6 +2203,12 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 	skb_shinfo(skb)->destructor_arg = ph.raw;
 
 	switch (po->tp_version) {
+	case TPACKET_V3:
+		/* frames are fixed size, the ring can't chain them */
+		if (unlikely(ph.h3->tp_next_offset))
+			return -EINVAL;
+		tp_len = ph.h3->tp_len;
+		break;
 	case TPACKET_V2:
 		tp_len = ph.h2->tp_len;
 		break;
@@ -2136,6 +2232,9 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 		off_max = po->tx_ring.frame_size - tp_len;
 		if (sock->type == SOCK_DGRAM) {
 			switch (po->tp_version) {
+			case TPACKET_V3:
+				off = ph.h3->tp_net;
+				break;
 			case TPACKET_V2:
 				off = ph.h2->tp_net;
 				break;
@@ -2145,6 +2244,9 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 			}
 		} else {
 			switch (po->tp_version) {
+			case TPACKET_V3:
+				off = ph.h3->tp_mac;
+				break;
 			case TPACKET_V2:
 				off = ph.h2->tp_mac;
 				break;
@@ -2216,8 +2318,40 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 	return tp_len;
 }
 
+/*
+ * Send the batched Tx-ring frames.  Those the driver didn't take go back
+ * to TP_STATUS_SEND_REQUEST and the ring head is rewound to the first of
+ * them, so the next send picks them up again.
+ */
+static int tpacket_xmit_batch(struct packet_sock *po, struct sk_buff **batch,
+			      int *batch_nr)
+{
+	struct sk_buff *skb, *next;
+	unsigned int unsent = 0;
+
+	skb = packet_direct_xmit_list(*batch);
+	for (; skb; skb = next) {
+		next = skb->next;
+		skb->next = NULL;
+		skb->destructor = sock_wfree;
+		packet_dec_pending(&po->tx_ring);
+		__packet_set_status(po, skb_shinfo(skb)->destructor_arg,
+				    TP_STATUS_SEND_REQUEST);
+		kfree_skb(skb);
+		unsent++;
+	}
+	packet_rewind_head(&po->tx_ring, unsent);
+
+	*batch = NULL;
+	*batch_nr = 0;
+
+	return unsent ? -ENOBUFS : 0;
+}
+
 static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 {
+	struct sk_buff *batch = NULL, *batch_last = NULL;
+	int batch_nr = 0;
 	struct sk_buff *skb;
 	struct net_device *dev;
 	__be16 proto;
@@ -2268,6 +2402,11 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 		ph = packet_current_frame(po, &po->tx_ring,
 					  TP_STATUS_SEND_REQUEST);
 		if (unlikely(ph == NULL)) {
+			if (batch) {
+				err = tpacket_xmit_batch(po, &batch, &batch_nr);
+				if (err)
+					goto out_put;
+			}
 			if (need_wait && need_resched())
 				schedule();
 			continue;
@@ -2276,12 +2415,20 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 		status = TP_STATUS_SEND_REQUEST;
 		hlen = LL_RESERVED_SPACE(dev);
 		tlen = dev->needed_tailroom;
+		/* don't wait for send buffer space held by our own batch */
 		skb = sock_alloc_send_skb(&po->sk,
 				hlen + tlen + sizeof(struct sockaddr_ll),
-				0, &err);
+				batch != NULL, &err);
 
-		if (unlikely(skb == NULL))
+		if (unlikely(skb == NULL)) {
+			if (batch && err == -EAGAIN) {
+				err = tpacket_xmit_batch(po, &batch, &batch_nr);
+				if (err)
+					goto out_put;
+				continue;
+			}
 			goto out_status;
+		}
 
 		tp_len = tpacket_fill_skb(po, skb, ph, dev, size_max, proto,
 					  addr, hlen);
@@ -2298,6 +2445,14 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 				tp_len = -EMSGSIZE;
 		}
 		if (unlikely(tp_len < 0)) {
+			/* batched frames must stay contiguous in the ring */
+			if (batch) {
+				err = tpacket_xmit_batch(po, &batch, &batch_nr);
+				if (err) {
+					kfree_skb(skb);
+					goto out_put;
+				}
+			}
 			if (po->tp_loss) {
 				__packet_set_status(po, ph,
 						TP_STATUS_AVAILABLE);
@@ -2318,6 +2473,23 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 		packet_inc_pending(&po->tx_ring);
 
 		status = TP_STATUS_SEND_REQUEST;
+		if (packet_use_direct_xmit(po)) {
+			if (batch)
+				batch_last->next = skb;
+			else
+				batch = skb;
+			batch_last = skb;
+			packet_increment_head(&po->tx_ring);
+			len_sum += tp_len;
+
+			if (++batch_nr == PACKET_TX_BATCH) {
+				err = tpacket_xmit_batch(po, &batch, &batch_nr);
+				if (err)
+					goto out_put;
+			}
+			continue;
+		}
+
 		err = po->xmit(skb);
 		if (unlikely(err > 0)) {
 			err = net_xmit_errno(err);
@@ -2351,6 +2523,8 @@ out_status:
 	__packet_set_status(po, ph, status);
 	kfree_skb(skb);
 out_put:
+	if (batch)
+		tpacket_xmit_batch(po, &batch, &batch_nr);
 	dev_put(dev);
 out:
 	mutex_unlock(&po->pg_vec_lock);
@@ -3749,12 +3923,6 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 	/* Added to avoid minimal code churn */
 	struct tpacket_req *req = &req_u->req;
 
-	/* Opening a Tx-ring is NOT supported in TPACKET_V3 */
-	if (!closing && tx_ring && (po->tp_version > TPACKET_V2)) {
-		WARN(1, "Tx-ring is not supported.\n");
-		goto out;
-	}
-
 	rb = tx_ring ? &po->tx_ring : &po->rx_ring;
 	rb_queue = tx_ring ? &sk->sk_write_queue : &sk->sk_receive_queue;
 
@@ -3809,11 +3977,21 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 			goto out;
 		switch (po->tp_version) {
 		case TPACKET_V3:
-		/* Transmit path is not supported. We checked
-		 * it above but just being paranoid
-		 */
-			if (!tx_ring)
+			/* The Tx-ring is made of fixed size frames like in
+			 * V2, so none of the block retire settings apply.
+			 */
+			if (!tx_ring) {
 				init_prb_bdqc(po, rb, pg_vec, req_u, tx_ring);
+			} else {
+				struct tpacket_req3 *req3 = &req_u->req3;
+
+				if (req3->tp_retire_blk_tov ||
+				    req3->tp_sizeof_priv ||
+				    req3->tp_feature_req_word) {
+					err = -EINVAL;
+					goto out_free_pg_vec;
+				}
+			}
 			break;
 		default:
 			break;
@@ -3877,6 +4055,7 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 	}
 	release_sock(sk);
 
+out_free_pg_vec:
 	if (pg_vec)
 		free_pg_vec(pg_vec, order, req->tp_block_nr);
 out:
@@ -0,0 +1,260 @@
+/*
+ * nohz_noise - measure the interruptions seen by a task on an isolated CPU
+ *
+ * A sampling thread pinned to the CPU under test spins reading the
+ * monotonic clock.  Any gap between two consecutive reads longer than the
+ * threshold is time taken away from the task: an interrupt, an IPI, a
+ * softirq or another task.  A second thread, pinned to a different CPU so
+ * as not to disturb the first, reports once a second the number of such
+ * gaps, their total and longest duration, and the interrupts the CPU under
+ * test took in that second according to /proc/interrupts.
+ *
+ * Without a vDSO every clock read is a system call, so the threshold has to
+ * be well above the cost of clock_gettime() on the target.
+ *
+ * Typical use on a two CPU system booted with nohz_full=1, with the data
+ * plane workload stopped:
+ *
+ *	nohz_noise -c 1 -r 0 -t 5 -d 60 -p 50
+ *
+ * Licensed under the terms of the GNU GPL License version 2.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_IRQS	256
+#define NAME_LEN	32
+
+struct second {
+	unsigned long	gaps;
+	uint64_t	noise_ns;
+	uint64_t	max_ns;
+};
+
+struct irq_count {
+	char		name[NAME_LEN];
+	unsigned long	count;
+};
+
+static int test_cpu = 1;
+static int report_cpu = 0;
+static unsigned int threshold_ns = 2000;
+static unsigned int duration = 10;
+static int rt_prio;
+
+static struct second *seconds;
+static volatile unsigned int done_sec;
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		die("sched_setaffinity");
+}
+
+static void *sampler(void *arg __attribute__((unused)))
+{
+	uint64_t start, prev, t, gap;
+	unsigned int sec = 0;
+	struct sched_param sp = { .sched_priority = rt_prio };
+
+	pin(test_cpu);
+	if (rt_prio && sched_setscheduler(0, SCHED_FIFO, &sp))
+		die("sched_setscheduler");
+
+	start = prev = now_ns();
+	while (sec < duration) {
+		t = now_ns();
+		gap = t - prev;
+		prev = t;
+
+		if (gap >= threshold_ns) {
+			seconds[sec].gaps++;
+			seconds[sec].noise_ns += gap;
+			if (gap > seconds[sec].max_ns)
+				seconds[sec].max_ns = gap;
+		}
+
+		if ((t - start) / 1000000000ULL != sec) {
+			__sync_synchronize();
+			done_sec = ++sec;
+		}
+	}
+	return NULL;
+}
+
+/* read the test CPU's column of /proc/interrupts */
+static int read_irqs(struct irq_count *irqs)
+{
+	char line[1024], *p, *end;
+	int ncpus = 0, col = -1, n = 0, i;
+	FILE *f;
+
+	f = fopen("/proc/interrupts", "r");
+	if (!f)
+		die("/proc/interrupts");
+
+	if (!fgets(line, sizeof(line), f))
+		die("/proc/interrupts");
+	for (p = strtok(line, " \t\n"); p; p = strtok(NULL, " \t\n")) {
+		if (atoi(p + 3) == test_cpu)
+			col = ncpus;
+		ncpus++;
+	}
+	if (col < 0) {
+		fprintf(stderr, "CPU%d not in /proc/interrupts\n", test_cpu);
+		exit(1);
+	}
+
+	while (n < MAX_IRQS && fgets(line, sizeof(line), f)) {
+		p = strchr(line, ':');
+		if (!p)
+			continue;
+		*p++ = '\0';
+		for (i = 0; i <= col; i++) {
+			irqs[n].count = strtoul(p, &end, 10);
+			if (end == p)
+				break;
+			p = end;
+		}
+		if (i <= col)
+			continue;	/* ERR:, MIS: and friends */
+		snprintf(irqs[n].name, NAME_LEN, "%s", line + strspn(line, " "));
+		n++;
+	}
+	fclose(f);
+	return n;
+}
+
+/* interrupts may have been requested since the last read */
+static unsigned long irq_delta(struct irq_count *prev, int nprev,
+			       struct irq_count *irq, int i)
+{
+	if (i >= nprev || strcmp(prev[i].name, irq->name))
+		for (i = 0; i < nprev; i++)
+			if (!strcmp(prev[i].name, irq->name))
+				break;
+	return i < nprev ? irq->count - prev[i].count : irq->count;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-c cpu] [-r report cpu] [-t threshold us] [-d seconds] [-p fifo prio]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct irq_count prev[MAX_IRQS], cur[MAX_IRQS];
+	uint64_t noise = 0, max = 0;
+	unsigned long gaps = 0, irqs, delta, total_irqs = 0;
+	unsigned int sec;
+	pthread_t thread;
+	int c, i, n, nprev;
+
+	while ((c = getopt(argc, argv, "c:r:t:d:p:")) != -1) {
+		switch (c) {
+		case 'c':
+			test_cpu = atoi(optarg);
+			break;
+		case 'r':
+			report_cpu = atoi(optarg);
+			break;
+		case 't':
+			threshold_ns = atoi(optarg) * 1000;
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'p':
+			rt_prio = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (test_cpu == report_cpu || !duration)
+		usage(argv[0]);
+
+	seconds = calloc(duration, sizeof(*seconds));
+	if (!seconds)
+		die("calloc");
+	if (mlockall(MCL_CURRENT | MCL_FUTURE))
+		perror("mlockall");
+
+	pin(report_cpu);
+	nprev = read_irqs(prev);
+	errno = pthread_create(&thread, NULL, sampler, NULL);
+	if (errno)
+		die("pthread_create");
+
+	printf("cpu %d, gaps over %u us\n", test_cpu, threshold_ns / 1000);
+	printf("%4s %6s %10s %8s %6s  %s\n",
+	       "sec", "gaps", "noise(us)", "max(us)", "irqs", "sources");
+	for (sec = 0; sec < duration; sec++) {
+		while (done_sec <= sec)
+			usleep(10000);
+		__sync_synchronize();
+
+		n = read_irqs(cur);
+		irqs = 0;
+		printf("%4u %6lu %10llu %8llu ", sec, seconds[sec].gaps,
+		       (unsigned long long)seconds[sec].noise_ns / 1000,
+		       (unsigned long long)seconds[sec].max_ns / 1000);
+		for (i = 0; i < n; i++)
+			irqs += irq_delta(prev, nprev, &cur[i], i);
+		printf("%6lu ", irqs);
+		for (i = 0; i < n; i++) {
+			delta = irq_delta(prev, nprev, &cur[i], i);
+			if (delta)
+				printf(" %s:%lu", cur[i].name, delta);
+		}
+		printf("\n");
+		fflush(stdout);
+		memcpy(prev, cur, n * sizeof(cur[0]));
+		nprev = n;
+
+		gaps += seconds[sec].gaps;
+		noise += seconds[sec].noise_ns;
+		if (seconds[sec].max_ns > max)
+			max = seconds[sec].max_ns;
+		total_irqs += irqs;
+	}
+	pthread_join(thread, NULL);
+
+	printf("total: %lu gaps, %llu us noise (%llu ppm), max %llu us, %lu irqs\n",
+	       gaps, (unsigned long long)noise / 1000,
+	       (unsigned long long)noise / duration / 1000,
+	       (unsigned long long)max / 1000, total_irqs);
+	return 0;
+}
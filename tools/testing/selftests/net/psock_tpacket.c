@@ -18,7 +18,7 @@
  *   The test currently runs for
  *   - TPACKET_V1: RX_RING, TX_RING
  *   - TPACKET_V2: RX_RING, TX_RING
- *   - TPACKET_V3: RX_RING
+ *   - TPACKET_V3: RX_RING, TX_RING, TX_RING with PACKET_QDISC_BYPASS
  *
  * License (GPLv2):
  *
@@ -103,10 +103,12 @@ union frame_map {
 		struct tpacket2_hdr tp_h __aligned_tpacket;
 		struct sockaddr_ll s_ll __align_tpacket(sizeof(struct tpacket2_hdr));
 	} *v2;
+	struct tpacket3_hdr *v3;
 	void *raw;
 };
 
 static unsigned int total_packets, total_bytes;
+static int qdisc_bypass;
 
 static int pfsocket(int ver)
 {
@@ -311,20 +313,33 @@ static inline void __v2_tx_user_ready(struct tpacket2_hdr *hdr)
 	__sync_synchronize();
 }
 
-static inline int __v1_v2_tx_kernel_ready(void *base, int version)
+static inline int __v3_tx_kernel_ready(struct tpacket3_hdr *hdr)
+{
+	return !(hdr->tp_status & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING));
+}
+
+static inline void __v3_tx_user_ready(struct tpacket3_hdr *hdr)
+{
+	hdr->tp_status = TP_STATUS_SEND_REQUEST;
+	__sync_synchronize();
+}
+
+static inline int __tx_kernel_ready(void *base, int version)
 {
 	switch (version) {
 	case TPACKET_V1:
 		return __v1_tx_kernel_ready(base);
 	case TPACKET_V2:
 		return __v2_tx_kernel_ready(base);
+	case TPACKET_V3:
+		return __v3_tx_kernel_ready(base);
 	default:
 		bug_on(1);
 		return 0;
 	}
 }
 
-static inline void __v1_v2_tx_user_ready(void *base, int version)
+static inline void __tx_user_ready(void *base, int version)
 {
 	switch (version) {
 	case TPACKET_V1:
@@ -333,10 +348,13 @@ static inline void __v1_v2_tx_user_ready(void *base, int version)
 	case TPACKET_V2:
 		__v2_tx_user_ready(base);
 		break;
+	case TPACKET_V3:
+		__v3_tx_user_ready(base);
+		break;
 	}
 }
 
-static void __v1_v2_set_packet_loss_discard(int sock)
+static void __set_packet_loss_discard(int sock)
 {
 	int ret, discard = 1;
 
@@ -348,7 +366,19 @@ static void __v1_v2_set_packet_loss_discard(int sock)
 	}
 }
 
-static void walk_v1_v2_tx(int sock, struct ring *ring)
+static void __set_qdisc_bypass(int sock)
+{
+	int ret, bypass = 1;
+
+	ret = setsockopt(sock, SOL_PACKET, PACKET_QDISC_BYPASS,
+			 (void *) &bypass, sizeof(bypass));
+	if (ret == -1) {
+		perror("setsockopt");
+		exit(1);
+	}
+}
+
+static void walk_tx(int sock, struct ring *ring)
 {
 	struct pollfd pfd;
 	int rcv_sock, ret;
@@ -388,8 +418,8 @@ static void walk_v1_v2_tx(int sock, struct ring *ring)
 	create_payload(packet, &packet_len);
 
 	while (total_packets > 0) {
-		while (__v1_v2_tx_kernel_ready(ring->rd[frame_num].iov_base,
-					       ring->version) &&
+		while (__tx_kernel_ready(ring->rd[frame_num].iov_base,
+					 ring->version) &&
 		       total_packets > 0) {
 			ppd.raw = ring->rd[frame_num].iov_base;
 
@@ -413,12 +443,22 @@ static void walk_v1_v2_tx(int sock, struct ring *ring)
 				       packet_len);
 				total_bytes += ppd.v2->tp_h.tp_snaplen;
 				break;
+
+			case TPACKET_V3:
+				ppd.v3->tp_snaplen = packet_len;
+				ppd.v3->tp_len = packet_len;
+
+				memcpy((uint8_t *) ppd.raw + TPACKET3_HDRLEN -
+				       sizeof(struct sockaddr_ll), packet,
+				       packet_len);
+				total_bytes += ppd.v3->tp_snaplen;
+				break;
 			}
 
 			status_bar_update();
 			total_packets--;
 
-			__v1_v2_tx_user_ready(ppd.raw, ring->version);
+			__tx_user_ready(ppd.raw, ring->version);
 
 			frame_num = (frame_num + 1) % ring->rd_num;
 		}
@@ -434,9 +474,12 @@ static void walk_v1_v2_tx(int sock, struct ring *ring)
 		exit(1);
 	}
 
-	while ((ret = recvfrom(rcv_sock, packet, sizeof(packet),
-			       0, NULL, NULL)) > 0 &&
-	       total_packets < NUM_PACKETS) {
+	/* with qdisc bypass the packets aren't seen on their way out, so
+	 * stop before waiting for more than NUM_PACKETS
+	 */
+	while (total_packets < NUM_PACKETS &&
+	       (ret = recvfrom(rcv_sock, packet, sizeof(packet),
+			       0, NULL, NULL)) > 0) {
 		got += ret;
 		test_payload(packet, ret);
 
@@ -460,7 +503,7 @@ static void walk_v1_v2(int sock, struct ring *ring)
 	if (ring->type == PACKET_RX_RING)
 		walk_v1_v2_rx(sock, ring);
 	else
-		walk_v1_v2_tx(sock, ring);
+		walk_tx(sock, ring);
 }
 
 static uint64_t __v3_prev_block_seq_num = 0;
@@ -583,7 +626,7 @@ static void walk_v3(int sock, struct ring *ring)
 	if (ring->type == PACKET_RX_RING)
 		walk_v3_rx(sock, ring);
 	else
-		bug_on(1);
+		walk_tx(sock, ring);
 }
 
 static void __v1_v2_fill(struct ring *ring, unsigned int blocks)
@@ -602,11 +645,13 @@ static void __v1_v2_fill(struct ring *ring, unsigned int blocks)
 	ring->flen = ring->req.tp_frame_size;
 }
 
-static void __v3_fill(struct ring *ring, unsigned int blocks)
+static void __v3_fill(struct ring *ring, unsigned int blocks, int type)
 {
-	ring->req3.tp_retire_blk_tov = 64;
-	ring->req3.tp_sizeof_priv = 0;
-	ring->req3.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+	if (type == PACKET_RX_RING) {
+		ring->req3.tp_retire_blk_tov = 64;
+		ring->req3.tp_sizeof_priv = 0;
+		ring->req3.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+	}
 
 	ring->req3.tp_block_size = getpagesize() << 2;
 	ring->req3.tp_frame_size = TPACKET_ALIGNMENT << 7;
@@ -618,8 +663,15 @@ static void __v3_fill(struct ring *ring, unsigned int blocks)
 
 	ring->mm_len = ring->req3.tp_block_size * ring->req3.tp_block_nr;
 	ring->walk = walk_v3;
-	ring->rd_num = ring->req3.tp_block_nr;
-	ring->flen = ring->req3.tp_block_size;
+
+	/* the Tx-ring is walked frame by frame, the Rx-ring by block */
+	if (type == PACKET_TX_RING) {
+		ring->rd_num = ring->req3.tp_frame_nr;
+		ring->flen = ring->req3.tp_frame_size;
+	} else {
+		ring->rd_num = ring->req3.tp_block_nr;
+		ring->flen = ring->req3.tp_block_size;
+	}
 }
 
 static void setup_ring(int sock, struct ring *ring, int version, int type)
@@ -634,14 +686,16 @@ static void setup_ring(int sock, struct ring *ring, int version, int type)
 	case TPACKET_V1:
 	case TPACKET_V2:
 		if (type == PACKET_TX_RING)
-			__v1_v2_set_packet_loss_discard(sock);
+			__set_packet_loss_discard(sock);
 		__v1_v2_fill(ring, blocks);
 		ret = setsockopt(sock, SOL_PACKET, type, &ring->req,
 				 sizeof(ring->req));
 		break;
 
 	case TPACKET_V3:
-		__v3_fill(ring, blocks);
+		if (type == PACKET_TX_RING)
+			__set_packet_loss_discard(sock);
+		__v3_fill(ring, blocks, type);
 		ret = setsockopt(sock, SOL_PACKET, type, &ring->req3,
 				 sizeof(ring->req3));
 		break;
@@ -652,6 +706,9 @@ static void setup_ring(int sock, struct ring *ring, int version, int type)
 		exit(1);
 	}
 
+	if (type == PACKET_TX_RING && qdisc_bypass)
+		__set_qdisc_bypass(sock);
+
 	ring->rd_len = ring->rd_num * sizeof(*ring->rd);
 	ring->rd = malloc(ring->rd_len);
 	if (ring->rd == NULL) {
@@ -760,8 +817,8 @@ static int test_tpacket(int version, int type)
 	int sock;
 	struct ring ring;
 
-	fprintf(stderr, "test: %s with %s ", tpacket_str[version],
-		type_str[type]);
+	fprintf(stderr, "test: %s with %s%s ", tpacket_str[version],
+		type_str[type], qdisc_bypass ? " (qdisc bypass)" : "");
 	fflush(stderr);
 
 	if (version == TPACKET_V1 &&
@@ -796,6 +853,10 @@ int main(void)
 	ret |= test_tpacket(TPACKET_V2, PACKET_TX_RING);
 
 	ret |= test_tpacket(TPACKET_V3, PACKET_RX_RING);
+	ret |= test_tpacket(TPACKET_V3, PACKET_TX_RING);
+
+	qdisc_bypass = 1;
+	ret |= test_tpacket(TPACKET_V3, PACKET_TX_RING);
 
 	if (ret)
 		return 1;
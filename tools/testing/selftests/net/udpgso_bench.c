@@ -0,0 +1,287 @@
+/*
+ * UDP send benchmark, with and without UDP_SEGMENT.
+ *
+ * The sender writes large buffers to a connected UDP socket for a number
+ * of seconds and reports once a second how many send calls, datagrams
+ * and megabytes went out.  With -S the buffers are cut into gso_size
+ * datagrams by GSO or the device instead of by userspace, so the number
+ * of calls per datagram drops by the segmentation factor.
+ *
+ * By default a receiver is forked on the loopback address that checks
+ * the datagram sizes and reports what arrived.  Use -D to send to a
+ * remote sink instead, and -r to run only the receiver.
+ *
+ * License (GPLv2):
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. * See the GNU General Public License for
+ * more details.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <error.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP		17
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT	103
+#endif
+
+#define MAX_SEND	(65535 - 20 - 8)
+
+static char buf[MAX_SEND];
+
+static const char *cfg_addr = "127.0.0.1";
+static int cfg_port = 8000;
+static int cfg_runtime = 4;
+static int cfg_size = 1400 * 40;
+static int cfg_gso_size;
+static bool cfg_remote;
+static bool cfg_rx_only;
+
+static unsigned long gettimeofday_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+}
+
+static void setup_addr(struct sockaddr_in *addr)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_port = htons(cfg_port);
+	if (inet_pton(AF_INET, cfg_addr, &addr->sin_addr) != 1)
+		error(1, 0, "bad address: %s", cfg_addr);
+}
+
+static int do_rx_setup(void)
+{
+	struct sockaddr_in addr;
+	int fd, val = 1 << 21;
+
+	setup_addr(&addr);
+
+	fd = socket(PF_INET, SOCK_DGRAM, 0);
+	if (fd == -1)
+		error(1, errno, "socket rx");
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &val, sizeof(val)))
+		error(1, errno, "setsockopt rcvbuf");
+	if (bind(fd, (void *)&addr, sizeof(addr)))
+		error(1, errno, "bind");
+
+	return fd;
+}
+
+/* Every datagram must be gso_size long, except the tail of each send */
+static int do_rx(int fd, int runtime)
+{
+	unsigned long tnow, treport, tstop;
+	unsigned long num_msgs = 0, num_bytes = 0;
+	unsigned long tot_msgs = 0;
+	int expected = cfg_gso_size ? cfg_gso_size : cfg_size;
+	int tail = cfg_size % expected;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	int ret, errors = 0;
+
+	tnow = gettimeofday_ms();
+	treport = tnow + 1000;
+	tstop = tnow + runtime * 1000;
+
+	do {
+		ret = poll(&pfd, 1, 100);
+		if (ret == -1)
+			error(1, errno, "poll");
+
+		while (ret > 0) {
+			ret = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+			if (ret == -1) {
+				if (errno != EAGAIN)
+					error(1, errno, "recv");
+				break;
+			}
+			if (ret != expected && ret != tail && errors++ < 10)
+				fprintf(stderr, "rx: unexpected length %d\n",
+					ret);
+			num_msgs++;
+			num_bytes += ret;
+		}
+
+		tnow = gettimeofday_ms();
+		if (tnow > treport) {
+			fprintf(stderr, "udp rx: %6lu MB/s %8lu msg/s\n",
+				num_bytes >> 20, num_msgs);
+			tot_msgs += num_msgs;
+			num_msgs = num_bytes = 0;
+			treport = tnow + 1000;
+		}
+	} while (tnow < tstop);
+
+	if (!tot_msgs) {
+		fprintf(stderr, "rx: no datagrams received\n");
+		return 1;
+	}
+	return errors ? 1 : 0;
+}
+
+static int do_tx(void)
+{
+	unsigned long tnow, treport, tstop;
+	unsigned long num_sends = 0, num_msgs = 0, num_bytes = 0;
+	int segs = cfg_gso_size ? (cfg_size + cfg_gso_size - 1) / cfg_gso_size : 1;
+	struct sockaddr_in addr;
+	int fd, ret;
+
+	setup_addr(&addr);
+
+	fd = socket(PF_INET, SOCK_DGRAM, 0);
+	if (fd == -1)
+		error(1, errno, "socket tx");
+
+	if (cfg_gso_size &&
+	    setsockopt(fd, SOL_UDP, UDP_SEGMENT, &cfg_gso_size,
+		       sizeof(cfg_gso_size)))
+		error(1, errno, "setsockopt udp segment");
+
+	if (connect(fd, (void *)&addr, sizeof(addr)))
+		error(1, errno, "connect");
+
+	memset(buf, 'a', cfg_size);
+
+	tnow = gettimeofday_ms();
+	treport = tnow + 1000;
+	tstop = tnow + cfg_runtime * 1000;
+
+	do {
+		ret = send(fd, buf, cfg_size, 0);
+		if (ret == -1) {
+			/* a remote sink without a listener is fine */
+			if (errno != ECONNREFUSED && errno != ENOBUFS)
+				error(1, errno, "send");
+		} else {
+			if (ret != cfg_size)
+				error(1, 0, "send: %d != %d", ret, cfg_size);
+			num_sends++;
+			num_msgs += segs;
+			num_bytes += ret;
+		}
+
+		tnow = gettimeofday_ms();
+		if (tnow > treport) {
+			fprintf(stderr,
+				"udp tx: %6lu MB/s %8lu calls/s %8lu msg/s\n",
+				num_bytes >> 20, num_sends, num_msgs);
+			num_sends = num_msgs = num_bytes = 0;
+			treport = tnow + 1000;
+		}
+	} while (tnow < tstop);
+
+	if (close(fd))
+		error(1, errno, "close");
+
+	return 0;
+}
+
+static void usage(const char *filepath)
+{
+	error(1, 0, "Usage: %s [-D dst ip] [-l secs] [-p port] [-r] "
+		    "[-s sendsize] [-S gsosize]", filepath);
+}
+
+static void parse_opts(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "D:l:p:rs:S:")) != -1) {
+		switch (c) {
+		case 'D':
+			cfg_addr = optarg;
+			cfg_remote = true;
+			break;
+		case 'l':
+			cfg_runtime = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			cfg_port = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			cfg_rx_only = true;
+			break;
+		case 's':
+			cfg_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'S':
+			cfg_gso_size = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind != argc)
+		usage(argv[0]);
+	if (cfg_size <= 0 || cfg_size > MAX_SEND)
+		error(1, 0, "send size must be 1..%d", MAX_SEND);
+	if (cfg_gso_size < 0 || cfg_gso_size > cfg_size)
+		error(1, 0, "gso size must be 0..%d", cfg_size);
+	if (cfg_runtime <= 0)
+		error(1, 0, "runtime must be positive");
+}
+
+int main(int argc, char **argv)
+{
+	int fd, status;
+	pid_t pid;
+
+	parse_opts(argc, argv);
+
+	if (cfg_rx_only)
+		return do_rx(do_rx_setup(), cfg_runtime);
+
+	if (cfg_remote)
+		return do_tx();
+
+	fd = do_rx_setup();
+
+	pid = fork();
+	if (pid == -1)
+		error(1, errno, "fork");
+	if (!pid)
+		exit(do_rx(fd, cfg_runtime + 1));
+
+	close(fd);
+	do_tx();
+
+	if (waitpid(pid, &status, 0) == -1)
+		error(1, errno, "waitpid");
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "[FAIL]\n");
+		return 1;
+	}
+
+	fprintf(stderr, "[OK]\n");
+	return 0;
+}